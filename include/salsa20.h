@@ -16,21 +16,36 @@ namespace Salsa20 {
 
     using hash_value_t = std::array<uint8_t, 64> ;
 
+    struct StateAccess ;
+
     /// <summary>Holds the state for Salsa20.</summary>
     class State {
+        friend struct StateAccess ;
     private:
         static const uint32_t   obfuscateMask_ ;
         static const std::array<uint32_t, 4>    sigma_ ;
         static const std::array<uint32_t, 4>    tau_ ;
     private:
         std::array<uint32_t, 16>    state_ ;
+        /**
+         * The counter independent part of the first round (computed by
+         * SetKey and SetInitialVector).
+         *
+         * @remarks The sequence number does not take part in it, so
+         *          SetSequenceNumber leaves it valid.
+         */
+        std::array<uint32_t, 16>    precomputed_ ;
+    private:
+        void    Precompute () ;
     public:
         State () {
             state_.fill (0) ;
+            precomputed_.fill (0) ;
         }
 
         State (const State &src) {
             state_ = src.state_ ;
+            precomputed_ = src.precomputed_ ;
         }
 
         State (const void *key, size_t key_size) {
@@ -70,6 +85,7 @@ namespace Salsa20 {
 
         State & Assign (const State &src) {
             state_ = src.state_ ;
+            precomputed_ = src.precomputed_ ;
             return *this ;
         }
 
@@ -85,6 +101,24 @@ namespace Salsa20 {
         hash_value_t    ComputeHashValue () const ;
     } ;
 
+    /**
+     * Retrieves the name of the kernel in use.
+     *
+     * @returns One of "scalar", "sse2", "avx2" or "avx512"
+     *
+     * @remarks The best kernel for the running CPU is selected at the first use.
+     */
+    extern const char * GetKernelName () ;
+
+    /**
+     * Forces the kernel to use.
+     *
+     * @param name The kernel name (nullptr selects the best one)
+     *
+     * @returns false if the kernel is unknown or not supported by the running CPU
+     */
+    extern bool SelectKernel (const char *name) ;
+
     /**
      * Performs Salsa20 encryption.
      *
@@ -133,6 +167,99 @@ namespace Salsa20 {
      */
     extern void Apply (Salsa20::State &state, void *message, size_t length, uint64_t offset) ;
 
+    /**
+     * Performs Salsa20 encryption at the byte offset without modifying the state.
+     *
+     * @param state The encryption state (only the key and the initial vector are used)
+     * @param dst The output
+     * @param src The input
+     * @param length The input length
+     * @param offset The start offset
+     *
+     * @remarks Nothing but `dst` is written, so a State can be shared among
+     *          threads without copying.
+     */
+    extern void ApplyAt (const Salsa20::State &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+    /**
+     * Performs the Salsa20 in-place encryption at the byte offset without modifying the state.
+     *
+     * @param state The encryption state (only the key and the initial vector are used)
+     * @param message The message
+     * @param length The message length
+     * @param offset The start offset
+     */
+    extern void ApplyAt (const Salsa20::State &state, void *message, size_t length, uint64_t offset) ;
+
+    /**
+     * Performs Salsa20 encryption of many independent messages.
+     *
+     * @param states The encryption state of each message
+     * @param dst The output of each message
+     * @param src The input of each message
+     * @param length The length of each message
+     * @param count # of messages
+     *
+     * @remarks Blocks of different messages are packed into the SIMD lanes
+     *          so that short messages are processed in parallel.
+     *          Each message starts at the current sequence number of its
+     *          state and the states are left unmodified.
+     */
+    extern void ApplyBatch ( const Salsa20::State *states
+                           , void * const *dst, const void * const *src, const size_t *length
+                           , size_t count) ;
+
+    /// <summary>A fragment of the scattered buffer (layout compatible with struct iovec).</summary>
+    struct IOVec {
+        void *  base ;
+        size_t  length ;
+    } ;
+
+    /**
+     * Performs Salsa20 encryption over scattered buffers.
+     *
+     * @param state The encryption state
+     * @param dst The output fragments
+     * @param dst_count # of output fragments
+     * @param src The input fragments
+     * @param src_count # of input fragments
+     *
+     * @remarks The fragments are treated as one continuous message, so the
+     *          result equals to the Apply over the concatenated buffers.
+     *          Fragment boundaries of `dst` and `src` need not to match,
+     *          but `dst` should be able to hold all of `src`.
+     */
+    extern void Apply (Salsa20::State &state, const IOVec *dst, size_t dst_count, const IOVec *src, size_t src_count) ;
+
+    /**
+     * Performs Salsa20 in-place encryption over scattered buffers.
+     *
+     * @param state The encryption state
+     * @param message The message fragments
+     * @param count # of fragments
+     */
+    extern void Apply (Salsa20::State &state, const IOVec *message, size_t count) ;
+
+    /**
+     * Generates the raw key stream.
+     *
+     * @param state The encryption state (sequence number is advanced by `nblocks`)
+     * @param output Receives `nblocks` * 64 bytes of the key stream
+     * @param nblocks # of blocks to generate
+     */
+    extern void GenerateKeystream (Salsa20::State &state, void *output, size_t nblocks) ;
+
+    /**
+     * Generates the raw key stream.
+     *
+     * @param state The encryption state
+     * @param output Receives `length` bytes of the key stream
+     * @param length # of bytes to generate
+     *
+     * @remarks As with Apply, the unused tail of the last block is discarded.
+     */
+    extern void GenerateKeystreamBytes (Salsa20::State &state, void *output, size_t length) ;
+
     inline void Encrypt (Salsa20::State &state, void *dst, const void *src, size_t length) {
         Apply (state, dst, src, length) ;
     }
@@ -163,6 +290,234 @@ namespace Salsa20 {
     inline void Decrypt (Salsa20::State &state, void *message, size_t length, uint64_t offset) {
         Apply (state, message, length, offset) ;
     }
+
+    /// <summary>Applies the continuous key stream over arbitrary sized chunks.</summary>
+    class StreamCipher {
+    private:
+        State           state_ ;
+        /// The key stream of the block preceding the current sequence number
+        hash_value_t    buffer_ ;
+        /// # of consumed bytes in buffer_
+        size_t          position_ ;
+    public:
+        explicit StreamCipher (const State &state) : state_ (state), position_ (std::tuple_size<hash_value_t>::value) {
+            /* NO-OP */
+        }
+
+        StreamCipher (const void *key, size_t key_size, uint64_t iv)
+                : state_ (key, key_size, iv)
+                , position_ (std::tuple_size<hash_value_t>::value) {
+            /* NO-OP */
+        }
+        /**
+         * Retrieves the underlying state.
+         */
+        const State &   GetState () const {
+            return state_ ;
+        }
+        /**
+         * Retrieves the byte offset of the next byte in the key stream.
+         */
+        uint64_t    GetPosition () const {
+            return state_.GetSequenceNumber () * buffer_.size () - (buffer_.size () - position_) ;
+        }
+        /**
+         * Moves to the byte offset in the key stream.
+         *
+         * @param offset The byte offset from the beginning
+         */
+        void    Seek (uint64_t offset) ;
+        /**
+         * Applies the key stream.
+         *
+         * @param dst The output
+         * @param src The input
+         * @param length The input length
+         *
+         * @remarks Successive calls form a continuous stream.
+         */
+        void    Process (void *dst, const void *src, size_t length) ;
+        /**
+         * Applies the key stream in-place.
+         *
+         * @param message The message
+         * @param length The message length
+         *
+         * @remarks Successive calls form a continuous stream.
+         */
+        void    Process (void *message, size_t length) {
+            Process (message, message, length) ;
+        }
+    } ;
+
+    /**
+     * Computes HSalsa20.
+     *
+     * @param subkey Receives the 32 bytes subkey
+     * @param key The key (expanded as State::SetKey does)
+     * @param key_size The key size
+     * @param nonce The 16 bytes nonce
+     */
+    extern void HSalsa20 (void *subkey, const void *key, size_t key_size, const void *nonce) ;
+
+    /**
+     * <summary>Holds the state for XSalsa20 (Salsa20 with the 192bit nonce).</summary>
+     *
+     * The Salsa20 state keyed with the derived subkey is kept private,
+     * so the key and the nonce can only be changed together through HSalsa20.
+     */
+    class XState {
+        friend struct StateAccess ;
+    private:
+        /// The HSalsa20 input (the key part)
+        State   key_ ;
+        /// The Salsa20 state with the subkey and the last 8 bytes of the nonce
+        State   state_ ;
+    public:
+        XState (const void *key, size_t key_size, const void *nonce) : key_ (key, key_size) {
+            SetNonce (nonce) ;
+        }
+        /**
+         * Sets the key and the nonce.
+         *
+         * @param key The Key to use
+         * @param key_size The key size
+         * @param nonce The 24 bytes nonce
+         *
+         * @remarks The sequence number is reset to 0.
+         */
+        void    SetKey (const void *key, size_t key_size, const void *nonce) {
+            key_.SetKey (key, key_size) ;
+            SetNonce (nonce) ;
+        }
+        /**
+         * Sets the nonce.
+         *
+         * @param nonce The 24 bytes nonce
+         *
+         * @remarks The subkey is derived by HSalsa20 here, so the Apply
+         *          family runs as fast as the plain Salsa20 afterwards.
+         *          The sequence number is reset to 0.
+         */
+        void    SetNonce (const void *nonce) ;
+
+        uint64_t    GetSequenceNumber () const {
+            return state_.GetSequenceNumber () ;
+        }
+
+        void    SetSequenceNumber (uint64_t value) {
+            state_.SetSequenceNumber (value) ;
+        }
+
+        void    IncrementSequenceNumber () {
+            state_.IncrementSequenceNumber () ;
+        }
+        /**
+         * Computes the hash value.
+         */
+        hash_value_t    ComputeHashValue () const {
+            return state_.ComputeHashValue () ;
+        }
+    } ;
+
+    /**
+     * Performs XSalsa20 encryption (see Apply for State).
+     */
+    extern void Apply (XState &state, void *dst, const void *src, size_t length) ;
+
+    extern void Apply (XState &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+    extern void Apply (XState &state, void *message, size_t length) ;
+
+    extern void Apply (XState &state, void *message, size_t length, uint64_t offset) ;
+
+    extern void ApplyAt (const XState &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+    extern void ApplyAt (const XState &state, void *message, size_t length, uint64_t offset) ;
+
+    extern void GenerateKeystream (XState &state, void *output, size_t nblocks) ;
+
+    /**
+     * <summary>Holds the state for the reduced round variants of Salsa20.</summary>
+     *
+     * The key setup, the sequence number handling and the bulk kernels are
+     * shared with State, only the number of the double rounds differs.
+     *
+     * @tparam DOUBLE_ROUNDS # of the double rounds (4 for Salsa20/8, 6 for Salsa20/12 and 10 for Salsa20/20)
+     *
+     * @remarks The reduced round variants have thinner security margins,
+     *          use them only where speed matters more (e.g. obfuscation and shuffling).
+     */
+    template <int DOUBLE_ROUNDS>
+        class RoundState {
+            static_assert (DOUBLE_ROUNDS == 4 || DOUBLE_ROUNDS == 6 || DOUBLE_ROUNDS == 10, "Only Salsa20/8, Salsa20/12 and Salsa20/20 are available") ;
+            friend struct StateAccess ;
+        private:
+            State   state_ ;
+        public:
+            RoundState () = default ;
+
+            RoundState (const void *key, size_t key_size) : state_ (key, key_size) {
+                /* NO-OP */
+            }
+
+            RoundState (const void *key, size_t key_size, uint64_t iv) : state_ (key, key_size, iv) {
+                /* NO-OP */
+            }
+
+            void    SetKey (const void *key, size_t key_size) {
+                state_.SetKey (key, key_size) ;
+            }
+
+            void    SetInitialVector (uint64_t iv) {
+                state_.SetInitialVector (iv) ;
+            }
+
+            uint64_t    GetSequenceNumber () const {
+                return state_.GetSequenceNumber () ;
+            }
+
+            void    SetSequenceNumber (uint64_t value) {
+                state_.SetSequenceNumber (value) ;
+            }
+
+            void    IncrementSequenceNumber () {
+                state_.IncrementSequenceNumber () ;
+            }
+            /**
+             * Computes the hash value.
+             */
+            hash_value_t    ComputeHashValue () const ;
+        } ;
+
+    /// Salsa20/8
+    using State8 = RoundState<4> ;
+    /// Salsa20/12
+    using State12 = RoundState<6> ;
+
+    /**
+     * Performs the reduced round Salsa20 encryption (see Apply for State).
+     */
+    template <int DOUBLE_ROUNDS>
+        void    Apply (RoundState<DOUBLE_ROUNDS> &state, void *dst, const void *src, size_t length) ;
+
+    template <int DOUBLE_ROUNDS>
+        void    Apply (RoundState<DOUBLE_ROUNDS> &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+    template <int DOUBLE_ROUNDS>
+        void    Apply (RoundState<DOUBLE_ROUNDS> &state, void *message, size_t length) ;
+
+    template <int DOUBLE_ROUNDS>
+        void    Apply (RoundState<DOUBLE_ROUNDS> &state, void *message, size_t length, uint64_t offset) ;
+
+    template <int DOUBLE_ROUNDS>
+        void    ApplyAt (const RoundState<DOUBLE_ROUNDS> &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+    template <int DOUBLE_ROUNDS>
+        void    ApplyAt (const RoundState<DOUBLE_ROUNDS> &state, void *message, size_t length, uint64_t offset) ;
+
+    template <int DOUBLE_ROUNDS>
+        void    GenerateKeystream (RoundState<DOUBLE_ROUNDS> &state, void *output, size_t nblocks) ;
 } /* end of [namespace Salsa20] */
 
 #endif  /* salsa20_h__ca34c9a4_6453_9c44_b0eb_08248de3b882 */
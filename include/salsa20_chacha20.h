@@ -0,0 +1,184 @@
+/*
+ * salsa20_chacha20.h: The ChaCha20 cipher (the sibling of salsa20)
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_chacha20_h__5e1a7c93_2b6d_4f08_a4c1_9d3e8f60b7a2
+#define salsa20_chacha20_h__5e1a7c93_2b6d_4f08_a4c1_9d3e8f60b7a2 1
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    struct StateAccess ;
+
+    namespace ChaCha20 {
+
+        /**
+         * <summary>Holds the state for ChaCha20.</summary>
+         *
+         * The words are laid out as the constants (0...3), the key (4...11),
+         * the block counter (12, 13) and the initial vector (14, 15).
+         * SetNonce switches to the RFC 8439 layout, where the counter is
+         * the word 12 only and the 96bit nonce occupies the words 13...15.
+         */
+        class State {
+            friend struct Salsa20::StateAccess ;
+        private:
+            std::array<uint32_t, 16>    state_ ;
+            /// true for the RFC 8439 layout
+            bool    ietf_ ;
+            /// true when the 32bit counter of the RFC 8439 layout has been used up (i.e. the sequence number is 2^32)
+            bool    exhausted_ ;
+        public:
+            State () : ietf_ (false), exhausted_ (false) {
+                state_.fill (0) ;
+            }
+
+            State (const void *key, size_t key_size) : ietf_ (false), exhausted_ (false) {
+                SetKey (key, key_size) ;
+            }
+
+            State (const void *key, size_t key_size, uint64_t iv) : ietf_ (false), exhausted_ (false) {
+                SetKey (key, key_size) ;
+                SetInitialVector (iv) ;
+            }
+            /**
+             * Sets the key.
+             *
+             * @param key The Key to use (16 or 32 bytes)
+             *
+             * @remarks The initial vector and the sequence number are reset to 0.
+             */
+            void    SetKey (const void *key, size_t key_size) ;
+            /**
+             * Sets the 64bit initial vector (the original layout).
+             *
+             * @param iv The initial vector
+             *
+             * @remarks The sequence number is reset to 0.
+             */
+            void    SetInitialVector (uint64_t iv) ;
+            /**
+             * Sets the 96bit nonce (the RFC 8439 layout).
+             *
+             * @param nonce The 12 bytes nonce
+             *
+             * @remarks The sequence number is reset to 0 and limited to 32bits
+             *          (i.e. 256GiB of the key stream per nonce).  Operations
+             *          that need a block beyond the counter 0xFFFFFFFF throw
+             *          std::overflow_error without producing any output.
+             */
+            void    SetNonce (const void *nonce) ;
+            /**
+             * Checks whether the RFC 8439 layout is in use.
+             */
+            bool    IsIETF () const {
+                return ietf_ ;
+            }
+            /**
+             * Retrieves current sequence number.
+             */
+            uint64_t    GetSequenceNumber () const ;
+            /**
+             * Sets the sequence number.
+             *
+             * @param value The sequence number
+             *
+             * @remarks Throws std::out_of_range for the value greater than 2^32
+             *          in the RFC 8439 layout.
+             */
+            void    SetSequenceNumber (uint64_t value) ;
+            /**
+             * Increments the sequence number by 1.
+             */
+            void    IncrementSequenceNumber () ;
+            /**
+             * Computes the hash value.
+             */
+            hash_value_t    ComputeHashValue () const ;
+        } ;
+
+        /**
+         * Performs ChaCha20 encryption.
+         *
+         * @param state The encryption state
+         * @param dst The output
+         * @param src The input
+         * @param length The input length
+         *
+         * @remarks As with Salsa20::Apply, the unused tail of the last block is discarded.
+         */
+        extern void Apply (State &state, void *dst, const void *src, size_t length) ;
+
+        /**
+         * Performs ChaCha20 encryption.
+         *
+         * @param state The encryption state
+         * @param dst The output
+         * @param src The input
+         * @param length The input length
+         * @param offset The start offset
+         */
+        extern void Apply (State &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+        /**
+         * Performs the ChaCha20 in-place encryption.
+         *
+         * @param state The encryption state
+         * @param message The message
+         * @param length The message length
+         */
+        extern void Apply (State &state, void *message, size_t length) ;
+
+        /**
+         * Performs the ChaCha20 in-place encryption.
+         *
+         * @param state The encryption state
+         * @param message The message
+         * @param length The message length
+         * @param offset The start offset
+         */
+        extern void Apply (State &state, void *message, size_t length, uint64_t offset) ;
+
+        /**
+         * Performs ChaCha20 encryption at the byte offset without modifying the state.
+         *
+         * @param state The encryption state (only the key and the initial vector are used)
+         * @param dst The output
+         * @param src The input
+         * @param length The input length
+         * @param offset The start offset
+         */
+        extern void ApplyAt (const State &state, void *dst, const void *src, size_t length, uint64_t offset) ;
+
+        /**
+         * Performs the ChaCha20 in-place encryption at the byte offset without modifying the state.
+         *
+         * @param state The encryption state (only the key and the initial vector are used)
+         * @param message The message
+         * @param length The message length
+         * @param offset The start offset
+         */
+        extern void ApplyAt (const State &state, void *message, size_t length, uint64_t offset) ;
+
+        /**
+         * Generates the raw key stream.
+         *
+         * @param state The encryption state (sequence number is advanced by `nblocks`)
+         * @param output Receives `nblocks` * 64 bytes of the key stream
+         * @param nblocks # of blocks to generate
+         */
+        extern void GenerateKeystream (State &state, void *output, size_t nblocks) ;
+    } /* end of [namespace Salsa20::ChaCha20] */
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_chacha20_h__5e1a7c93_2b6d_4f08_a4c1_9d3e8f60b7a2 */
+/*
+ * [END OF FILE]
+ */
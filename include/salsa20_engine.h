@@ -0,0 +1,156 @@
+/*
+ * salsa20_engine.h: Random number engine built on the salsa20 key stream
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_engine_h__9d3b7e51_24c8_4f6a_b0d2_7e1a5c8f3b64
+#define salsa20_engine_h__9d3b7e51_24c8_4f6a_b0d2_7e1a5c8f3b64 1
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    /**
+     * <summary>Counter based random number engine (satisfies UniformRandomBitGenerator).</summary>
+     *
+     * The n-th output is the n-th little-endian 32bit word of the key stream,
+     * so the engine can jump to any position in O(1).
+     * Engines with the same key and different initial vectors produce
+     * independent streams.
+     */
+    class Engine {
+    public:
+        using result_type = uint32_t ;
+
+        /// # of blocks generated at once
+        static constexpr size_t BUFFER_BLOCKS = 16 ;
+    private:
+        static constexpr size_t WORDS_PER_BLOCK = std::tuple_size<hash_value_t>::value / sizeof (result_type) ;
+
+        static constexpr size_t BUFFER_WORDS = WORDS_PER_BLOCK * BUFFER_BLOCKS ;
+
+        State   state_ ;
+        /// The sequence number of the first block in buffer_
+        uint64_t    base_ ;
+        /// The index of the next word in buffer_
+        size_t      position_ ;
+        std::array<uint8_t, sizeof (result_type) * BUFFER_WORDS>    buffer_ ;
+    public:
+        static constexpr result_type    min () {
+            return 0 ;
+        }
+
+        static constexpr result_type    max () {
+            return 0xFFFFFFFFu ;
+        }
+        /**
+         * Creates the engine starting from the sequence number of `state`.
+         *
+         * @param state The state holding the key and the initial vector
+         */
+        explicit Engine (const State &state) ;
+        /**
+         * Creates the engine.
+         *
+         * @param key The key
+         * @param key_size The key size
+         * @param stream The stream id (used as the initial vector)
+         */
+        Engine (const void *key, size_t key_size, uint64_t stream = 0) : Engine (State { key, key_size, stream }) {
+            /* NO-OP */
+        }
+
+        result_type operator () () {
+            if (position_ == BUFFER_WORDS) {
+                base_ += BUFFER_BLOCKS ;
+                Refill () ;
+                position_ = 0 ;
+            }
+            auto    p = &buffer_ [sizeof (result_type) * position_++] ;
+            return (  (static_cast<uint32_t> (p [0]) <<  0)
+                    | (static_cast<uint32_t> (p [1]) <<  8)
+                    | (static_cast<uint32_t> (p [2]) << 16)
+                    | (static_cast<uint32_t> (p [3]) << 24)) ;
+        }
+        /**
+         * Skips `n` outputs in O(1).
+         */
+        void    discard (unsigned long long n) {
+            Seek (GetPosition () + n) ;
+        }
+        /**
+         * Retrieves # of outputs generated so far (counted from the sequence number 0).
+         */
+        uint64_t    GetPosition () const {
+            return base_ * WORDS_PER_BLOCK + position_ ;
+        }
+        /**
+         * Moves to the position in O(1).
+         *
+         * @param position # of outputs from the sequence number 0
+         */
+        void    Seek (uint64_t position) ;
+        /**
+         * Creates the engine for the independent stream.
+         *
+         * @param stream The stream id (used as the initial vector)
+         *
+         * @returns The engine sharing the key and starting from the position 0
+         */
+        Engine  Split (uint64_t stream) const ;
+        /**
+         * Generates the outputs in bulk.
+         *
+         * @param output Receives `count` outputs
+         * @param count # of outputs
+         *
+         * @remarks Same as calling operator () `count` times.
+         */
+        void    Fill (result_type *output, size_t count) ;
+        /**
+         * Generates the uniform floats in [0, 1) in bulk.
+         *
+         * @param output Receives `count` floats
+         * @param count # of floats
+         *
+         * @remarks Each float consumes 1 output (24 random bits).
+         */
+        void    FillUniform01 (float *output, size_t count) ;
+        /**
+         * Generates the uniform doubles in [0, 1) in bulk.
+         *
+         * @param output Receives `count` doubles
+         * @param count # of doubles
+         *
+         * @remarks Each double consumes 2 outputs (52 random bits).
+         */
+        void    FillUniform01 (double *output, size_t count) ;
+        /**
+         * Generates the uniform integers in [0, bound) in bulk.
+         *
+         * @param output Receives `count` integers
+         * @param count # of integers
+         * @param bound The upper bound (should not be 0)
+         *
+         * @remarks Uses the multiply-and-reject method, so the results have
+         *          no bias.  Each integer consumes 1 output, rejected ones
+         *          are replaced with the outputs following the whole batch.
+         */
+        void    FillBounded (uint32_t *output, size_t count, uint32_t bound) ;
+    private:
+        /// Fills buffer_ with the blocks starting at base_
+        void    Refill () ;
+        /// Writes the next `count` outputs as the little-endian key stream
+        void    Generate (uint8_t *output, size_t count) ;
+    } ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_engine_h__9d3b7e51_24c8_4f6a_b0d2_7e1a5c8f3b64 */
+/*
+ * [END OF FILE]
+ */
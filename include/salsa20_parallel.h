@@ -0,0 +1,146 @@
+/*
+ * salsa20_parallel.h: Multi-threaded salsa20 encryption
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_parallel_h__6e0f3a4d_1b7c_4c52_8d1e_5a9b2c7f0e31
+#define salsa20_parallel_h__6e0f3a4d_1b7c_4c52_8d1e_5a9b2c7f0e31 1
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    /// <summary>A fixed size pool of worker threads.</summary>
+    class Executor {
+    private:
+        struct Impl ;
+        std::unique_ptr<Impl>   impl_ ;
+    public:
+        /**
+         * Starts the worker threads.
+         *
+         * @param num_threads # of worker threads (0 uses the # of hardware threads)
+         */
+        explicit Executor (size_t num_threads = 0) ;
+
+        Executor (const Executor &) = delete ;
+
+        Executor & operator = (const Executor &) = delete ;
+        /**
+         * Waits for the queued tasks and stops the worker threads.
+         */
+        ~Executor () ;
+        /**
+         * Retrieves # of worker threads.
+         */
+        size_t  GetThreadCount () const ;
+        /**
+         * Queues the task.
+         *
+         * @param task The task to run on a worker thread
+         */
+        void    Submit (std::function<void ()> task) ;
+        /**
+         * Runs `fn (0)` ... `fn (count - 1)` in parallel and waits for all of them.
+         *
+         * @param count # of iterations
+         * @param fn The body (should not throw)
+         *
+         * @remarks The calling thread also runs the iterations, so this may be
+         *          called from the tasks running on this executor.
+         */
+        void    ParallelFor (size_t count, const std::function<void (size_t)> &fn) ;
+    } ;
+
+    /**
+     * Performs Salsa20 encryption with multiple threads.
+     *
+     * @param state The encryption state
+     * @param dst The output
+     * @param src The input
+     * @param length The input length
+     * @param executor The threads to use
+     *
+     * @remarks The message is split into block aligned chunks, each chunk
+     *          is encrypted at its own sequence number.  The result and the
+     *          final sequence number of `state` are the same as Apply.
+     */
+    extern void ParallelApply (Salsa20::State &state, void *dst, const void *src, size_t length, Executor &executor) ;
+
+    /**
+     * Performs the Salsa20 in-place encryption with multiple threads.
+     *
+     * @param state The encryption state
+     * @param message The message
+     * @param length The message length
+     * @param executor The threads to use
+     */
+    extern void ParallelApply (Salsa20::State &state, void *message, size_t length, Executor &executor) ;
+
+    /// <summary>Runs many encryption jobs of various sizes on a pool of worker threads.</summary>
+    class Scheduler {
+    private:
+        struct Impl ;
+        std::unique_ptr<Impl>   impl_ ;
+    public:
+        /**
+         * Starts the worker threads.
+         *
+         * @param num_threads # of worker threads (0 uses the # of hardware threads)
+         */
+        explicit Scheduler (size_t num_threads = 0) ;
+
+        Scheduler (const Scheduler &) = delete ;
+
+        Scheduler & operator = (const Scheduler &) = delete ;
+        /**
+         * Waits for the submitted jobs and stops the worker threads.
+         */
+        ~Scheduler () ;
+        /**
+         * Retrieves # of worker threads.
+         */
+        size_t  GetThreadCount () const ;
+        /**
+         * Submits the encryption job.
+         *
+         * @param state The encryption state (copied, the job starts at its sequence number)
+         * @param dst The output
+         * @param src The input
+         * @param length The input length
+         * @param on_complete Called on a worker thread when the job is done (should not throw)
+         *
+         * @remarks Large jobs are split into block aligned ranges, idle
+         *          workers steal them from the busy ones.
+         *          `dst` and `src` should be kept alive until completion.
+         */
+        void    Submit (const Salsa20::State &state, void *dst, const void *src, size_t length, std::function<void ()> on_complete) ;
+        /**
+         * Submits the encryption job.
+         *
+         * @param state The encryption state (copied, the job starts at its sequence number)
+         * @param dst The output
+         * @param src The input
+         * @param length The input length
+         *
+         * @returns The future becomes ready when the job is done
+         */
+        std::future<void>   Submit (const Salsa20::State &state, void *dst, const void *src, size_t length) ;
+        /**
+         * Waits for all the submitted jobs.
+         */
+        void    Wait () ;
+    } ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_parallel_h__6e0f3a4d_1b7c_4c52_8d1e_5a9b2c7f0e31 */
+/*
+ * [END OF FILE]
+ */
@@ -0,0 +1,51 @@
+/*
+ * salsa20_pipeline.h: Asynchronous file encryption
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_pipeline_h__4f81c2d7_93ae_4b0e_a6d5_2c7e9f13b846
+#define salsa20_pipeline_h__4f81c2d7_93ae_4b0e_a6d5_2c7e9f13b846 1
+
+#include <cstddef>
+#include <cstdint>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    /// <summary>Tuning parameters of ApplyFile.</summary>
+    struct PipelineOptions {
+        /// # of bytes read/written at once (rounded up to the block size)
+        size_t  chunk_size = 1024 * 1024 ;
+        /// # of chunks in flight
+        size_t  queue_depth = 16 ;
+        /// # of encryption threads with io_uring (0 uses the # of hardware threads)
+        size_t  num_threads = 0 ;
+        /// Uses io_uring when available (otherwise `queue_depth` threads run pread/encrypt/pwrite)
+        bool    use_io_uring = true ;
+    } ;
+
+    /**
+     * Encrypts the whole file into another one (or into itself).
+     *
+     * @param state The encryption state (only the key and the initial vector are used)
+     * @param dst_fd The output file descriptor
+     * @param src_fd The input file descriptor (may be the same as `dst_fd`)
+     * @param options The tuning parameters
+     *
+     * @returns # of bytes processed (the size of the input)
+     *
+     * @remarks The byte at the file offset p is XORed with the byte at the
+     *          key stream offset p.  Reads, encryption and writes of
+     *          different chunks overlap.  The output is not truncated.
+     *          Throws std::system_error on I/O failures.
+     *          Available on POSIX systems only.
+     */
+    extern uint64_t ApplyFile (const Salsa20::State &state, int dst_fd, int src_fd, const PipelineOptions &options = PipelineOptions {}) ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_pipeline_h__4f81c2d7_93ae_4b0e_a6d5_2c7e9f13b846 */
+/*
+ * [END OF FILE]
+ */
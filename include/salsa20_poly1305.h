@@ -0,0 +1,127 @@
+/*
+ * salsa20_poly1305.h: Poly1305 one-time authenticator and XSalsa20-Poly1305 secret box
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_poly1305_h__e5a1c7f3_6b28_4d90_8c4e_1f7d3b9a2e05
+#define salsa20_poly1305_h__e5a1c7f3_6b28_4d90_8c4e_1f7d3b9a2e05 1
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    /// <summary>Computes the Poly1305 tag incrementally.</summary>
+    class Poly1305 {
+    public:
+        static constexpr size_t KEY_SIZE = 32 ;
+        static constexpr size_t TAG_SIZE = 16 ;
+    private:
+        /// The clamped key (limbs of 44, 44 and 42 bits)
+        std::array<uint64_t, 3> r_ ;
+        /// The accumulator (same as r_)
+        std::array<uint64_t, 3> h_ ;
+        /// The key part added at the end
+        std::array<uint64_t, 2> pad_ ;
+        std::array<uint8_t, 16> buffer_ ;
+        /// # of bytes held in buffer_
+        size_t      buffered_ ;
+    public:
+        /**
+         * Starts the computation.
+         *
+         * @param key The 32 bytes one-time key (should never be reused)
+         */
+        explicit Poly1305 (const void *key) ;
+
+        Poly1305 (const Poly1305 &) = delete ;
+
+        Poly1305 & operator = (const Poly1305 &) = delete ;
+
+        ~Poly1305 () ;
+        /**
+         * Absorbs the message.
+         *
+         * @param message The message
+         * @param length The message length
+         *
+         * @remarks Successive calls form a continuous message.
+         */
+        void    Update (const void *message, size_t length) ;
+        /**
+         * Finishes the computation.
+         *
+         * @param tag Receives the 16 bytes tag
+         */
+        void    Finish (void *tag) ;
+    } ;
+
+    /**
+     * Computes the Poly1305 tag.
+     *
+     * @param tag Receives the 16 bytes tag
+     * @param message The message
+     * @param length The message length
+     * @param key The 32 bytes one-time key
+     */
+    extern void ComputePoly1305 (void *tag, const void *message, size_t length, const void *key) ;
+
+    /**
+     * <summary>XSalsa20-Poly1305 authenticated encryption (compatible with NaCl crypto_secretbox).</summary>
+     *
+     * The Poly1305 key is the first 32 bytes of the key stream, the message
+     * is encrypted with the rest.  Each chunk is authenticated right after
+     * (or before, on Open) it is encrypted while it is still in the cache,
+     * so the message is read only once.
+     */
+    class SecretBox {
+    public:
+        static constexpr size_t KEY_SIZE = 32 ;
+        static constexpr size_t NONCE_SIZE = 24 ;
+        static constexpr size_t MAC_SIZE = Poly1305::TAG_SIZE ;
+    private:
+        std::array<uint8_t, KEY_SIZE>   key_ ;
+    public:
+        /**
+         * Creates the box.
+         *
+         * @param key The 32 bytes key
+         */
+        explicit SecretBox (const void *key) ;
+
+        ~SecretBox () ;
+        /**
+         * Encrypts and authenticates the message.
+         *
+         * @param box Receives the tag followed by the cipher text (MAC_SIZE + `length` bytes)
+         * @param message The message
+         * @param length The message length
+         * @param nonce The 24 bytes nonce (should never be reused with the same key)
+         *
+         * @remarks `message` may be equal to `box + MAC_SIZE`.
+         */
+        void    Seal (void *box, const void *message, size_t length, const void *nonce) const ;
+        /**
+         * Verifies and decrypts the box.
+         *
+         * @param message Receives the message (`box_size` - MAC_SIZE bytes)
+         * @param box The tag followed by the cipher text
+         * @param box_size The box size
+         * @param nonce The 24 bytes nonce
+         *
+         * @returns false if the box is forged (`message` is cleared)
+         *
+         * @remarks `message` may be equal to `box + MAC_SIZE`.
+         */
+        bool    Open (void *message, const void *box, size_t box_size, const void *nonce) const ;
+    } ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_poly1305_h__e5a1c7f3_6b28_4d90_8c4e_1f7d3b9a2e05 */
+/*
+ * [END OF FILE]
+ */
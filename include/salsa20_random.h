@@ -0,0 +1,34 @@
+/*
+ * salsa20_random.h: Cryptographically secure random bytes
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_random_h__4c8e2a17_93b5_4d0f_a6e1_2f7b9d3c5a80
+#define salsa20_random_h__4c8e2a17_93b5_4d0f_a6e1_2f7b9d3c5a80 1
+
+#include <cstddef>
+
+namespace Salsa20 {
+
+    /**
+     * Fills the buffer with cryptographically secure random bytes.
+     *
+     * @param output The output
+     * @param length # of bytes
+     *
+     * @remarks Each thread owns its generator seeded from the OS at the
+     *          first use (and again in the child after fork).  The key is
+     *          replaced with the fresh key stream on every refill, and the
+     *          handed out bytes are erased from the buffer, so a later
+     *          compromise of the memory does not reveal the past outputs.
+     *          Throws std::system_error if the OS fails to supply the seed.
+     */
+    extern void RandomBytes (void *output, size_t length) ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_random_h__4c8e2a17_93b5_4d0f_a6e1_2f7b9d3c5a80 */
+/*
+ * [END OF FILE]
+ */
@@ -0,0 +1,56 @@
+/*
+ * salsa20_scrypt.h: The scrypt password based key derivation function (RFC 7914)
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_scrypt_h__9c4e2a71_3f5b_4d86_b0e8_7a1d5c62f9b3
+#define salsa20_scrypt_h__9c4e2a71_3f5b_4d86_b0e8_7a1d5c62f9b3 1
+
+#include <cstddef>
+#include <cstdint>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    class Executor ;
+
+    /// <summary>Tuning parameters of Scrypt (they never change the result).</summary>
+    struct ScryptOptions {
+        /// Asks the OS to back the working memory with huge pages (POSIX systems only)
+        bool        use_huge_pages = true ;
+        /// The threads running the `p` lanes (nullptr starts the threads on demand)
+        Executor *  executor = nullptr ;
+        /// # of lanes run at once without `executor` (0 uses the # of hardware threads)
+        size_t      num_threads = 0 ;
+    } ;
+
+    /**
+     * Derives the key with scrypt.
+     *
+     * @param output Receives the derived key
+     * @param output_size The derived key length
+     * @param password The password
+     * @param password_size The password length
+     * @param salt The salt
+     * @param salt_size The salt length
+     * @param N The CPU/memory cost (a power of 2 greater than 1)
+     * @param r The block size
+     * @param p The parallelization
+     * @param options The tuning parameters
+     *
+     * @remarks Each lane running at once needs 128 * `r` * `N` bytes of the memory.
+     *          Throws std::invalid_argument for the parameters RFC 7914 rejects.
+     */
+    extern void Scrypt ( void *output, size_t output_size
+                       , const void *password, size_t password_size
+                       , const void *salt, size_t salt_size
+                       , uint64_t N, uint32_t r, uint32_t p
+                       , const ScryptOptions &options = ScryptOptions {}) ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_scrypt_h__9c4e2a71_3f5b_4d86_b0e8_7a1d5c62f9b3 */
+/*
+ * [END OF FILE]
+ */
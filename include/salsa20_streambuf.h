@@ -0,0 +1,266 @@
+/*
+ * salsa20_streambuf.h: The stream buffer applying salsa20 to another one
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_streambuf_h__b2e6f4a9_5c17_4e83_9f0d_6a4c1e8b7d25
+#define salsa20_streambuf_h__b2e6f4a9_5c17_4e83_9f0d_6a4c1e8b7d25 1
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ios>
+#include <streambuf>
+#include <vector>
+#include "salsa20.h"
+
+namespace Salsa20 {
+
+    /**
+     * <summary>Encrypts on write and decrypts on read over another stream buffer.</summary>
+     *
+     * The byte at the position p of this buffer is XORed with the byte at
+     * the offset p of the key stream.  The position 0 corresponds to the
+     * position of the wrapped buffer at the construction, so a plain header
+     * may precede the encrypted part.
+     */
+    template <typename CharT, typename Traits = std::char_traits<CharT>>
+        class basic_cipher_streambuf : public std::basic_streambuf<CharT, Traits> {
+            static_assert (sizeof (CharT) == 1, "Only byte streams are supported") ;
+        public:
+            using char_type = CharT ;
+            using traits_type = Traits ;
+            using int_type = typename Traits::int_type ;
+            using pos_type = typename Traits::pos_type ;
+            using off_type = typename Traits::off_type ;
+            using base_type = std::basic_streambuf<CharT, Traits> ;
+
+            static const size_t DEFAULT_BUFFER_SIZE = 64 * 1024 ;
+        private:
+            base_type *             inner_ ;
+            const State             state_ ;
+            /// The position of the wrapped buffer corresponding to our position 0
+            off_type                origin_ ;
+            /// Our position corresponding to the start of the get or put area
+            uint64_t                offset_ = 0 ;
+            std::vector<CharT>      buffer_ ;
+        public:
+            /**
+             * Wraps the stream buffer.
+             *
+             * @param inner The stream buffer to read from / write to
+             * @param state The encryption state (only the key and the initial vector are used)
+             * @param buffer_size The internal buffer size
+             */
+            basic_cipher_streambuf (base_type *inner, const State &state, size_t buffer_size = DEFAULT_BUFFER_SIZE)
+                    : inner_ (inner)
+                    , state_ (state)
+                    , origin_ (0)
+                    , buffer_ (buffer_size < 64 ? 64 : buffer_size) {
+                pos_type    pos = inner_->pubseekoff (0, std::ios_base::cur, std::ios_base::in | std::ios_base::out) ;
+                if (pos != pos_type (off_type (-1))) {
+                    origin_ = off_type (pos) ;
+                }
+            }
+
+            basic_cipher_streambuf (const basic_cipher_streambuf &) = delete ;
+
+            basic_cipher_streambuf & operator = (const basic_cipher_streambuf &) = delete ;
+
+            ~basic_cipher_streambuf () override {
+                Flush () ;
+            }
+        protected:
+            int_type    overflow (int_type ch) override {
+                if (this->gptr () != nullptr && ! LeaveGetArea ()) {
+                    return traits_type::eof () ;
+                }
+                if (this->pbase () == nullptr) {
+                    this->setp (buffer_.data (), buffer_.data () + buffer_.size ()) ;
+                }
+                else if (! Flush ()) {
+                    return traits_type::eof () ;
+                }
+                if (traits_type::eq_int_type (ch, traits_type::eof ())) {
+                    return traits_type::not_eof (ch) ;
+                }
+                *this->pptr () = traits_type::to_char_type (ch) ;
+                this->pbump (1) ;
+                return ch ;
+            }
+
+            std::streamsize xsputn (const char_type *s, std::streamsize count) override {
+                if (this->gptr () != nullptr && ! LeaveGetArea ()) {
+                    return 0 ;
+                }
+                if (count < static_cast<std::streamsize> (buffer_.size ())) {
+                    return base_type::xsputn (s, count) ;
+                }
+                // Large writes are encrypted chunk by chunk without going through the put area
+                if (this->pbase () != nullptr && ! Flush ()) {
+                    return 0 ;
+                }
+                std::streamsize done = 0 ;
+                while (done < count) {
+                    std::streamsize n = std::min<std::streamsize> (count - done, buffer_.size ()) ;
+                    ApplyAt (state_, buffer_.data (), s + done, static_cast<size_t> (n), offset_) ;
+                    std::streamsize written = inner_->sputn (buffer_.data (), n) ;
+                    offset_ += written ;
+                    done += written ;
+                    if (written < n) {
+                        break ;
+                    }
+                }
+                return done ;
+            }
+
+            int_type    underflow () override {
+                if (this->pbase () != nullptr && ! LeavePutArea ()) {
+                    return traits_type::eof () ;
+                }
+                if (this->gptr () != nullptr) {
+                    offset_ += this->egptr () - this->eback () ;
+                }
+                std::streamsize n = inner_->sgetn (buffer_.data (), buffer_.size ()) ;
+                this->setg (buffer_.data (), buffer_.data (), buffer_.data () + n) ;
+                if (n <= 0) {
+                    return traits_type::eof () ;
+                }
+                ApplyAt (state_, buffer_.data (), static_cast<size_t> (n), offset_) ;
+                return traits_type::to_int_type (*this->gptr ()) ;
+            }
+
+            std::streamsize xsgetn (char_type *s, std::streamsize count) override {
+                if (this->pbase () != nullptr && ! LeavePutArea ()) {
+                    return 0 ;
+                }
+                // Drains the get area first
+                std::streamsize done = 0 ;
+                if (this->gptr () != nullptr) {
+                    done = std::min<std::streamsize> (count, this->egptr () - this->gptr ()) ;
+                    traits_type::copy (s, this->gptr (), static_cast<size_t> (done)) ;
+                    this->gbump (static_cast<int> (done)) ;
+                }
+                if (count - done < static_cast<std::streamsize> (buffer_.size ())) {
+                    return done + base_type::xsgetn (s + done, count - done) ;
+                }
+                // Large reads are decrypted in place of the destination
+                uint64_t    pos = CurrentPosition () ;
+                std::streamsize n = inner_->sgetn (s + done, count - done) ;
+                if (0 < n) {
+                    ApplyAt (state_, s + done, static_cast<size_t> (n), pos) ;
+                }
+                offset_ = pos + n ;
+                this->setg (nullptr, nullptr, nullptr) ;
+                return done + n ;
+            }
+
+            int sync () override {
+                if (this->pbase () != nullptr && ! Flush ()) {
+                    return -1 ;
+                }
+                return inner_->pubsync () ;
+            }
+
+            pos_type    seekoff (off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+                const pos_type  failed { off_type (-1) } ;
+                if (dir == std::ios_base::cur && off == 0) {
+                    // tellp/tellg, neither flushes nor moves the wrapped buffer (it may not be seekable)
+                    return pos_type (off_type (CurrentPosition ())) ;
+                }
+                off_type    target ;
+                switch (dir) {
+                case std::ios_base::beg:
+                    target = off ;
+                    break ;
+                case std::ios_base::cur:
+                    target = static_cast<off_type> (CurrentPosition ()) + off ;
+                    break ;
+                default: {
+                        pos_type    end = inner_->pubseekoff (0, std::ios_base::end, which) ;
+                        if (end == failed) {
+                            return failed ;
+                        }
+                        target = off_type (end) - origin_ + off ;
+                    }
+                    break ;
+                }
+                return seekpos (pos_type (target), which) ;
+            }
+
+            pos_type    seekpos (pos_type pos, std::ios_base::openmode which) override {
+                const pos_type  failed { off_type (-1) } ;
+                if (off_type (pos) < 0) {
+                    return failed ;
+                }
+                if (this->pbase () != nullptr && ! Flush ()) {
+                    return failed ;
+                }
+                if (inner_->pubseekpos (pos_type (origin_ + off_type (pos)), which) == failed) {
+                    return failed ;
+                }
+                // The key stream offset is the position itself
+                offset_ = static_cast<uint64_t> (off_type (pos)) ;
+                this->setg (nullptr, nullptr, nullptr) ;
+                this->setp (nullptr, nullptr) ;
+                return pos ;
+            }
+        private:
+            uint64_t    CurrentPosition () const {
+                if (this->gptr () != nullptr) {
+                    return offset_ + (this->gptr () - this->eback ()) ;
+                }
+                if (this->pbase () != nullptr) {
+                    return offset_ + (this->pptr () - this->pbase ()) ;
+                }
+                return offset_ ;
+            }
+            /**
+             * Writes out the put area.
+             *
+             * @remarks On a short write, the unwritten bytes are dropped and
+             *          our position stays at the end of the written ones.
+             */
+            bool    Flush () {
+                std::streamsize n = this->pptr () - this->pbase () ;
+                if (n <= 0) {
+                    return true ;
+                }
+                ApplyAt (state_, this->pbase (), static_cast<size_t> (n), offset_) ;
+                std::streamsize written = inner_->sputn (this->pbase (), n) ;
+                if (0 < written) {
+                    offset_ += written ;
+                }
+                this->setp (buffer_.data (), buffer_.data () + buffer_.size ()) ;
+                if (written < n) {
+                    // Puts the wrapped buffer where the key stream continues (harmless if it is not seekable)
+                    inner_->pubseekpos (pos_type (origin_ + off_type (offset_)), std::ios_base::out) ;
+                    return false ;
+                }
+                return true ;
+            }
+            /**
+             * Moves the wrapped buffer back to our position (it has read ahead).
+             */
+            bool    LeaveGetArea () {
+                return seekpos (pos_type (off_type (CurrentPosition ())), std::ios_base::in | std::ios_base::out) != pos_type (off_type (-1)) ;
+            }
+
+            bool    LeavePutArea () {
+                if (! Flush ()) {
+                    return false ;
+                }
+                this->setp (nullptr, nullptr) ;
+                return true ;
+            }
+        } ;
+
+    using cipher_streambuf = basic_cipher_streambuf<char> ;
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_streambuf_h__b2e6f4a9_5c17_4e83_9f0d_6a4c1e8b7d25 */
+/*
+ * [END OF FILE]
+ */
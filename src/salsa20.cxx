@@ -7,17 +7,15 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include "salsa20.h"
+#include "salsa20_kernel.h"
 
 #if HAVE_CONFIG_H
 #   include "config.h"
 #endif
 
-#ifdef HAVE_SSE3
-#   include <xmmintrin.h>
-#endif
-
 static inline uint32_t ToInt32 (const void *start) {
 #if defined (TARGET_ALLOWS_UNALIGNED_ACCESS) && defined (TARGET_LITTLE_ENDIAN)
     return *(static_cast<const uint32_t *> (start)) ;
@@ -31,24 +29,6 @@ static inline uint32_t ToInt32 (const void *start) {
 #endif
 }
 
-static inline uint32_t  rot (uint32_t x, size_t n) {
-#if defined (_MSC_VER) && (1200 <= _MSC_VER)
-    return _rotl (x, n) ;
-#else
-    return(x << n) | (x >> (32 - n)) ;
-#endif
-}
-
-#ifdef HAVE_SSE3
-
-static inline __m128i   vrot (__m128i v, int cnt) {
-    __m128i t0 = _mm_slli_epi32 (v, cnt) ;
-    __m128i t1 = _mm_srli_epi32 (v, 32 - cnt) ;
-    return _mm_or_si128 (t0, t1) ;
-}
-
-#endif
-
 void    Salsa20::State::SetKey (const void *key, size_t key_size) {
     std::array<uint8_t, 32> K ;
 
@@ -104,6 +84,7 @@ void    Salsa20::State::SetKey (const void *key, size_t key_size) {
     state_ [ 7] = 0 ; // Initial vector (upper 32bits)
     state_ [ 8] = 0 ; // Sequence (lower 32bits)
     state_ [ 9] = 0 ; // Sequence (upper 32bits)
+    Precompute () ;
 }
 
 void    Salsa20::State::SetInitialVector (uint64_t iv) {
@@ -111,6 +92,31 @@ void    Salsa20::State::SetInitialVector (uint64_t iv) {
     state_ [7] = static_cast<uint32_t> (iv >> 32) ;
     state_ [8] = 0 ;
     state_ [9] = 0 ;
+    Precompute () ;
+}
+
+static inline uint32_t  rot (uint32_t x, size_t n) {
+    return (x << n) | (x >> (32 - n)) ;
+}
+
+void    Salsa20::State::Precompute () {
+    auto &  x = precomputed_ ;
+
+    x = state_ ;
+    // The quarter-rounds on the columns (10, 14, 2, 6) and (15, 3, 7, 11)
+    x [14] ^= rot (x [10] + x [ 6],  7) ;
+    x [ 2] ^= rot (x [14] + x [10],  9) ;
+    x [ 6] ^= rot (x [ 2] + x [14], 13) ;
+    x [10] ^= rot (x [ 6] + x [ 2], 18) ;
+
+    x [ 3] ^= rot (x [15] + x [11],  7) ;
+    x [ 7] ^= rot (x [ 3] + x [15],  9) ;
+    x [11] ^= rot (x [ 7] + x [ 3], 13) ;
+    x [15] ^= rot (x [11] + x [ 7], 18) ;
+    // The first steps of (0, 4, 8, 12) and (5, 9, 13, 1)
+    x [ 4] ^= rot (x [ 0] + x [12],  7) ;
+    x [ 8] = 0 ;
+    x [ 9] = rot (x [ 5] + x [ 1],  7) ;
 }
 
 uint64_t        Salsa20::State::GetSequenceNumber () const {
@@ -146,217 +152,43 @@ void    Salsa20::State::IncrementSequenceNumber () {
 #endif
 }
 
-#define SWAP_(a_, b_)   do {        \
-        __m128i     t_ = (a_) ;     \
-        (a_) = (b_) ;               \
-        (b_) = t_ ;                 \
-    } while (false)
-
-#define TRANSPOSE_(V0_, V1_, V2_, V3_) do {                 \
-        __m128i t0_ = _mm_unpacklo_epi32 ((V0_), (V1_)) ;   \
-        __m128i t1_ = _mm_unpacklo_epi32 ((V2_), (V3_)) ;   \
-        __m128i t2_ = _mm_unpackhi_epi32 ((V0_), (V1_)) ;   \
-        __m128i t3_ = _mm_unpackhi_epi32 ((V2_), (V3_)) ;   \
-        (V0_) = _mm_unpacklo_epi64 (t0_, t1_) ;             \
-        (V1_) = _mm_unpackhi_epi64 (t0_, t1_) ;             \
-        (V2_) = _mm_unpacklo_epi64 (t2_, t3_) ;             \
-        (V3_) = _mm_unpackhi_epi64 (t2_, t3_) ;             \
-    } while (false)
-
 Salsa20::hash_value_t   Salsa20::State::ComputeHashValue () const {
-    const int   STATE_SIZE = state_.size () ;
-
-    const int   NUM_ROUNDS = 10 ;
-
-#ifdef HAVE_SSE3
-    __m128i     v0orig = _mm_loadu_si128 ((const __m128i *)&state_ [ 0]) ;
-    __m128i     v1orig = _mm_loadu_si128 ((const __m128i *)&state_ [ 4]) ;
-    __m128i     v2orig = _mm_loadu_si128 ((const __m128i *)&state_ [ 8]) ;
-    __m128i     v3orig = _mm_loadu_si128 ((const __m128i *)&state_ [12]) ;
-
-    __m128i     v0 = v0orig ;
-    __m128i     v1 = v1orig ;
-    __m128i     v2 = v2orig ;
-    __m128i     v3 = v3orig ;
-
-    //  3  2  1  0
-    //  7  6  5  4
-    // 11 10  9  8
-    // 15 14 13 12
-    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (0, 3, 2, 1)) ;
-    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
-    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (2, 1, 0, 3)) ;
-    //  3  2  1  0
-    //  4  7  6  5
-    //  9  8 11 10
-    // 14 13 12 15
-    TRANSPOSE_(v0, v1, v2, v3) ;
-    // 15 10  5  0
-    // 12 11  6  1
-    // 13  8  7  2
-    // 14  9  4  3
-    SWAP_(v1, v3) ;
-    // 15 10  5  0
-    // 14  9  4  3
-    // 13  8  7  2
-    // 12 11  6  1
-    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (0, 3, 2, 1)) ;
-    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
-    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (2, 1, 0, 3)) ;
-    // 15 10  5  0
-    //  3 14  9  4
-    //  7  2 13  8
-    // 11  6  1 12
-    v1 = _mm_xor_si128 (v1, vrot (_mm_add_epi32 (v0, v3),  7)) ;
-    v2 = _mm_xor_si128 (v2, vrot (_mm_add_epi32 (v1, v0),  9)) ;
-    v3 = _mm_xor_si128 (v3, vrot (_mm_add_epi32 (v2, v1), 13)) ;
-    v0 = _mm_xor_si128 (v0, vrot (_mm_add_epi32 (v3, v2), 18)) ;
-
-    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (2, 1, 0, 3)) ;
-    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
-    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (0, 3, 2, 1)) ;
-    // 15 10  5  0
-    // 14  9  4  3
-    // 13  8  7  2
-    // 12 11  6  1
-    v3 = _mm_xor_si128 (v3, vrot (_mm_add_epi32 (v0, v1),  7)) ;
-    v2 = _mm_xor_si128 (v2, vrot (_mm_add_epi32 (v3, v0),  9)) ;
-    v1 = _mm_xor_si128 (v1, vrot (_mm_add_epi32 (v2, v3), 13)) ;
-    v0 = _mm_xor_si128 (v0, vrot (_mm_add_epi32 (v1, v2), 18)) ;
-    for (int i = 1 ; i < NUM_ROUNDS ; ++i) {
-        // 15 10  5  0
-        // 14  9  4  3
-        // 13  8  7  2
-        // 12 11  6  1
-        v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (0, 3, 2, 1)) ;
-        v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
-        v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (2, 1, 0, 3)) ;
-        // 15 10  5  0
-        //  3 14  9  4
-        //  7  2 13  8
-        // 11  6  1 12
-        v1 = _mm_xor_si128 (v1, vrot (_mm_add_epi32 (v0, v3),  7)) ;
-        v2 = _mm_xor_si128 (v2, vrot (_mm_add_epi32 (v1, v0),  9)) ;
-        v3 = _mm_xor_si128 (v3, vrot (_mm_add_epi32 (v2, v1), 13)) ;
-        v0 = _mm_xor_si128 (v0, vrot (_mm_add_epi32 (v3, v2), 18)) ;
-
-        v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (2, 1, 0, 3)) ;
-        v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
-        v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (0, 3, 2, 1)) ;
-        // 15 10  5  0
-        // 14  9  4  3
-        // 13  8  7  2
-        // 12 11  6  1
-        v3 = _mm_xor_si128 (v3, vrot (_mm_add_epi32 (v0, v1),  7)) ;
-        v2 = _mm_xor_si128 (v2, vrot (_mm_add_epi32 (v3, v0),  9)) ;
-        v1 = _mm_xor_si128 (v1, vrot (_mm_add_epi32 (v2, v3), 13)) ;
-        v0 = _mm_xor_si128 (v0, vrot (_mm_add_epi32 (v1, v2), 18)) ;
-    }
-    TRANSPOSE_ (v0, v1, v2, v3) ;
-    //  1  2  3  0
-    //  6  7  4  5
-    // 11  8  9 10
-    // 12 13 14 15
-    v0 = _mm_shuffle_epi32 (v0, _MM_SHUFFLE (1, 2, 3, 0)) ;
-    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (2, 3, 0, 1)) ;
-    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (3, 0, 1, 2)) ;
-    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (0, 1, 2, 3)) ;
-    //  3  2  1  0
-    //  7  6  5  4
-    // 11 10  9  8
-    // 15 14 13 12
-    v0 = _mm_add_epi32 (v0, v0orig) ;
-    v1 = _mm_add_epi32 (v1, v1orig) ;
-    v2 = _mm_add_epi32 (v2, v2orig) ;
-    v3 = _mm_add_epi32 (v3, v3orig) ;
-
-    hash_value_t result ;
-    {
-        _mm_storeu_si128 ((__m128i *)&result [ 0], v0) ;
-        _mm_storeu_si128 ((__m128i *)&result [16], v1) ;
-        _mm_storeu_si128 ((__m128i *)&result [32], v2) ;
-        _mm_storeu_si128 ((__m128i *)&result [48], v3) ;
-    }
-    return result ;
-#else
-    uint32_t    x [STATE_SIZE] ;
-
-    for (int i = 0 ; i < STATE_SIZE ; ++i) {
-        x [i] = state_ [i] ;
-    }
-    for (int i = 0 ; i < NUM_ROUNDS ; ++i) {
-        x[ 4] ^= rot (x[ 0] + x[12],  7) ;
-        x[ 8] ^= rot (x[ 4] + x[ 0],  9) ;
-        x[12] ^= rot (x[ 8] + x[ 4], 13) ;
-        x[ 0] ^= rot (x[12] + x[ 8], 18) ;
-
-        x[ 9] ^= rot (x[ 5] + x[ 1],  7) ;
-        x[13] ^= rot (x[ 9] + x[ 5],  9) ;
-        x[ 1] ^= rot (x[13] + x[ 9], 13) ;
-        x[ 5] ^= rot (x[ 1] + x[13], 18) ;
-
-        x[14] ^= rot (x[10] + x[ 6],  7) ;
-        x[ 2] ^= rot (x[14] + x[10],  9) ;
-        x[ 6] ^= rot (x[ 2] + x[14], 13) ;
-        x[10] ^= rot (x[ 6] + x[ 2], 18) ;
-
-        x[ 3] ^= rot (x[15] + x[11],  7) ;
-        x[ 7] ^= rot (x[ 3] + x[15],  9) ;
-        x[11] ^= rot (x[ 7] + x[ 3], 13) ;
-        x[15] ^= rot (x[11] + x[ 7], 18) ;
-        //
-        x[ 1] ^= rot (x[ 0] + x[ 3],  7) ;
-        x[ 2] ^= rot (x[ 1] + x[ 0],  9) ;
-        x[ 3] ^= rot (x[ 2] + x[ 1], 13) ;
-        x[ 0] ^= rot (x[ 3] + x[ 2], 18) ;
-
-        x[ 6] ^= rot (x[ 5] + x[ 4],  7) ;
-        x[ 7] ^= rot (x[ 6] + x[ 5],  9) ;
-        x[ 4] ^= rot (x[ 7] + x[ 6], 13) ;
-        x[ 5] ^= rot (x[ 4] + x[ 7], 18) ;
-
-        x[11] ^= rot (x[10] + x[ 9],  7) ;
-        x[ 8] ^= rot (x[11] + x[10],  9) ;
-        x[ 9] ^= rot (x[ 8] + x[11], 13) ;
-        x[10] ^= rot (x[ 9] + x[ 8], 18) ;
-
-        x[12] ^= rot (x[15] + x[14],  7) ;
-        x[13] ^= rot (x[12] + x[15],  9) ;
-        x[14] ^= rot (x[13] + x[12], 13) ;
-        x[15] ^= rot (x[14] + x[13], 18) ;
-    }
-
     hash_value_t    result ;
-    for (int i = 0 ; i < STATE_SIZE ; ++i) {
-        uint32_t        v = x [i] + state_ [i] ;
-
-        result [4 * i + 0] = static_cast<unsigned char> (v >>  0) ;
-        result [4 * i + 1] = static_cast<unsigned char> (v >>  8) ;
-        result [4 * i + 2] = static_cast<unsigned char> (v >> 16) ;
-        result [4 * i + 3] = static_cast<unsigned char> (v >> 24) ;
-    }
+    Kernel::Active ().computeHashValue (state_, result.data ()) ;
     return result ;
-#endif
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
+/**
+ * Applies the key stream to the full blocks in bulk.
+ *
+ * @param state The encryption state (sequence number is advanced)
+ * @param dst The output
+ * @param src The input
+ * @param count # of blocks to process
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds
+ */
+template <int DOUBLE_ROUNDS = 10>
+static void     ApplyBlocks (Salsa20::State &state, uint8_t *dst, const uint8_t *src, size_t count) {
+    using namespace Salsa20 ;
+    if (0 < count) {
+        uint64_t    seq = state.GetSequenceNumber () ;
+        Kernel::ForRounds<DOUBLE_ROUNDS> (Kernel::Active ()).applyBlocks (StateAccess::Words (state), StateAccess::Precomputed (state), seq, dst, src, count) ;
+        state.SetSequenceNumber (seq + count) ;
+    }
+}
+
 void    Salsa20::Apply (Salsa20::State &state, void *dst, const void *src, size_t length) {
 
     auto    p = static_cast<const uint8_t *> (src) ;
     auto    q = static_cast<uint8_t *> (dst) ;
 
     size_t  cnt = length / std::tuple_size<hash_value_t>::value ;
-    for (size_t i = 0 ; i < cnt ; ++i) {
-        auto const hash = state.ComputeHashValue () ;
-        state.IncrementSequenceNumber () ;
-
-        for (size_t i = 0 ; i < hash.size () ; ++i) {
-            q [i] = p [i] ^ hash [i] ;
-        }
-        p += hash.size () ;
-        q += hash.size () ;
-    }
+    ApplyBlocks (state, q, p, cnt) ;
+    p += cnt * std::tuple_size<hash_value_t>::value ;
+    q += cnt * std::tuple_size<hash_value_t>::value ;
     size_t remain = length - (cnt * std::tuple_size<hash_value_t>::value) ;
     if (0 < remain) {
         auto const hash = state.ComputeHashValue () ;
@@ -380,23 +212,79 @@ static inline uint64_t  OffsetToSequenceNumber (uint64_t offset) {
     return offset / std::tuple_size <Salsa20::hash_value_t>::value ;
 }
 
-void    Salsa20::Apply (Salsa20::State &state, void *dst, const void *src, size_t length, uint64_t offset) {
-    auto    p = static_cast<const uint8_t *> (src) ;
-    auto    q = static_cast<uint8_t *> (dst) ;
-    auto    end = p + length ;
-
-    state.SetSequenceNumber (OffsetToSequenceNumber (offset)) ;
-    auto hash = state.ComputeHashValue () ;
+/**
+ * Applies the key stream starting from the arbitrary byte offset.
+ *
+ * Only the unaligned head and tail are processed byte-wise, full blocks in
+ * between go through the bulk kernel.
+ * The state is only read (its sequence number is ignored).
+ *
+ * @param state The encryption state
+ * @param dst The output
+ * @param src The input (may be equal to `dst`)
+ * @param length The input length
+ * @param offset The start offset
+ *
+ * @returns The sequence number the stateful Apply leaves
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds
+ */
+template <int DOUBLE_ROUNDS = 10>
+static uint64_t ApplyWithOffset (const Salsa20::State &state, uint8_t *dst, const uint8_t *src, size_t length, uint64_t offset) {
+    using namespace Salsa20 ;
+    const size_t    BLOCK_SIZE = std::tuple_size<hash_value_t>::value ;
+
+    auto const      kernel = Kernel::ForRounds<DOUBLE_ROUNDS> (Kernel::Active ()) ;
+    auto const &    words = StateAccess::Words (state) ;
+    uint64_t        seq = OffsetToSequenceNumber (offset) ;
+    hash_value_t    hash ;
+
+    size_t  head = static_cast<size_t> (offset % BLOCK_SIZE) ;
+    if (head != 0) {
+        kernel.computeHashValue (Kernel::WithSequenceNumber (words, seq), hash.data ()) ;
+        size_t      n = (length < BLOCK_SIZE - head) ? length : BLOCK_SIZE - head ;
+
+        for (size_t i = 0 ; i < n ; ++i) {
+            dst [i] = src [i] ^ hash [head + i] ;
+        }
+        if (head + n == BLOCK_SIZE) {
+            ++seq ;
+        }
+        src += n ;
+        dst += n ;
+        length -= n ;
+    }
+    size_t  cnt = length / BLOCK_SIZE ;
+    if (0 < cnt) {
+        kernel.applyBlocks (words, StateAccess::Precomputed (state), seq, dst, src, cnt) ;
+        seq += cnt ;
+        src += cnt * BLOCK_SIZE ;
+        dst += cnt * BLOCK_SIZE ;
+    }
+    size_t  remain = length - cnt * BLOCK_SIZE ;
+    if (0 < remain) {
+        // Sequence number stays at the partially consumed block
+        kernel.computeHashValue (Kernel::WithSequenceNumber (words, seq), hash.data ()) ;
 
-    size_t      i = static_cast<size_t> (offset % hash.size ()) ;
-    while (p < end) {
-        *q++ = *p++ ^ hash [i++] ;
-        if (hash.size () <= i) {
-            state.IncrementSequenceNumber () ;
-            hash = state.ComputeHashValue () ;
-            i = 0 ;
+        for (size_t i = 0 ; i < remain ; ++i) {
+            dst [i] = src [i] ^ hash [i] ;
         }
     }
+    return seq ;
+}
+
+void    Salsa20::Apply (Salsa20::State &state, void *dst, const void *src, size_t length, uint64_t offset) {
+    state.SetSequenceNumber (ApplyWithOffset (state, static_cast<uint8_t *> (dst), static_cast<const uint8_t *> (src), length, offset)) ;
+}
+
+void    Salsa20::ApplyAt (const Salsa20::State &state, void *dst, const void *src, size_t length, uint64_t offset) {
+    ApplyWithOffset (state, static_cast<uint8_t *> (dst), static_cast<const uint8_t *> (src), length, offset) ;
+}
+
+void    Salsa20::ApplyAt (const Salsa20::State &state, void *message, size_t length, uint64_t offset) {
+    auto    p = static_cast<uint8_t *> (message) ;
+
+    ApplyWithOffset (state, p, p, length, offset) ;
 }
 
 void    Salsa20::Apply (Salsa20::State &state, void *message, size_t length) {
@@ -404,44 +292,359 @@ void    Salsa20::Apply (Salsa20::State &state, void *message, size_t length) {
     auto    p = static_cast<uint8_t *> (message) ;
 
     size_t  cnt = length / std::tuple_size<hash_value_t>::value ;
-    for (int i = 0 ; i < cnt ; ++i) {
-        auto hash = state.ComputeHashValue () ;
+    ApplyBlocks (state, p, p, cnt) ;
+    p += cnt * std::tuple_size<hash_value_t>::value ;
+    size_t remain = length - (cnt * std::tuple_size<hash_value_t>::value) ;
+    if (0 < remain) {
+        auto const hash = state.ComputeHashValue () ;
         state.IncrementSequenceNumber () ;
 
-        for (size_t i = 0 ; i < hash.size () ; ++i) {
+        for (size_t i = 0 ; i < remain ; ++i) {
             p [i] ^= hash [i] ;
         }
-        p += hash.size () ;
     }
+}
+
+void    Salsa20::Apply (Salsa20::State &state, void *message, size_t length, uint64_t offset) {
+    auto    p = static_cast<uint8_t *> (message) ;
+
+    state.SetSequenceNumber (ApplyWithOffset (state, p, p, length, offset)) ;
+}
+
+void    Salsa20::Apply (Salsa20::State &state, const IOVec *dst, size_t dst_count, const IOVec *src, size_t src_count) {
+    StreamCipher    cipher { state } ;
+
+    size_t  d = 0 ;
+    size_t  d_used = 0 ;
+    for (size_t s = 0 ; s < src_count ; ++s) {
+        auto    p = static_cast<const uint8_t *> (src [s].base) ;
+        size_t  remain = src [s].length ;
+        while (0 < remain && d < dst_count) {
+            size_t  avail = dst [d].length - d_used ;
+            size_t  n = (remain < avail) ? remain : avail ;
+
+            cipher.Process (static_cast<uint8_t *> (dst [d].base) + d_used, p, n) ;
+            p += n ;
+            remain -= n ;
+            d_used += n ;
+            if (dst [d].length <= d_used) {
+                ++d ;
+                d_used = 0 ;
+            }
+        }
+    }
+    state = cipher.GetState () ;
+}
+
+void    Salsa20::Apply (Salsa20::State &state, const IOVec *message, size_t count) {
+    StreamCipher    cipher { state } ;
+
+    for (size_t i = 0 ; i < count ; ++i) {
+        cipher.Process (message [i].base, message [i].length) ;
+    }
+    state = cipher.GetState () ;
+}
+
+void    Salsa20::ApplyBatch ( const Salsa20::State *states
+                            , void * const *dst, const void * const *src, const size_t *length
+                            , size_t count) {
+    const size_t    BLOCK_SIZE = Kernel::BLOCK_SIZE ;
+
+    /// <summary>A message assigned to the lane.</summary>
+    struct Slot {
+        Kernel::input_t input ;
+        uint8_t *       dst ;
+        const uint8_t * src ;
+        size_t          remain ;
+    } ;
+
+    auto const &    kernel = Kernel::Active () ;
+    const size_t    lanes = kernel.lanes ;
+
+    Slot            slots [Kernel::MAX_LANES] ;
+    size_t          active = 0 ;
+    size_t          next = 0 ;
+
+    Kernel::input_t         inputs [Kernel::MAX_LANES] ;
+    uint8_t *               d [Kernel::MAX_LANES] ;
+    const uint8_t *         s [Kernel::MAX_LANES] ;
+    alignas (64) uint8_t    tail_src [Kernel::MAX_LANES][BLOCK_SIZE] ;
+    alignas (64) uint8_t    tail_dst [Kernel::MAX_LANES][BLOCK_SIZE] ;
+
+    for (;;) {
+        // Assigns pending messages to the vacant lanes
+        while (active < lanes && next < count) {
+            if (0 < length [next]) {
+                auto &  slot = slots [active++] ;
+                slot.input = StateAccess::Words (states [next]) ;
+                slot.dst = static_cast<uint8_t *> (dst [next]) ;
+                slot.src = static_cast<const uint8_t *> (src [next]) ;
+                slot.remain = length [next] ;
+            }
+            ++next ;
+        }
+        if (active == 0) {
+            break ;
+        }
+        for (size_t i = 0 ; i < lanes ; ++i) {
+            // Unused lanes duplicate the first one and go to the scratch buffer
+            auto const &    slot = slots [(i < active) ? i : 0] ;
+            inputs [i] = slot.input ;
+            if (i < active && BLOCK_SIZE <= slot.remain) {
+                d [i] = slot.dst ;
+                s [i] = slot.src ;
+            }
+            else {
+                size_t  n = (i < active) ? slot.remain : 0 ;
+                ::memcpy (tail_src [i], slot.src, n) ;
+                d [i] = tail_dst [i] ;
+                s [i] = tail_src [i] ;
+            }
+        }
+        kernel.applyLanes (inputs, d, s) ;
+
+        for (size_t i = 0 ; i < active ; ++i) {
+            auto &  slot = slots [i] ;
+            if (slot.remain < BLOCK_SIZE) {
+                ::memcpy (slot.dst, tail_dst [i], slot.remain) ;
+                slot.remain = 0 ;
+            }
+            else {
+                slot.dst += BLOCK_SIZE ;
+                slot.src += BLOCK_SIZE ;
+                slot.remain -= BLOCK_SIZE ;
+            }
+            // Increments the sequence number
+            if (++slot.input [8] == 0) {
+                ++slot.input [9] ;
+            }
+        }
+        // Vacates the lanes of finished messages
+        for (size_t i = 0 ; i < active ; ) {
+            if (slots [i].remain == 0) {
+                slots [i] = slots [--active] ;
+            }
+            else {
+                ++i ;
+            }
+        }
+    }
+}
+
+void    Salsa20::GenerateKeystream (Salsa20::State &state, void *output, size_t nblocks) {
+    ApplyBlocks (state, static_cast<uint8_t *> (output), nullptr, nblocks) ;
+}
+
+void    Salsa20::GenerateKeystreamBytes (Salsa20::State &state, void *output, size_t length) {
+    auto    q = static_cast<uint8_t *> (output) ;
+
+    size_t  cnt = length / std::tuple_size<hash_value_t>::value ;
+    ApplyBlocks (state, q, nullptr, cnt) ;
+    q += cnt * std::tuple_size<hash_value_t>::value ;
     size_t remain = length - (cnt * std::tuple_size<hash_value_t>::value) ;
     if (0 < remain) {
         auto const hash = state.ComputeHashValue () ;
         state.IncrementSequenceNumber () ;
 
-        for (size_t i = 0 ; i < remain ; ++i) {
-            p [i] ^= hash [i] ;
-        }
+        ::memcpy (q, hash.data (), remain) ;
     }
 }
 
-void    Salsa20::Apply (Salsa20::State &state, void *message, size_t length, uint64_t offset) {
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
-    auto    p = static_cast<uint8_t *> (message) ;
-    auto    end = p + length ;
+/**
+ * Derives the XSalsa20 subkey.
+ *
+ * @param key The state holding the key
+ * @param subkey Receives the 32 bytes subkey
+ * @param nonce The first 16 bytes of the nonce
+ */
+static void     DeriveSubkey (const Salsa20::State &key, uint8_t *subkey, const uint8_t *nonce) {
+    using namespace Salsa20 ;
+
+    Kernel::input_t input = StateAccess::Words (key) ;
+    input [6] = ToInt32 (&nonce [ 0]) ;
+    input [7] = ToInt32 (&nonce [ 4]) ;
+    input [8] = ToInt32 (&nonce [ 8]) ;
+    input [9] = ToInt32 (&nonce [12]) ;
+
+    uint32_t    words [8] ;
+    Kernel::Active ().hSalsa20 (input, words) ;
+    for (int i = 0 ; i < 8 ; ++i) {
+        subkey [4 * i + 0] = static_cast<uint8_t> (words [i] >>  0) ;
+        subkey [4 * i + 1] = static_cast<uint8_t> (words [i] >>  8) ;
+        subkey [4 * i + 2] = static_cast<uint8_t> (words [i] >> 16) ;
+        subkey [4 * i + 3] = static_cast<uint8_t> (words [i] >> 24) ;
+    }
+}
+
+void    Salsa20::HSalsa20 (void *subkey, const void *key, size_t key_size, const void *nonce) {
+    DeriveSubkey (State { key, key_size }, static_cast<uint8_t *> (subkey), static_cast<const uint8_t *> (nonce)) ;
+}
+
+void    Salsa20::XState::SetNonce (const void *nonce) {
+    auto    n = static_cast<const uint8_t *> (nonce) ;
+
+    std::array<uint8_t, 32> subkey ;
+    DeriveSubkey (key_, subkey.data (), n) ;
+    state_.SetKey (subkey.data (), subkey.size ()) ;
+    state_.SetInitialVector ( (static_cast<uint64_t> (ToInt32 (&n [16])) <<  0)
+                            | (static_cast<uint64_t> (ToInt32 (&n [20])) << 32)) ;
+}
+
+void    Salsa20::Apply (XState &state, void *dst, const void *src, size_t length) {
+    Apply (StateAccess::Inner (state), dst, src, length) ;
+}
+
+void    Salsa20::Apply (XState &state, void *dst, const void *src, size_t length, uint64_t offset) {
+    Apply (StateAccess::Inner (state), dst, src, length, offset) ;
+}
+
+void    Salsa20::Apply (XState &state, void *message, size_t length) {
+    Apply (StateAccess::Inner (state), message, length) ;
+}
+
+void    Salsa20::Apply (XState &state, void *message, size_t length, uint64_t offset) {
+    Apply (StateAccess::Inner (state), message, length, offset) ;
+}
+
+void    Salsa20::ApplyAt (const XState &state, void *dst, const void *src, size_t length, uint64_t offset) {
+    ApplyAt (StateAccess::Inner (state), dst, src, length, offset) ;
+}
 
-    state.SetSequenceNumber (OffsetToSequenceNumber (offset)) ;
-    auto hash = state.ComputeHashValue () ;
+void    Salsa20::ApplyAt (const XState &state, void *message, size_t length, uint64_t offset) {
+    ApplyAt (StateAccess::Inner (state), message, length, offset) ;
+}
+
+void    Salsa20::GenerateKeystream (XState &state, void *output, size_t nblocks) {
+    GenerateKeystream (StateAccess::Inner (state), output, nblocks) ;
+}
 
-    size_t      i = static_cast<size_t> (offset % hash.size ()) ;
-    while (p < end) {
-        *p++ ^= hash [i++] ;
-        if (sizeof (hash) <= i) {
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+template <int DOUBLE_ROUNDS>
+    Salsa20::hash_value_t   Salsa20::RoundState<DOUBLE_ROUNDS>::ComputeHashValue () const {
+        hash_value_t    result ;
+        Kernel::ForRounds<DOUBLE_ROUNDS> (Kernel::Active ()).computeHashValue (StateAccess::Words (state_), result.data ()) ;
+        return result ;
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::Apply (RoundState<DOUBLE_ROUNDS> &state, void *dst, const void *src, size_t length) {
+        const size_t    BLOCK_SIZE = Kernel::BLOCK_SIZE ;
+
+        auto    p = static_cast<const uint8_t *> (src) ;
+        auto    q = static_cast<uint8_t *> (dst) ;
+
+        size_t  cnt = length / BLOCK_SIZE ;
+        ApplyBlocks<DOUBLE_ROUNDS> (StateAccess::Inner (state), q, p, cnt) ;
+        p += cnt * BLOCK_SIZE ;
+        q += cnt * BLOCK_SIZE ;
+        size_t  remain = length - cnt * BLOCK_SIZE ;
+        if (0 < remain) {
+            auto const hash = state.ComputeHashValue () ;
             state.IncrementSequenceNumber () ;
-            hash = state.ComputeHashValue () ;
-            i = 0 ;
+
+            for (size_t i = 0 ; i < remain ; ++i) {
+                q [i] = p [i] ^ hash [i] ;
+            }
+        }
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::Apply (RoundState<DOUBLE_ROUNDS> &state, void *dst, const void *src, size_t length, uint64_t offset) {
+        state.SetSequenceNumber (ApplyWithOffset<DOUBLE_ROUNDS> (StateAccess::Inner (state), static_cast<uint8_t *> (dst), static_cast<const uint8_t *> (src), length, offset)) ;
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::Apply (RoundState<DOUBLE_ROUNDS> &state, void *message, size_t length) {
+        Apply (state, message, message, length) ;
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::Apply (RoundState<DOUBLE_ROUNDS> &state, void *message, size_t length, uint64_t offset) {
+        Apply (state, message, message, length, offset) ;
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::ApplyAt (const RoundState<DOUBLE_ROUNDS> &state, void *dst, const void *src, size_t length, uint64_t offset) {
+        ApplyWithOffset<DOUBLE_ROUNDS> (StateAccess::Inner (state), static_cast<uint8_t *> (dst), static_cast<const uint8_t *> (src), length, offset) ;
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::ApplyAt (const RoundState<DOUBLE_ROUNDS> &state, void *message, size_t length, uint64_t offset) {
+        auto    p = static_cast<uint8_t *> (message) ;
+
+        ApplyWithOffset<DOUBLE_ROUNDS> (StateAccess::Inner (state), p, p, length, offset) ;
+    }
+
+template <int DOUBLE_ROUNDS>
+    void    Salsa20::GenerateKeystream (RoundState<DOUBLE_ROUNDS> &state, void *output, size_t nblocks) {
+        ApplyBlocks<DOUBLE_ROUNDS> (StateAccess::Inner (state), static_cast<uint8_t *> (output), nullptr, nblocks) ;
+    }
+
+#define INSTANTIATE_ROUNDS_(R_)                                                                                           \
+    template class Salsa20::RoundState<R_> ;                                                                              \
+    template void   Salsa20::Apply<R_> (RoundState<R_> &, void *, const void *, size_t) ;                                 \
+    template void   Salsa20::Apply<R_> (RoundState<R_> &, void *, const void *, size_t, uint64_t) ;                       \
+    template void   Salsa20::Apply<R_> (RoundState<R_> &, void *, size_t) ;                                               \
+    template void   Salsa20::Apply<R_> (RoundState<R_> &, void *, size_t, uint64_t) ;                                     \
+    template void   Salsa20::ApplyAt<R_> (const RoundState<R_> &, void *, const void *, size_t, uint64_t) ;               \
+    template void   Salsa20::ApplyAt<R_> (const RoundState<R_> &, void *, size_t, uint64_t) ;                             \
+    template void   Salsa20::GenerateKeystream<R_> (RoundState<R_> &, void *, size_t)
+
+INSTANTIATE_ROUNDS_ (4) ;
+INSTANTIATE_ROUNDS_ (6) ;
+INSTANTIATE_ROUNDS_ (10) ;
+
+#undef INSTANTIATE_ROUNDS_
+
+void    Salsa20::StreamCipher::Seek (uint64_t offset) {
+    state_.SetSequenceNumber (OffsetToSequenceNumber (offset)) ;
+    position_ = static_cast<size_t> (offset % buffer_.size ()) ;
+    if (position_ == 0) {
+        position_ = buffer_.size () ;
+    }
+    else {
+        buffer_ = state_.ComputeHashValue () ;
+        state_.IncrementSequenceNumber () ;
+    }
+}
+
+void    Salsa20::StreamCipher::Process (void *dst, const void *src, size_t length) {
+    const size_t    BLOCK_SIZE = std::tuple_size<hash_value_t>::value ;
+
+    auto    p = static_cast<const uint8_t *> (src) ;
+    auto    q = static_cast<uint8_t *> (dst) ;
+
+    // Consumes the rest of the buffered key stream first
+    if (position_ < BLOCK_SIZE) {
+        size_t  n = (length < BLOCK_SIZE - position_) ? length : BLOCK_SIZE - position_ ;
+
+        for (size_t i = 0 ; i < n ; ++i) {
+            q [i] = p [i] ^ buffer_ [position_ + i] ;
+        }
+        position_ += n ;
+        p += n ;
+        q += n ;
+        length -= n ;
+    }
+    size_t  cnt = length / BLOCK_SIZE ;
+    ApplyBlocks (state_, q, p, cnt) ;
+    p += cnt * BLOCK_SIZE ;
+    q += cnt * BLOCK_SIZE ;
+
+    size_t  remain = length - cnt * BLOCK_SIZE ;
+    if (0 < remain) {
+        buffer_ = state_.ComputeHashValue () ;
+        state_.IncrementSequenceNumber () ;
+        for (size_t i = 0 ; i < remain ; ++i) {
+            q [i] = p [i] ^ buffer_ [i] ;
         }
+        position_ = remain ;
     }
 }
+
 /*
  * [END OF FILE]
  */
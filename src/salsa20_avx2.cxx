@@ -0,0 +1,484 @@
+/*
+ * salsa20_avx2.cxx: The AVX2 salsa20 kernel.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include "salsa20_kernel.h"
+#include "salsa20_poly1305_core.h"
+#include <immintrin.h>
+
+static inline __m256i  vrot8 (__m256i v, int cnt) {
+    __m256i t0 = _mm256_slli_epi32 (v, cnt) ;
+    __m256i t1 = _mm256_srli_epi32 (v, 32 - cnt) ;
+    return _mm256_or_si256 (t0, t1) ;
+}
+
+/**
+ * Stores the key stream (XORed with the source if supplied).
+ */
+static inline void  Store (uint8_t *dst, const uint8_t *src, size_t offset, __m256i v) {
+    if (src != nullptr) {
+        v = _mm256_xor_si256 (v, _mm256_loadu_si256 ((const __m256i *)&src [offset])) ;
+    }
+    _mm256_storeu_si256 ((__m256i *)&dst [offset], v) ;
+}
+
+#define QUARTERROUND8_(a_, b_, c_, d_)  do {                                              \
+        x [b_] = _mm256_xor_si256 (x [b_], vrot8 (_mm256_add_epi32 (x [a_], x [d_]),  7)) ; \
+        x [c_] = _mm256_xor_si256 (x [c_], vrot8 (_mm256_add_epi32 (x [b_], x [a_]),  9)) ; \
+        x [d_] = _mm256_xor_si256 (x [d_], vrot8 (_mm256_add_epi32 (x [c_], x [b_]), 13)) ; \
+        x [a_] = _mm256_xor_si256 (x [a_], vrot8 (_mm256_add_epi32 (x [d_], x [c_]), 18)) ; \
+    } while (false)
+
+// The last 3 steps of QUARTERROUND8_
+#define FINISHQUARTERROUND8_(a_, b_, c_, d_)  do {                                          \
+        x [c_] = _mm256_xor_si256 (x [c_], vrot8 (_mm256_add_epi32 (x [b_], x [a_]),  9)) ; \
+        x [d_] = _mm256_xor_si256 (x [d_], vrot8 (_mm256_add_epi32 (x [c_], x [b_]), 13)) ; \
+        x [a_] = _mm256_xor_si256 (x [a_], vrot8 (_mm256_add_epi32 (x [d_], x [c_]), 18)) ; \
+    } while (false)
+
+#define TRANSPOSE8_(V0_, V1_, V2_, V3_) do {                    \
+        __m256i t0_ = _mm256_unpacklo_epi32 ((V0_), (V1_)) ;    \
+        __m256i t1_ = _mm256_unpacklo_epi32 ((V2_), (V3_)) ;    \
+        __m256i t2_ = _mm256_unpackhi_epi32 ((V0_), (V1_)) ;    \
+        __m256i t3_ = _mm256_unpackhi_epi32 ((V2_), (V3_)) ;    \
+        (V0_) = _mm256_unpacklo_epi64 (t0_, t1_) ;              \
+        (V1_) = _mm256_unpackhi_epi64 (t0_, t1_) ;              \
+        (V2_) = _mm256_unpacklo_epi64 (t2_, t3_) ;              \
+        (V3_) = _mm256_unpackhi_epi64 (t2_, t3_) ;              \
+    } while (false)
+
+/**
+ * Adds the input words and stores the key stream of each lane.
+ *
+ * @param x The state words after the rounds (lane n holds the n-th block)
+ * @param orig The input words
+ * @param dst The output of each block
+ * @param src The input of each block (nullptr stores the key stream itself)
+ */
+static inline void  StoreLanes (const __m256i (&x) [16], const __m256i (&orig) [16], uint8_t *const *dst, const uint8_t *const *src) {
+    for (int i = 0 ; i < 16 ; i += 8) {
+        __m256i a0 = _mm256_add_epi32 (x [i + 0], orig [i + 0]) ;
+        __m256i a1 = _mm256_add_epi32 (x [i + 1], orig [i + 1]) ;
+        __m256i a2 = _mm256_add_epi32 (x [i + 2], orig [i + 2]) ;
+        __m256i a3 = _mm256_add_epi32 (x [i + 3], orig [i + 3]) ;
+        __m256i b0 = _mm256_add_epi32 (x [i + 4], orig [i + 4]) ;
+        __m256i b1 = _mm256_add_epi32 (x [i + 5], orig [i + 5]) ;
+        __m256i b2 = _mm256_add_epi32 (x [i + 6], orig [i + 6]) ;
+        __m256i b3 = _mm256_add_epi32 (x [i + 7], orig [i + 7]) ;
+        // Transposes within each 128bit lane:
+        // a0 = (block 0 | block 4), a1 = (block 1 | block 5), ...
+        TRANSPOSE8_ (a0, a1, a2, a3) ;
+        TRANSPOSE8_ (b0, b1, b2, b3) ;
+        Store (dst [0], src [0], 4 * i, _mm256_permute2x128_si256 (a0, b0, 0x20)) ;
+        Store (dst [1], src [1], 4 * i, _mm256_permute2x128_si256 (a1, b1, 0x20)) ;
+        Store (dst [2], src [2], 4 * i, _mm256_permute2x128_si256 (a2, b2, 0x20)) ;
+        Store (dst [3], src [3], 4 * i, _mm256_permute2x128_si256 (a3, b3, 0x20)) ;
+        Store (dst [4], src [4], 4 * i, _mm256_permute2x128_si256 (a0, b0, 0x31)) ;
+        Store (dst [5], src [5], 4 * i, _mm256_permute2x128_si256 (a1, b1, 0x31)) ;
+        Store (dst [6], src [6], 4 * i, _mm256_permute2x128_si256 (a2, b2, 0x31)) ;
+        Store (dst [7], src [7], 4 * i, _mm256_permute2x128_si256 (a3, b3, 0x31)) ;
+    }
+}
+
+/**
+ * Splits the sequence numbers of 8 consecutive blocks into the lower and the upper words.
+ */
+static inline void  SequenceLanes (uint64_t seq, __m256i &lo, __m256i &hi) {
+    lo = _mm256_set_epi32 ( static_cast<int32_t> (seq + 7), static_cast<int32_t> (seq + 6)
+                          , static_cast<int32_t> (seq + 5), static_cast<int32_t> (seq + 4)
+                          , static_cast<int32_t> (seq + 3), static_cast<int32_t> (seq + 2)
+                          , static_cast<int32_t> (seq + 1), static_cast<int32_t> (seq + 0)) ;
+    hi = _mm256_set_epi32 ( static_cast<int32_t> ((seq + 7) >> 32), static_cast<int32_t> ((seq + 6) >> 32)
+                          , static_cast<int32_t> ((seq + 5) >> 32), static_cast<int32_t> ((seq + 4) >> 32)
+                          , static_cast<int32_t> ((seq + 3) >> 32), static_cast<int32_t> ((seq + 2) >> 32)
+                          , static_cast<int32_t> ((seq + 1) >> 32), static_cast<int32_t> ((seq + 0) >> 32)) ;
+}
+
+/**
+ * Applies the key stream of 8 blocks at once.
+ *
+ * Each __m256i holds the same state word of 8 blocks (lane n holds the
+ * n-th block).
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds (10 for Salsa20/20)
+ * @param orig The state words of 8 blocks
+ * @param pre The counter independent part of the first round of every block (nullptr performs the first round in full)
+ * @param dst The output of each block
+ * @param src The input of each block (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyLanes (const __m256i (&orig) [16], const __m256i *pre, uint8_t *const *dst, const uint8_t *const *src) {
+
+    __m256i     x [16] ;
+    if (pre != nullptr) {
+        for (int i = 0 ; i < 16 ; ++i) {
+            x [i] = pre [i] ;
+        }
+        x [8] = orig [8] ;
+        x [9] = _mm256_xor_si256 (x [9], orig [9]) ;
+        FINISHQUARTERROUND8_ ( 0,  4,  8, 12) ;
+        FINISHQUARTERROUND8_ ( 5,  9, 13,  1) ;
+    }
+    else {
+        for (int i = 0 ; i < 16 ; ++i) {
+            x [i] = orig [i] ;
+        }
+        QUARTERROUND8_ ( 0,  4,  8, 12) ;
+        QUARTERROUND8_ ( 5,  9, 13,  1) ;
+        QUARTERROUND8_ (10, 14,  2,  6) ;
+        QUARTERROUND8_ (15,  3,  7, 11) ;
+    }
+    QUARTERROUND8_ ( 0,  1,  2,  3) ;
+    QUARTERROUND8_ ( 5,  6,  7,  4) ;
+    QUARTERROUND8_ (10, 11,  8,  9) ;
+    QUARTERROUND8_ (15, 12, 13, 14) ;
+
+    for (int i = 1 ; i < DOUBLE_ROUNDS ; ++i) {
+        QUARTERROUND8_ ( 0,  4,  8, 12) ;
+        QUARTERROUND8_ ( 5,  9, 13,  1) ;
+        QUARTERROUND8_ (10, 14,  2,  6) ;
+        QUARTERROUND8_ (15,  3,  7, 11) ;
+
+        QUARTERROUND8_ ( 0,  1,  2,  3) ;
+        QUARTERROUND8_ ( 5,  6,  7,  4) ;
+        QUARTERROUND8_ (10, 11,  8,  9) ;
+        QUARTERROUND8_ (15, 12, 13, 14) ;
+    }
+    StoreLanes (x, orig, dst, src) ;
+}
+
+/**
+ * Applies the key stream of 8 consecutive blocks at once.
+ *
+ * @param input The state words
+ * @param pre The counter independent part of the first round
+ * @param seq The sequence number of the first block
+ * @param dst The output (512 bytes)
+ * @param src The input (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks8 (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    __m256i     orig [16] ;
+    __m256i     p [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        orig [i] = _mm256_set1_epi32 (static_cast<int32_t> (input [i])) ;
+        p [i] = _mm256_set1_epi32 (static_cast<int32_t> (pre [i])) ;
+    }
+    SequenceLanes (seq, orig [8], orig [9]) ;
+
+    uint8_t *       d [8] ;
+    const uint8_t * s [8] ;
+    for (int i = 0 ; i < 8 ; ++i) {
+        d [i] = dst + i * BLOCK_SIZE ;
+        s [i] = Salsa20::Kernel::Advance (src, i * BLOCK_SIZE) ;
+    }
+    ApplyLanes<DOUBLE_ROUNDS> (orig, p, d, s) ;
+}
+
+/**
+ * Applies one block of the key stream for each of 8 independent states.
+ */
+static void     ApplyLanes8 (const Salsa20::Kernel::input_t *inputs, uint8_t *const *dst, const uint8_t *const *src) {
+    __m256i     orig [16] ;
+    for (int i = 0 ; i < 16 ; i += 4) {
+        __m256i v [4] ;
+        for (int k = 0 ; k < 4 ; ++k) {
+            // (state k | state k + 4)
+            v [k] = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *)&inputs [k + 0][i]))
+                                            , _mm_loadu_si128 ((const __m128i *)&inputs [k + 4][i])
+                                            , 1) ;
+        }
+        // v [0] ... v [3] = the words i...i+3 of each state
+        TRANSPOSE8_ (v [0], v [1], v [2], v [3]) ;
+        orig [i + 0] = v [0] ;
+        orig [i + 1] = v [1] ;
+        orig [i + 2] = v [2] ;
+        orig [i + 3] = v [3] ;
+    }
+    ApplyLanes<10> (orig, nullptr, dst, src) ;
+}
+
+#undef FINISHQUARTERROUND8_
+#undef QUARTERROUND8_
+
+// The rotations by 16 and 8 are byte shuffles
+#define CHACHA_QUARTERROUND8_(a_, b_, c_, d_)  do {                                                             \
+        x [a_] = _mm256_add_epi32 (x [a_], x [b_]) ; x [d_] = _mm256_shuffle_epi8 (_mm256_xor_si256 (x [d_], x [a_]), rot16) ; \
+        x [c_] = _mm256_add_epi32 (x [c_], x [d_]) ; x [b_] = vrot8 (_mm256_xor_si256 (x [b_], x [c_]), 12) ;                  \
+        x [a_] = _mm256_add_epi32 (x [a_], x [b_]) ; x [d_] = _mm256_shuffle_epi8 (_mm256_xor_si256 (x [d_], x [a_]), rot8) ;  \
+        x [c_] = _mm256_add_epi32 (x [c_], x [d_]) ; x [b_] = vrot8 (_mm256_xor_si256 (x [b_], x [c_]),  7) ;                  \
+    } while (false)
+
+/**
+ * Applies the ChaCha20 key stream of 8 consecutive blocks at once.
+ *
+ * @param input The state words
+ * @param seq The counter of the first block
+ * @param dst The output (512 bytes)
+ * @param src The input (nullptr stores the key stream itself)
+ */
+static void     ChaCha20Blocks8 (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+    const int       NUM_ROUNDS = 10 ;
+    const __m256i   rot16 = _mm256_set_epi64x (0x0D0C0F0E09080B0All, 0x0504070601000302ll, 0x0D0C0F0E09080B0All, 0x0504070601000302ll) ;
+    const __m256i   rot8 = _mm256_set_epi64x (0x0E0D0C0F0A09080Bll, 0x0605040702010003ll, 0x0E0D0C0F0A09080Bll, 0x0605040702010003ll) ;
+
+    __m256i     orig [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        orig [i] = _mm256_set1_epi32 (static_cast<int32_t> (input [i])) ;
+    }
+    SequenceLanes (seq, orig [12], orig [13]) ;
+
+    __m256i     x [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        x [i] = orig [i] ;
+    }
+    for (int i = 0 ; i < NUM_ROUNDS ; ++i) {
+        CHACHA_QUARTERROUND8_ ( 0,  4,  8, 12) ;
+        CHACHA_QUARTERROUND8_ ( 1,  5,  9, 13) ;
+        CHACHA_QUARTERROUND8_ ( 2,  6, 10, 14) ;
+        CHACHA_QUARTERROUND8_ ( 3,  7, 11, 15) ;
+
+        CHACHA_QUARTERROUND8_ ( 0,  5, 10, 15) ;
+        CHACHA_QUARTERROUND8_ ( 1,  6, 11, 12) ;
+        CHACHA_QUARTERROUND8_ ( 2,  7,  8, 13) ;
+        CHACHA_QUARTERROUND8_ ( 3,  4,  9, 14) ;
+    }
+    uint8_t *       d [8] ;
+    const uint8_t * s [8] ;
+    for (int i = 0 ; i < 8 ; ++i) {
+        d [i] = dst + i * BLOCK_SIZE ;
+        s [i] = Salsa20::Kernel::Advance (src, i * BLOCK_SIZE) ;
+    }
+    StoreLanes (x, orig, d, s) ;
+}
+
+#undef CHACHA_QUARTERROUND8_
+#undef TRANSPOSE8_
+
+static void     ChaCha20Blocks (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    for ( ; 8 <= count ; count -= 8) {
+        ChaCha20Blocks8 (input, seq, dst, src) ;
+        seq += 8 ;
+        dst += 8 * BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, 8 * BLOCK_SIZE) ;
+    }
+    if (0 < count) {
+        Salsa20::Kernel::SSE2.chaCha20Blocks (input, seq, dst, src, count) ;
+    }
+}
+
+template <int DOUBLE_ROUNDS>
+static void     ComputeHashValue (const Salsa20::Kernel::input_t &input, uint8_t *output) {
+    Salsa20::Kernel::ForRounds<DOUBLE_ROUNDS> (Salsa20::Kernel::SSE2).computeHashValue (input, output) ;
+}
+
+static void     ComputeHSalsa20 (const Salsa20::Kernel::input_t &input, uint32_t *output) {
+    Salsa20::Kernel::SSE2.hSalsa20 (input, output) ;
+}
+
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    for ( ; 8 <= count ; count -= 8) {
+        ApplyBlocks8<DOUBLE_ROUNDS> (input, pre, seq, dst, src) ;
+        seq += 8 ;
+        dst += 8 * BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, 8 * BLOCK_SIZE) ;
+    }
+    if (0 < count) {
+        Salsa20::Kernel::ForRounds<DOUBLE_ROUNDS> (Salsa20::Kernel::SSE2).applyBlocks (input, pre, seq, dst, src, count) ;
+    }
+}
+
+static void     ToFloat (void *buffer, size_t count) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    const __m256    scale = _mm256_set1_ps (1.0f / 16777216.0f) ;
+
+    for ( ; 8 <= count ; count -= 8, p += 32) {
+        __m256i w = _mm256_loadu_si256 ((const __m256i *)p) ;
+        _mm256_storeu_ps ((float *)p, _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_srli_epi32 (w, 8)), scale)) ;
+    }
+    Salsa20::Kernel::SSE2.toFloat (p, count) ;
+}
+
+static void     ToDouble (void *buffer, size_t count) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    const __m256i   exponent = _mm256_set1_epi64x (0x3FF0000000000000ll) ;
+    const __m256d   one = _mm256_set1_pd (1.0) ;
+
+    for ( ; 4 <= count ; count -= 4, p += 32) {
+        __m256i w = _mm256_loadu_si256 ((const __m256i *)p) ;
+        // [1, 2) with 52 random bits
+        __m256i bits = _mm256_or_si256 (_mm256_srli_epi64 (w, 12), exponent) ;
+        _mm256_storeu_pd ((double *)p, _mm256_sub_pd (_mm256_castsi256_pd (bits), one)) ;
+    }
+    Salsa20::Kernel::SSE2.toDouble (p, count) ;
+}
+
+static size_t   ToBounded (void *buffer, size_t count, uint32_t bound, uint32_t threshold) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    const __m256i   b = _mm256_set1_epi32 (static_cast<int32_t> (bound)) ;
+    // For the unsigned comparison
+    const __m256i   bias = _mm256_set1_epi32 (static_cast<int32_t> (0x80000000u)) ;
+    const __m256i   t = _mm256_set1_epi32 (static_cast<int32_t> (threshold ^ 0x80000000u)) ;
+
+    size_t  i = 0 ;
+    for ( ; i + 8 <= count ; i += 8, p += 32) {
+        __m256i w = _mm256_loadu_si256 ((const __m256i *)p) ;
+        __m256i m02 = _mm256_mul_epu32 (w, b) ;
+        __m256i m13 = _mm256_mul_epu32 (_mm256_srli_epi64 (w, 32), b) ;
+        __m256i lo = _mm256_blend_epi32 (m02, _mm256_slli_epi64 (m13, 32), 0xAA) ;
+        __m256i hi = _mm256_blend_epi32 (_mm256_srli_epi64 (m02, 32), m13, 0xAA) ;
+        if (_mm256_movemask_epi8 (_mm256_cmpgt_epi32 (t, _mm256_xor_si256 (lo, bias))) != 0) {
+            return i + Salsa20::Kernel::Scalar.toBounded (p, 8, bound, threshold) ;
+        }
+        _mm256_storeu_si256 ((__m256i *)p, hi) ;
+    }
+    return i + Salsa20::Kernel::SSE2.toBounded (p, count - i, bound, threshold) ;
+}
+
+/*
+ * Poly1305 over 4 blocks at once.
+ *
+ * Lane i accumulates the blocks 4k + i in 5 limbs of 26 bits with
+ * A_i = A_i * r^4 + m_(4k + i), then h = sum (A_i * r^(4 - i)).
+ */
+
+#define MUL_(a_, b_)    _mm256_mul_epu32 ((a_), (b_))
+
+/**
+ * Computes H = H * R (partially reduced) in each lane.
+ *
+ * @param h The accumulator limbs
+ * @param r The multiplier limbs
+ * @param s 5 * r (s [0] is not used)
+ */
+static inline void  Poly1305Multiply4 (__m256i *h, const __m256i *r, const __m256i *s) {
+    const __m256i   mask = _mm256_set1_epi64x (0x3FFFFFF) ;
+
+    __m256i d0 = _mm256_add_epi64 (_mm256_add_epi64 (_mm256_add_epi64 (MUL_ (h [0], r [0]), MUL_ (h [1], s [4])), _mm256_add_epi64 (MUL_ (h [2], s [3]), MUL_ (h [3], s [2]))), MUL_ (h [4], s [1])) ;
+    __m256i d1 = _mm256_add_epi64 (_mm256_add_epi64 (_mm256_add_epi64 (MUL_ (h [0], r [1]), MUL_ (h [1], r [0])), _mm256_add_epi64 (MUL_ (h [2], s [4]), MUL_ (h [3], s [3]))), MUL_ (h [4], s [2])) ;
+    __m256i d2 = _mm256_add_epi64 (_mm256_add_epi64 (_mm256_add_epi64 (MUL_ (h [0], r [2]), MUL_ (h [1], r [1])), _mm256_add_epi64 (MUL_ (h [2], r [0]), MUL_ (h [3], s [4]))), MUL_ (h [4], s [3])) ;
+    __m256i d3 = _mm256_add_epi64 (_mm256_add_epi64 (_mm256_add_epi64 (MUL_ (h [0], r [3]), MUL_ (h [1], r [2])), _mm256_add_epi64 (MUL_ (h [2], r [1]), MUL_ (h [3], r [0]))), MUL_ (h [4], s [4])) ;
+    __m256i d4 = _mm256_add_epi64 (_mm256_add_epi64 (_mm256_add_epi64 (MUL_ (h [0], r [4]), MUL_ (h [1], r [3])), _mm256_add_epi64 (MUL_ (h [2], r [2]), MUL_ (h [3], r [1]))), MUL_ (h [4], r [0])) ;
+
+    __m256i c = _mm256_srli_epi64 (d0, 26) ;
+    h [0] = _mm256_and_si256 (d0, mask) ;
+    d1 = _mm256_add_epi64 (d1, c) ;
+    c = _mm256_srli_epi64 (d1, 26) ;
+    h [1] = _mm256_and_si256 (d1, mask) ;
+    d2 = _mm256_add_epi64 (d2, c) ;
+    c = _mm256_srli_epi64 (d2, 26) ;
+    h [2] = _mm256_and_si256 (d2, mask) ;
+    d3 = _mm256_add_epi64 (d3, c) ;
+    c = _mm256_srli_epi64 (d3, 26) ;
+    h [3] = _mm256_and_si256 (d3, mask) ;
+    d4 = _mm256_add_epi64 (d4, c) ;
+    c = _mm256_srli_epi64 (d4, 26) ;
+    h [4] = _mm256_and_si256 (d4, mask) ;
+    // 2^130 = 5 (mod 2^130 - 5)
+    h [0] = _mm256_add_epi64 (h [0], _mm256_add_epi64 (c, _mm256_slli_epi64 (c, 2))) ;
+    c = _mm256_srli_epi64 (h [0], 26) ;
+    h [0] = _mm256_and_si256 (h [0], mask) ;
+    h [1] = _mm256_add_epi64 (h [1], c) ;
+}
+
+#undef MUL_
+
+/**
+ * Adds 4 full blocks (one per lane) to the accumulator.
+ */
+static inline void  Poly1305Absorb4 (__m256i *h, const uint8_t *message) {
+    const __m256i   mask = _mm256_set1_epi64x (0x3FFFFFF) ;
+    __m256i a = _mm256_loadu_si256 ((const __m256i *)&message [ 0]) ;
+    __m256i b = _mm256_loadu_si256 ((const __m256i *)&message [32]) ;
+    // The low/high 64 bits of the blocks 0, 1, 2, 3
+    __m256i lo = _mm256_permute4x64_epi64 (_mm256_unpacklo_epi64 (a, b), 0xD8) ;
+    __m256i hi = _mm256_permute4x64_epi64 (_mm256_unpackhi_epi64 (a, b), 0xD8) ;
+
+    h [0] = _mm256_add_epi64 (h [0], _mm256_and_si256 (lo, mask)) ;
+    h [1] = _mm256_add_epi64 (h [1], _mm256_and_si256 (_mm256_srli_epi64 (lo, 26), mask)) ;
+    h [2] = _mm256_add_epi64 (h [2], _mm256_and_si256 (_mm256_or_si256 (_mm256_srli_epi64 (lo, 52), _mm256_slli_epi64 (hi, 12)), mask)) ;
+    h [3] = _mm256_add_epi64 (h [3], _mm256_and_si256 (_mm256_srli_epi64 (hi, 14), mask)) ;
+    h [4] = _mm256_add_epi64 (h [4], _mm256_or_si256 (_mm256_srli_epi64 (hi, 40), _mm256_set1_epi64x (1 << 24))) ;
+}
+
+static void     Poly1305Blocks (uint64_t *h, const uint64_t *r, const uint8_t *message, size_t count) {
+    namespace Core = Salsa20::Poly1305Core ;
+    // Computing the powers does not pay for short messages
+    if (count < 16) {
+        Core::Blocks (h, r, message, count, Core::HIBIT) ;
+        return ;
+    }
+    // r^1 ... r^4
+    uint64_t    pw [4][3] ;
+    uint32_t    limbs [4][5] ;
+    for (int k = 0 ; k < 3 ; ++k) {
+        pw [0][k] = r [k] ;
+    }
+    for (int i = 1 ; i < 4 ; ++i) {
+        for (int k = 0 ; k < 3 ; ++k) {
+            pw [i][k] = pw [i - 1][k] ;
+        }
+        Core::MultiplyMod (pw [i], r) ;
+    }
+    for (int i = 0 ; i < 4 ; ++i) {
+        Core::ToLimbs26 (limbs [i], pw [i]) ;
+    }
+    uint32_t    hl [5] ;
+    Core::ToLimbs26 (hl, h) ;
+
+    __m256i acc [5] ;
+    __m256i r4 [5] ;
+    __m256i s4 [5] ;
+    for (int k = 0 ; k < 5 ; ++k) {
+        acc [k] = _mm256_set_epi64x (0, 0, 0, hl [k]) ;
+        r4 [k] = _mm256_set1_epi64x (limbs [3][k]) ;
+        s4 [k] = _mm256_set1_epi64x (5 * static_cast<uint64_t> (limbs [3][k])) ;
+    }
+    Poly1305Absorb4 (acc, message) ;
+    message += 64 ;
+    count -= 4 ;
+    for ( ; 4 <= count ; count -= 4, message += 64) {
+        Poly1305Multiply4 (acc, r4, s4) ;
+        Poly1305Absorb4 (acc, message) ;
+    }
+    // Lane i is multiplied by r^(4 - i)
+    __m256i rm [5] ;
+    __m256i sm [5] ;
+    for (int k = 0 ; k < 5 ; ++k) {
+        rm [k] = _mm256_set_epi64x (limbs [0][k], limbs [1][k], limbs [2][k], limbs [3][k]) ;
+        sm [k] = _mm256_add_epi64 (rm [k], _mm256_slli_epi64 (rm [k], 2)) ;
+    }
+    Poly1305Multiply4 (acc, rm, sm) ;
+
+    uint64_t    sum [5] ;
+    for (int k = 0 ; k < 5 ; ++k) {
+        alignas (32) uint64_t   lanes [4] ;
+        _mm256_store_si256 ((__m256i *)lanes, acc [k]) ;
+        sum [k] = lanes [0] + lanes [1] + lanes [2] + lanes [3] ;
+    }
+    Core::FromLimbs26 (h, sum) ;
+    Core::Blocks (h, r, message, count, Core::HIBIT) ;
+}
+
+const Salsa20::Kernel::Entry    Salsa20::Kernel::AVX2 { "avx2"
+                                                      , ComputeHashValue<10>, ApplyBlocks<10>
+                                                      , 8, ApplyLanes8
+                                                      , ComputeHSalsa20, ToFloat, ToDouble, ToBounded, Poly1305Blocks, ChaCha20Blocks
+                                                      , { ComputeHashValue<4>, ApplyBlocks<4> }
+                                                      , { ComputeHashValue<6>, ApplyBlocks<6> }
+                                                      , nullptr } ;
+
+/*
+ * [END OF FILE]
+ */
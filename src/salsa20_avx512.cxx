@@ -0,0 +1,330 @@
+/*
+ * salsa20_avx512.cxx: The AVX-512 salsa20 kernel.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include "salsa20_kernel.h"
+#include <immintrin.h>
+
+/**
+ * Stores the key stream (XORed with the source if supplied).
+ */
+static inline void  Store (uint8_t *dst, const uint8_t *src, size_t offset, __m512i v) {
+    if (src != nullptr) {
+        v = _mm512_xor_si512 (v, _mm512_loadu_si512 ((const __m512i *)&src [offset])) ;
+    }
+    _mm512_storeu_si512 ((__m512i *)&dst [offset], v) ;
+}
+
+#define QUARTERROUND16_(a_, b_, c_, d_)  do {                                                     \
+        x [b_] = _mm512_xor_si512 (x [b_], _mm512_rol_epi32 (_mm512_add_epi32 (x [a_], x [d_]),  7)) ; \
+        x [c_] = _mm512_xor_si512 (x [c_], _mm512_rol_epi32 (_mm512_add_epi32 (x [b_], x [a_]),  9)) ; \
+        x [d_] = _mm512_xor_si512 (x [d_], _mm512_rol_epi32 (_mm512_add_epi32 (x [c_], x [b_]), 13)) ; \
+        x [a_] = _mm512_xor_si512 (x [a_], _mm512_rol_epi32 (_mm512_add_epi32 (x [d_], x [c_]), 18)) ; \
+    } while (false)
+
+// The last 3 steps of QUARTERROUND16_
+#define FINISHQUARTERROUND16_(a_, b_, c_, d_)  do {                                                    \
+        x [c_] = _mm512_xor_si512 (x [c_], _mm512_rol_epi32 (_mm512_add_epi32 (x [b_], x [a_]),  9)) ; \
+        x [d_] = _mm512_xor_si512 (x [d_], _mm512_rol_epi32 (_mm512_add_epi32 (x [c_], x [b_]), 13)) ; \
+        x [a_] = _mm512_xor_si512 (x [a_], _mm512_rol_epi32 (_mm512_add_epi32 (x [d_], x [c_]), 18)) ; \
+    } while (false)
+
+#define TRANSPOSE16_(V0_, V1_, V2_, V3_) do {                   \
+        __m512i t0_ = _mm512_unpacklo_epi32 ((V0_), (V1_)) ;    \
+        __m512i t1_ = _mm512_unpacklo_epi32 ((V2_), (V3_)) ;    \
+        __m512i t2_ = _mm512_unpackhi_epi32 ((V0_), (V1_)) ;    \
+        __m512i t3_ = _mm512_unpackhi_epi32 ((V2_), (V3_)) ;    \
+        (V0_) = _mm512_unpacklo_epi64 (t0_, t1_) ;              \
+        (V1_) = _mm512_unpackhi_epi64 (t0_, t1_) ;              \
+        (V2_) = _mm512_unpacklo_epi64 (t2_, t3_) ;              \
+        (V3_) = _mm512_unpackhi_epi64 (t2_, t3_) ;              \
+    } while (false)
+
+// Transposes 4x4 matrix of 128bit lanes
+#define TRANSPOSE128_(V0_, V1_, V2_, V3_) do {                      \
+        __m512i t0_ = _mm512_shuffle_i32x4 ((V0_), (V1_), 0x44) ;   \
+        __m512i t1_ = _mm512_shuffle_i32x4 ((V0_), (V1_), 0xEE) ;   \
+        __m512i t2_ = _mm512_shuffle_i32x4 ((V2_), (V3_), 0x44) ;   \
+        __m512i t3_ = _mm512_shuffle_i32x4 ((V2_), (V3_), 0xEE) ;   \
+        (V0_) = _mm512_shuffle_i32x4 (t0_, t2_, 0x88) ;             \
+        (V1_) = _mm512_shuffle_i32x4 (t0_, t2_, 0xDD) ;             \
+        (V2_) = _mm512_shuffle_i32x4 (t1_, t3_, 0x88) ;             \
+        (V3_) = _mm512_shuffle_i32x4 (t1_, t3_, 0xDD) ;             \
+    } while (false)
+
+/**
+ * Adds the input words and stores the key stream of each lane.
+ *
+ * @param x The state words after the rounds (lane n holds the n-th block, clobbered)
+ * @param orig The input words
+ * @param dst The output of each block
+ * @param src The input of each block (nullptr stores the key stream itself)
+ */
+static inline void  StoreLanes (__m512i (&x) [16], const __m512i (&orig) [16], uint8_t *const *dst, const uint8_t *const *src) {
+    for (int i = 0 ; i < 16 ; ++i) {
+        x [i] = _mm512_add_epi32 (x [i], orig [i]) ;
+    }
+    // Transposes within each 128bit lane:
+    // x [4 * g + k] = (block k | block 4 + k | block 8 + k | block 12 + k) for words 4 * g ... 4 * g + 3
+    TRANSPOSE16_ (x [ 0], x [ 1], x [ 2], x [ 3]) ;
+    TRANSPOSE16_ (x [ 4], x [ 5], x [ 6], x [ 7]) ;
+    TRANSPOSE16_ (x [ 8], x [ 9], x [10], x [11]) ;
+    TRANSPOSE16_ (x [12], x [13], x [14], x [15]) ;
+    for (int k = 0 ; k < 4 ; ++k) {
+        __m512i v0 = x [k +  0] ;
+        __m512i v1 = x [k +  4] ;
+        __m512i v2 = x [k +  8] ;
+        __m512i v3 = x [k + 12] ;
+        // v0 ... v3 = block k, 4 + k, 8 + k, 12 + k
+        TRANSPOSE128_ (v0, v1, v2, v3) ;
+        Store (dst [k +  0], src [k +  0], 0, v0) ;
+        Store (dst [k +  4], src [k +  4], 0, v1) ;
+        Store (dst [k +  8], src [k +  8], 0, v2) ;
+        Store (dst [k + 12], src [k + 12], 0, v3) ;
+    }
+}
+
+/**
+ * Splits the sequence numbers of 16 consecutive blocks into the lower and the upper words.
+ */
+static inline void  SequenceLanes (uint64_t seq, __m512i &lo, __m512i &hi) {
+    const __m512i   base = _mm512_set1_epi32 (static_cast<int32_t> (seq)) ;
+    lo = _mm512_add_epi32 (base, _mm512_set_epi32 (15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)) ;
+    // Propagates carries into the upper 32bits
+    const __mmask16 carry = _mm512_cmplt_epu32_mask (lo, base) ;
+    hi = _mm512_set1_epi32 (static_cast<int32_t> (seq >> 32)) ;
+    hi = _mm512_mask_add_epi32 (hi, carry, hi, _mm512_set1_epi32 (1)) ;
+}
+
+/**
+ * Applies the key stream of 16 blocks at once.
+ *
+ * Each __m512i holds the same state word of 16 blocks (lane n holds the
+ * n-th block).
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds (10 for Salsa20/20)
+ * @param orig The state words of 16 blocks
+ * @param pre The counter independent part of the first round of every block (nullptr performs the first round in full)
+ * @param dst The output of each block
+ * @param src The input of each block (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyLanes (const __m512i (&orig) [16], const __m512i *pre, uint8_t *const *dst, const uint8_t *const *src) {
+
+    __m512i     x [16] ;
+    if (pre != nullptr) {
+        for (int i = 0 ; i < 16 ; ++i) {
+            x [i] = pre [i] ;
+        }
+        x [8] = orig [8] ;
+        x [9] = _mm512_xor_si512 (x [9], orig [9]) ;
+        FINISHQUARTERROUND16_ ( 0,  4,  8, 12) ;
+        FINISHQUARTERROUND16_ ( 5,  9, 13,  1) ;
+    }
+    else {
+        for (int i = 0 ; i < 16 ; ++i) {
+            x [i] = orig [i] ;
+        }
+        QUARTERROUND16_ ( 0,  4,  8, 12) ;
+        QUARTERROUND16_ ( 5,  9, 13,  1) ;
+        QUARTERROUND16_ (10, 14,  2,  6) ;
+        QUARTERROUND16_ (15,  3,  7, 11) ;
+    }
+    QUARTERROUND16_ ( 0,  1,  2,  3) ;
+    QUARTERROUND16_ ( 5,  6,  7,  4) ;
+    QUARTERROUND16_ (10, 11,  8,  9) ;
+    QUARTERROUND16_ (15, 12, 13, 14) ;
+
+    for (int i = 1 ; i < DOUBLE_ROUNDS ; ++i) {
+        QUARTERROUND16_ ( 0,  4,  8, 12) ;
+        QUARTERROUND16_ ( 5,  9, 13,  1) ;
+        QUARTERROUND16_ (10, 14,  2,  6) ;
+        QUARTERROUND16_ (15,  3,  7, 11) ;
+
+        QUARTERROUND16_ ( 0,  1,  2,  3) ;
+        QUARTERROUND16_ ( 5,  6,  7,  4) ;
+        QUARTERROUND16_ (10, 11,  8,  9) ;
+        QUARTERROUND16_ (15, 12, 13, 14) ;
+    }
+    StoreLanes (x, orig, dst, src) ;
+}
+
+/**
+ * Applies the key stream of 16 consecutive blocks at once.
+ *
+ * @param input The state words
+ * @param pre The counter independent part of the first round
+ * @param seq The sequence number of the first block
+ * @param dst The output (1024 bytes)
+ * @param src The input (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks16 (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    __m512i     orig [16] ;
+    __m512i     p [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        orig [i] = _mm512_set1_epi32 (static_cast<int32_t> (input [i])) ;
+        p [i] = _mm512_set1_epi32 (static_cast<int32_t> (pre [i])) ;
+    }
+    SequenceLanes (seq, orig [8], orig [9]) ;
+
+    uint8_t *       d [16] ;
+    const uint8_t * s [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        d [i] = dst + i * BLOCK_SIZE ;
+        s [i] = Salsa20::Kernel::Advance (src, i * BLOCK_SIZE) ;
+    }
+    ApplyLanes<DOUBLE_ROUNDS> (orig, p, d, s) ;
+}
+
+/**
+ * Applies one block of the key stream for each of 16 independent states.
+ */
+static void     ApplyLanes16 (const Salsa20::Kernel::input_t *inputs, uint8_t *const *dst, const uint8_t *const *src) {
+    __m512i     orig [16] ;
+    for (int i = 0 ; i < 16 ; i += 4) {
+        __m512i v [4] ;
+        for (int k = 0 ; k < 4 ; ++k) {
+            // (state k | state k + 4 | state k + 8 | state k + 12)
+            __m512i t = _mm512_castsi128_si512 (_mm_loadu_si128 ((const __m128i *)&inputs [k + 0][i])) ;
+            t = _mm512_inserti32x4 (t, _mm_loadu_si128 ((const __m128i *)&inputs [k +  4][i]), 1) ;
+            t = _mm512_inserti32x4 (t, _mm_loadu_si128 ((const __m128i *)&inputs [k +  8][i]), 2) ;
+            t = _mm512_inserti32x4 (t, _mm_loadu_si128 ((const __m128i *)&inputs [k + 12][i]), 3) ;
+            v [k] = t ;
+        }
+        // v [0] ... v [3] = the words i...i+3 of each state
+        TRANSPOSE16_ (v [0], v [1], v [2], v [3]) ;
+        orig [i + 0] = v [0] ;
+        orig [i + 1] = v [1] ;
+        orig [i + 2] = v [2] ;
+        orig [i + 3] = v [3] ;
+    }
+    ApplyLanes<10> (orig, nullptr, dst, src) ;
+}
+
+#undef FINISHQUARTERROUND16_
+#undef QUARTERROUND16_
+
+#define CHACHA_QUARTERROUND16_(a_, b_, c_, d_)  do {                                                         \
+        x [a_] = _mm512_add_epi32 (x [a_], x [b_]) ; x [d_] = _mm512_rol_epi32 (_mm512_xor_si512 (x [d_], x [a_]), 16) ; \
+        x [c_] = _mm512_add_epi32 (x [c_], x [d_]) ; x [b_] = _mm512_rol_epi32 (_mm512_xor_si512 (x [b_], x [c_]), 12) ; \
+        x [a_] = _mm512_add_epi32 (x [a_], x [b_]) ; x [d_] = _mm512_rol_epi32 (_mm512_xor_si512 (x [d_], x [a_]),  8) ; \
+        x [c_] = _mm512_add_epi32 (x [c_], x [d_]) ; x [b_] = _mm512_rol_epi32 (_mm512_xor_si512 (x [b_], x [c_]),  7) ; \
+    } while (false)
+
+/**
+ * Applies the ChaCha20 key stream of 16 consecutive blocks at once.
+ *
+ * @param input The state words
+ * @param seq The counter of the first block
+ * @param dst The output (1024 bytes)
+ * @param src The input (nullptr stores the key stream itself)
+ */
+static void     ChaCha20Blocks16 (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+    const int       NUM_ROUNDS = 10 ;
+
+    __m512i     orig [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        orig [i] = _mm512_set1_epi32 (static_cast<int32_t> (input [i])) ;
+    }
+    SequenceLanes (seq, orig [12], orig [13]) ;
+
+    __m512i     x [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        x [i] = orig [i] ;
+    }
+    for (int i = 0 ; i < NUM_ROUNDS ; ++i) {
+        CHACHA_QUARTERROUND16_ ( 0,  4,  8, 12) ;
+        CHACHA_QUARTERROUND16_ ( 1,  5,  9, 13) ;
+        CHACHA_QUARTERROUND16_ ( 2,  6, 10, 14) ;
+        CHACHA_QUARTERROUND16_ ( 3,  7, 11, 15) ;
+
+        CHACHA_QUARTERROUND16_ ( 0,  5, 10, 15) ;
+        CHACHA_QUARTERROUND16_ ( 1,  6, 11, 12) ;
+        CHACHA_QUARTERROUND16_ ( 2,  7,  8, 13) ;
+        CHACHA_QUARTERROUND16_ ( 3,  4,  9, 14) ;
+    }
+    uint8_t *       d [16] ;
+    const uint8_t * s [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        d [i] = dst + i * BLOCK_SIZE ;
+        s [i] = Salsa20::Kernel::Advance (src, i * BLOCK_SIZE) ;
+    }
+    StoreLanes (x, orig, d, s) ;
+}
+
+#undef CHACHA_QUARTERROUND16_
+#undef TRANSPOSE128_
+#undef TRANSPOSE16_
+
+template <int DOUBLE_ROUNDS>
+static void     ComputeHashValue (const Salsa20::Kernel::input_t &input, uint8_t *output) {
+    Salsa20::Kernel::ForRounds<DOUBLE_ROUNDS> (Salsa20::Kernel::SSE2).computeHashValue (input, output) ;
+}
+
+static void     ComputeHSalsa20 (const Salsa20::Kernel::input_t &input, uint32_t *output) {
+    Salsa20::Kernel::SSE2.hSalsa20 (input, output) ;
+}
+
+static void     ToFloat (void *buffer, size_t count) {
+    Salsa20::Kernel::AVX2.toFloat (buffer, count) ;
+}
+
+static void     ToDouble (void *buffer, size_t count) {
+    Salsa20::Kernel::AVX2.toDouble (buffer, count) ;
+}
+
+static size_t   ToBounded (void *buffer, size_t count, uint32_t bound, uint32_t threshold) {
+    return Salsa20::Kernel::AVX2.toBounded (buffer, count, bound, threshold) ;
+}
+
+static void     Poly1305Blocks (uint64_t *h, const uint64_t *r, const uint8_t *message, size_t count) {
+    Salsa20::Kernel::AVX2.poly1305Blocks (h, r, message, count) ;
+}
+
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    for ( ; 16 <= count ; count -= 16) {
+        ApplyBlocks16<DOUBLE_ROUNDS> (input, pre, seq, dst, src) ;
+        seq += 16 ;
+        dst += 16 * BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, 16 * BLOCK_SIZE) ;
+    }
+    if (0 < count) {
+        Salsa20::Kernel::ForRounds<DOUBLE_ROUNDS> (Salsa20::Kernel::AVX2).applyBlocks (input, pre, seq, dst, src, count) ;
+    }
+}
+
+static void     ChaCha20Blocks (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    for ( ; 16 <= count ; count -= 16) {
+        ChaCha20Blocks16 (input, seq, dst, src) ;
+        seq += 16 ;
+        dst += 16 * BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, 16 * BLOCK_SIZE) ;
+    }
+    if (0 < count) {
+        Salsa20::Kernel::AVX2.chaCha20Blocks (input, seq, dst, src, count) ;
+    }
+}
+
+const Salsa20::Kernel::Entry    Salsa20::Kernel::AVX512 { "avx512"
+                                                        , ComputeHashValue<10>, ApplyBlocks<10>
+                                                        , 16, ApplyLanes16
+                                                        , ComputeHSalsa20, ToFloat, ToDouble, ToBounded, Poly1305Blocks, ChaCha20Blocks
+                                                        , { ComputeHashValue<4>, ApplyBlocks<4> }
+                                                        , { ComputeHashValue<6>, ApplyBlocks<6> }
+                                                        , nullptr } ;
+
+/*
+ * [END OF FILE]
+ */
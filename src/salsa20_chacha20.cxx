@@ -0,0 +1,271 @@
+/*
+ * salsa20_chacha20.cxx: The ChaCha20 cipher.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "salsa20_chacha20.h"
+#include "salsa20_kernel.h"
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+static inline uint32_t ToInt32 (const void *start) {
+    auto p = static_cast<const uint8_t *> (start) ;
+
+    return (  (static_cast<uint32_t> (p [0]) <<  0)
+            | (static_cast<uint32_t> (p [1]) <<  8)
+            | (static_cast<uint32_t> (p [2]) << 16)
+            | (static_cast<uint32_t> (p [3]) << 24)) ;
+}
+
+/// # of blocks the 32bit counter of the RFC 8439 layout covers
+static const uint64_t   COUNTER_LIMIT = 1ull << 32 ;
+
+void    Salsa20::ChaCha20::State::SetKey (const void *key, size_t key_size) {
+    std::array<uint8_t, 32> K ;
+
+    if (K.size () < key_size) {
+        key_size = K.size () ;
+    }
+
+    K.fill (0) ;
+    ::memcpy (&K [0], key, key_size) ;
+
+    for (int i = 0 ; i < 4 ; ++i) {
+        state_ [i] = StateAccess::KeyConstant (key_size, i) ;
+    }
+    // 16 bytes keys are repeated (as the salsa20 does)
+    const size_t    upper = (key_size <= 16) ? 0 : 16 ;
+    for (int i = 0 ; i < 4 ; ++i) {
+        state_ [4 + i] = ToInt32 (&K [4 * i]) ;
+        state_ [8 + i] = ToInt32 (&K [upper + 4 * i]) ;
+    }
+    state_ [12] = 0 ; // Sequence (lower 32bits)
+    state_ [13] = 0 ; // Sequence (upper 32bits)
+    state_ [14] = 0 ; // Initial vector (lower 32bits)
+    state_ [15] = 0 ; // Initial vector (upper 32bits)
+    ietf_ = false ;
+    exhausted_ = false ;
+}
+
+void    Salsa20::ChaCha20::State::SetInitialVector (uint64_t iv) {
+    state_ [12] = 0 ;
+    state_ [13] = 0 ;
+    state_ [14] = static_cast<uint32_t> (iv >>  0) ;
+    state_ [15] = static_cast<uint32_t> (iv >> 32) ;
+    ietf_ = false ;
+    exhausted_ = false ;
+}
+
+void    Salsa20::ChaCha20::State::SetNonce (const void *nonce) {
+    auto    n = static_cast<const uint8_t *> (nonce) ;
+
+    state_ [12] = 0 ;
+    state_ [13] = ToInt32 (&n [0]) ;
+    state_ [14] = ToInt32 (&n [4]) ;
+    state_ [15] = ToInt32 (&n [8]) ;
+    ietf_ = true ;
+    exhausted_ = false ;
+}
+
+uint64_t    Salsa20::ChaCha20::State::GetSequenceNumber () const {
+    if (ietf_) {
+        return exhausted_ ? COUNTER_LIMIT : state_ [12] ;
+    }
+    return ( (static_cast<uint64_t> (state_ [12]) <<  0)
+           | (static_cast<uint64_t> (state_ [13]) << 32)) ;
+}
+
+void    Salsa20::ChaCha20::State::SetSequenceNumber (uint64_t value) {
+    if (ietf_) {
+        if (COUNTER_LIMIT < value) {
+            throw std::out_of_range { "ChaCha20: The sequence number exceeds the 32bit counter" } ;
+        }
+        exhausted_ = (value == COUNTER_LIMIT) ;
+        state_ [12] = static_cast<uint32_t> (value) ;
+        return ;
+    }
+    state_ [12] = static_cast<uint32_t> (value >>  0) ;
+    state_ [13] = static_cast<uint32_t> (value >> 32) ;
+}
+
+void    Salsa20::ChaCha20::State::IncrementSequenceNumber () {
+    SetSequenceNumber (GetSequenceNumber () + 1) ;
+}
+
+/**
+ * Rejects the blocks the 32bit counter cannot address in the RFC 8439 layout.
+ *
+ * @param state The encryption state
+ * @param seq The first block
+ * @param count # of blocks
+ *
+ * @remarks Letting the counter carry into the word 13 would silently
+ *          switch to the key stream of another nonce.
+ */
+static void     CheckCounter (const Salsa20::ChaCha20::State &state, uint64_t seq, uint64_t count) {
+    if (state.IsIETF () && (COUNTER_LIMIT < seq || COUNTER_LIMIT - seq < count)) {
+        throw std::overflow_error { "ChaCha20: The 32bit block counter would wrap around" } ;
+    }
+}
+
+/**
+ * Converts the sequence number into the 64bit counter the kernels take.
+ *
+ * In the RFC 8439 layout, the upper half is the first word of the nonce,
+ * so the kernels leave it intact as long as the 32bit counter does not
+ * wrap around.
+ */
+static inline uint64_t  KernelCounter (const Salsa20::ChaCha20::State &state, uint64_t seq) {
+    using namespace Salsa20 ;
+    if (state.IsIETF ()) {
+        return ( (static_cast<uint64_t> (StateAccess::Words (state) [13]) << 32)
+               | (seq & 0xFFFFFFFFu)) ;
+    }
+    return seq ;
+}
+
+Salsa20::hash_value_t   Salsa20::ChaCha20::State::ComputeHashValue () const {
+    hash_value_t    result ;
+    CheckCounter (*this, GetSequenceNumber (), 1) ;
+    Kernel::Active ().chaCha20Blocks (state_, KernelCounter (*this, GetSequenceNumber ()), result.data (), nullptr, 1) ;
+    return result ;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+/**
+ * Applies the key stream to the full blocks in bulk.
+ *
+ * @param state The encryption state (sequence number is advanced)
+ * @param dst The output
+ * @param src The input
+ * @param count # of blocks to process
+ */
+static void     ApplyBlocks (Salsa20::ChaCha20::State &state, uint8_t *dst, const uint8_t *src, size_t count) {
+    using namespace Salsa20 ;
+    if (0 < count) {
+        uint64_t    seq = state.GetSequenceNumber () ;
+        CheckCounter (state, seq, count) ;
+        Kernel::Active ().chaCha20Blocks (StateAccess::Words (state), KernelCounter (state, seq), dst, src, count) ;
+        state.SetSequenceNumber (seq + count) ;
+    }
+}
+
+/**
+ * Applies the key stream starting from the arbitrary byte offset.
+ *
+ * @param state The encryption state (its sequence number is ignored)
+ * @param dst The output
+ * @param src The input (may be equal to `dst`)
+ * @param length The input length
+ * @param offset The start offset
+ *
+ * @returns The sequence number the stateful Apply leaves
+ */
+static uint64_t ApplyWithOffset (const Salsa20::ChaCha20::State &state, uint8_t *dst, const uint8_t *src, size_t length, uint64_t offset) {
+    using namespace Salsa20 ;
+    const size_t    BLOCK_SIZE = Kernel::BLOCK_SIZE ;
+
+    auto const &    kernel = Kernel::Active () ;
+    auto const &    words = StateAccess::Words (state) ;
+    uint64_t        seq = offset / BLOCK_SIZE ;
+    hash_value_t    hash ;
+
+    if (0 < length) {
+        // Checked up front, so nothing is written on failure
+        CheckCounter (state, seq, (offset + length + BLOCK_SIZE - 1) / BLOCK_SIZE - seq) ;
+    }
+
+    size_t  head = static_cast<size_t> (offset % BLOCK_SIZE) ;
+    if (head != 0) {
+        kernel.chaCha20Blocks (words, KernelCounter (state, seq), hash.data (), nullptr, 1) ;
+        size_t      n = (length < BLOCK_SIZE - head) ? length : BLOCK_SIZE - head ;
+
+        for (size_t i = 0 ; i < n ; ++i) {
+            dst [i] = src [i] ^ hash [head + i] ;
+        }
+        if (head + n == BLOCK_SIZE) {
+            ++seq ;
+        }
+        src += n ;
+        dst += n ;
+        length -= n ;
+    }
+    size_t  cnt = length / BLOCK_SIZE ;
+    if (0 < cnt) {
+        kernel.chaCha20Blocks (words, KernelCounter (state, seq), dst, src, cnt) ;
+        seq += cnt ;
+        src += cnt * BLOCK_SIZE ;
+        dst += cnt * BLOCK_SIZE ;
+    }
+    size_t  remain = length - cnt * BLOCK_SIZE ;
+    if (0 < remain) {
+        // Sequence number stays at the partially consumed block
+        kernel.chaCha20Blocks (words, KernelCounter (state, seq), hash.data (), nullptr, 1) ;
+
+        for (size_t i = 0 ; i < remain ; ++i) {
+            dst [i] = src [i] ^ hash [i] ;
+        }
+    }
+    return seq ;
+}
+
+void    Salsa20::ChaCha20::Apply (State &state, void *dst, const void *src, size_t length) {
+    const size_t    BLOCK_SIZE = Kernel::BLOCK_SIZE ;
+
+    auto    p = static_cast<const uint8_t *> (src) ;
+    auto    q = static_cast<uint8_t *> (dst) ;
+
+    CheckCounter (state, state.GetSequenceNumber (), (length + BLOCK_SIZE - 1) / BLOCK_SIZE) ;
+    size_t  cnt = length / BLOCK_SIZE ;
+    ApplyBlocks (state, q, p, cnt) ;
+    p += cnt * BLOCK_SIZE ;
+    q += cnt * BLOCK_SIZE ;
+    size_t  remain = length - cnt * BLOCK_SIZE ;
+    if (0 < remain) {
+        auto const hash = state.ComputeHashValue () ;
+        state.IncrementSequenceNumber () ;
+
+        for (size_t i = 0 ; i < remain ; ++i) {
+            q [i] = p [i] ^ hash [i] ;
+        }
+    }
+}
+
+void    Salsa20::ChaCha20::Apply (State &state, void *dst, const void *src, size_t length, uint64_t offset) {
+    state.SetSequenceNumber (ApplyWithOffset (state, static_cast<uint8_t *> (dst), static_cast<const uint8_t *> (src), length, offset)) ;
+}
+
+void    Salsa20::ChaCha20::Apply (State &state, void *message, size_t length) {
+    Apply (state, message, message, length) ;
+}
+
+void    Salsa20::ChaCha20::Apply (State &state, void *message, size_t length, uint64_t offset) {
+    Apply (state, message, message, length, offset) ;
+}
+
+void    Salsa20::ChaCha20::ApplyAt (const State &state, void *dst, const void *src, size_t length, uint64_t offset) {
+    ApplyWithOffset (state, static_cast<uint8_t *> (dst), static_cast<const uint8_t *> (src), length, offset) ;
+}
+
+void    Salsa20::ChaCha20::ApplyAt (const State &state, void *message, size_t length, uint64_t offset) {
+    auto    p = static_cast<uint8_t *> (message) ;
+
+    ApplyWithOffset (state, p, p, length, offset) ;
+}
+
+void    Salsa20::ChaCha20::GenerateKeystream (State &state, void *output, size_t nblocks) {
+    ApplyBlocks (state, static_cast<uint8_t *> (output), nullptr, nblocks) ;
+}
+
+/*
+ * [END OF FILE]
+ */
@@ -0,0 +1,157 @@
+/*
+ * salsa20_dispatch.cxx: Selects the salsa20 kernel for the running CPU.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <atomic>
+#include <cstring>
+#include "salsa20_kernel.h"
+
+#if defined (HAVE_SSE2)
+#   if defined (_MSC_VER)
+#       include <intrin.h>
+#   else
+#       include <cpuid.h>
+#   endif
+#endif
+
+namespace {
+
+#if defined (HAVE_SSE2)
+    void    CPUID (uint32_t leaf, uint32_t subleaf, uint32_t (&regs) [4]) {
+#if defined (_MSC_VER)
+        int tmp [4] ;
+        __cpuidex (tmp, static_cast<int> (leaf), static_cast<int> (subleaf)) ;
+        for (int i = 0 ; i < 4 ; ++i) {
+            regs [i] = static_cast<uint32_t> (tmp [i]) ;
+        }
+#else
+        regs [0] = regs [1] = regs [2] = regs [3] = 0 ;
+        __get_cpuid_count (leaf, subleaf, &regs [0], &regs [1], &regs [2], &regs [3]) ;
+#endif
+    }
+
+    uint64_t    XGETBV () {
+#if defined (_MSC_VER)
+        return _xgetbv (0) ;
+#else
+        uint32_t    lo ;
+        uint32_t    hi ;
+        __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0)) ;
+        return (static_cast<uint64_t> (hi) << 32) | lo ;
+#endif
+    }
+
+    /// <summary>Instruction sets available to the user code.</summary>
+    struct Features {
+        bool    sse2 = false ;
+        bool    avx2 = false ;
+        bool    avx512 = false ;
+
+        Features () {
+            uint32_t    regs [4] ;
+            CPUID (0, 0, regs) ;
+            const uint32_t  max_leaf = regs [0] ;
+            if (max_leaf < 1) {
+                return ;
+            }
+            CPUID (1, 0, regs) ;
+            sse2 = (regs [3] & (1u << 26)) != 0 ;
+            // OSXSAVE and AVX
+            if ((regs [2] & 0x18000000u) != 0x18000000u || max_leaf < 7) {
+                return ;
+            }
+            const uint64_t  xcr0 = XGETBV () ;
+            CPUID (7, 0, regs) ;
+            // XMM and YMM states should be saved by the OS
+            if ((xcr0 & 0x06u) != 0x06u) {
+                return ;
+            }
+            avx2 = (regs [1] & (1u << 5)) != 0 ;
+            // Opmask, ZMM_Hi256 and Hi16_ZMM states also should be saved
+            if ((xcr0 & 0xE0u) != 0xE0u) {
+                return ;
+            }
+            avx512 = avx2 && (regs [1] & (1u << 16)) != 0 ;
+        }
+    } ;
+
+    const Features &    CPUFeatures () {
+        static const Features   features ;
+        return features ;
+    }
+#endif  /* HAVE_SSE2 */
+
+    /**
+     * Looks up the kernel by name.
+     *
+     * @param name The kernel name
+     *
+     * @returns nullptr if the kernel is not available
+     */
+    const Salsa20::Kernel::Entry *  Find (const char *name) {
+        using namespace Salsa20 ;
+#ifdef HAVE_AVX512
+        if (::strcmp (name, Kernel::AVX512.name) == 0) {
+            return CPUFeatures ().avx512 ? &Kernel::AVX512 : nullptr ;
+        }
+#endif
+#ifdef HAVE_AVX2
+        if (::strcmp (name, Kernel::AVX2.name) == 0) {
+            return CPUFeatures ().avx2 ? &Kernel::AVX2 : nullptr ;
+        }
+#endif
+#ifdef HAVE_SSE2
+        if (::strcmp (name, Kernel::SSE2.name) == 0) {
+            return CPUFeatures ().sse2 ? &Kernel::SSE2 : nullptr ;
+        }
+#endif
+        if (::strcmp (name, Kernel::Scalar.name) == 0) {
+            return &Kernel::Scalar ;
+        }
+        return nullptr ;
+    }
+
+    const Salsa20::Kernel::Entry *  SelectBest () {
+        for (auto name : { "avx512", "avx2", "sse2" }) {
+            if (auto k = Find (name)) {
+                return k ;
+            }
+        }
+        return &Salsa20::Kernel::Scalar ;
+    }
+
+    std::atomic<const Salsa20::Kernel::Entry *>    active_ { nullptr } ;
+}
+
+const Salsa20::Kernel::Entry &  Salsa20::Kernel::Active () {
+    auto k = active_.load (std::memory_order_acquire) ;
+    if (k == nullptr) {
+        const Kernel::Entry *   expected = nullptr ;
+        k = SelectBest () ;
+        // Keeps the kernel chosen by SelectKernel () if any
+        if (! active_.compare_exchange_strong (expected, k, std::memory_order_acq_rel)) {
+            k = expected ;
+        }
+    }
+    return *k ;
+}
+
+const char *    Salsa20::GetKernelName () {
+    return Kernel::Active ().name ;
+}
+
+bool    Salsa20::SelectKernel (const char *name) {
+    auto k = (name == nullptr) ? SelectBest () : Find (name) ;
+    if (k == nullptr) {
+        return false ;
+    }
+    active_.store (k, std::memory_order_release) ;
+    return true ;
+}
+
+/*
+ * [END OF FILE]
+ */
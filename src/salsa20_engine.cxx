@@ -0,0 +1,113 @@
+/*
+ * salsa20_engine.cxx: Random number engine built on the salsa20 key stream
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "salsa20_engine.h"
+#include "salsa20_kernel.h"
+
+constexpr size_t    Salsa20::Engine::BUFFER_BLOCKS ;
+
+Salsa20::Engine::Engine (const State &state) : state_ (state), base_ (state.GetSequenceNumber ()), position_ (0) {
+    Refill () ;
+}
+
+void    Salsa20::Engine::Seek (uint64_t position) {
+    uint64_t    block = position / WORDS_PER_BLOCK ;
+    if (block < base_ || base_ + BUFFER_BLOCKS <= block) {
+        base_ = block ;
+        Refill () ;
+    }
+    position_ = static_cast<size_t> (position - base_ * WORDS_PER_BLOCK) ;
+}
+
+Salsa20::Engine Salsa20::Engine::Split (uint64_t stream) const {
+    State   s { state_ } ;
+    s.SetInitialVector (stream) ;
+    return Engine { s } ;
+}
+
+void    Salsa20::Engine::Refill () {
+    state_.SetSequenceNumber (base_) ;
+    GenerateKeystream (state_, buffer_.data (), BUFFER_BLOCKS) ;
+}
+
+void    Salsa20::Engine::Generate (uint8_t *output, size_t count) {
+    const size_t    WORD_SIZE = sizeof (result_type) ;
+
+    // The rest of the buffer first
+    size_t  n = std::min (count, BUFFER_WORDS - position_) ;
+    ::memcpy (output, &buffer_ [WORD_SIZE * position_], WORD_SIZE * n) ;
+    position_ += n ;
+    output += WORD_SIZE * n ;
+    count -= n ;
+    if (count == 0) {
+        return ;
+    }
+    // Full blocks go straight into the output
+    const uint64_t  next = base_ + BUFFER_BLOCKS ;
+    const size_t    nblocks = count / WORDS_PER_BLOCK ;
+    state_.SetSequenceNumber (next) ;
+    GenerateKeystream (state_, output, nblocks) ;
+    output += WORD_SIZE * WORDS_PER_BLOCK * nblocks ;
+    count -= WORDS_PER_BLOCK * nblocks ;
+
+    base_ = next + nblocks ;
+    Refill () ;
+    ::memcpy (output, buffer_.data (), WORD_SIZE * count) ;
+    position_ = count ;
+}
+
+void    Salsa20::Engine::Fill (result_type *output, size_t count) {
+    auto    p = reinterpret_cast<uint8_t *> (output) ;
+    Generate (p, count) ;
+#if ! defined (TARGET_LITTLE_ENDIAN)
+    for (size_t i = 0 ; i < count ; ++i, p += 4) {
+        output [i] = (  (static_cast<uint32_t> (p [0]) <<  0)
+                      | (static_cast<uint32_t> (p [1]) <<  8)
+                      | (static_cast<uint32_t> (p [2]) << 16)
+                      | (static_cast<uint32_t> (p [3]) << 24)) ;
+    }
+#endif
+}
+
+void    Salsa20::Engine::FillUniform01 (float *output, size_t count) {
+    static_assert (sizeof (float) == sizeof (result_type), "float should be 32bits") ;
+    Generate (reinterpret_cast<uint8_t *> (output), count) ;
+    Kernel::Active ().toFloat (output, count) ;
+}
+
+void    Salsa20::Engine::FillUniform01 (double *output, size_t count) {
+    static_assert (sizeof (double) == 2 * sizeof (result_type), "double should be 64bits") ;
+    Generate (reinterpret_cast<uint8_t *> (output), 2 * count) ;
+    Kernel::Active ().toDouble (output, count) ;
+}
+
+void    Salsa20::Engine::FillBounded (uint32_t *output, size_t count, uint32_t bound) {
+    Generate (reinterpret_cast<uint8_t *> (output), count) ;
+
+    auto const &    kernel = Kernel::Active () ;
+    // 2^32 mod bound
+    const uint32_t  threshold = (0u - bound) % bound ;
+    size_t  i = 0 ;
+    for (;;) {
+        i += kernel.toBounded (&output [i], count - i, bound, threshold) ;
+        if (count <= i) {
+            break ;
+        }
+        // Replaces the rejected one
+        uint64_t    m ;
+        do {
+            m = static_cast<uint64_t> ((*this) ()) * bound ;
+        } while (static_cast<uint32_t> (m) < threshold) ;
+        output [i++] = static_cast<uint32_t> (m >> 32) ;
+    }
+}
+
+/*
+ * [END OF FILE]
+ */
@@ -0,0 +1,276 @@
+/*
+ * salsa20_kernel.h: Salsa20 kernels (internal)
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_kernel_h__2f6b1c0e_8d4a_4f0b_9a57_3c1e6d2b7f48
+#define salsa20_kernel_h__2f6b1c0e_8d4a_4f0b_9a57_3c1e6d2b7f48 1
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include "salsa20.h"
+#include "salsa20_chacha20.h"
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+namespace Salsa20 {
+
+    struct StateAccess {
+        static const std::array<uint32_t, 16> &   Words (const State &state) {
+            return state.state_ ;
+        }
+        static const std::array<uint32_t, 16> &   Precomputed (const State &state) {
+            return state.precomputed_ ;
+        }
+        template <int DOUBLE_ROUNDS>
+            static const State &    Inner (const RoundState<DOUBLE_ROUNDS> &state) {
+                return state.state_ ;
+            }
+        template <int DOUBLE_ROUNDS>
+            static State &  Inner (RoundState<DOUBLE_ROUNDS> &state) {
+                return state.state_ ;
+            }
+        static const State &    Inner (const XState &state) {
+            return state.state_ ;
+        }
+        static State &  Inner (XState &state) {
+            return state.state_ ;
+        }
+        static const std::array<uint32_t, 16> &   Words (const ChaCha20::State &state) {
+            return state.state_ ;
+        }
+        /// The i-th word of "expand 16-byte k" or "expand 32-byte k" for the key size
+        static uint32_t     KeyConstant (size_t key_size, int i) {
+            return ((key_size <= 16) ? State::tau_ [i] : State::sigma_ [i]) ^ State::obfuscateMask_ ;
+        }
+    } ;
+
+    namespace Kernel {
+
+        using input_t = std::array<uint32_t, 16> ;
+
+        const size_t    BLOCK_SIZE = std::tuple_size<hash_value_t>::value ;
+
+        /// The maximum # of independent states processed by a kernel at once
+        const size_t    MAX_LANES = 16 ;
+
+        /// The state words forming the HSalsa20 output (diagonal, then the nonce position)
+        const int   HSALSA20_OUTPUT [8] = { 0, 5, 10, 15, 6, 7, 8, 9 } ;
+
+        /// The state word held at each position of a block in the scrypt layout (the diagonals)
+        const int   SCRYPT_ORDER [16] = { 0, 5, 10, 15, 3, 4, 9, 14, 2, 7, 8, 13, 1, 6, 11, 12 } ;
+
+        /// <summary>Entry points specialised for the number of the double rounds.</summary>
+        struct RoundEntry {
+            /// See Entry::computeHashValue
+            void    (*computeHashValue) (const input_t &input, uint8_t *output) ;
+            /// See Entry::applyBlocks
+            void    (*applyBlocks) (const input_t &input, const input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) ;
+        } ;
+
+        /// <summary>Entry points of a kernel.</summary>
+        struct Entry {
+            /// The kernel name
+            const char *    name ;
+            /**
+             * Computes the hash value for the sequence number held in `input`.
+             *
+             * @param input The state words
+             * @param output Receives 64 bytes of the key stream
+             */
+            void    (*computeHashValue) (const input_t &input, uint8_t *output) ;
+            /**
+             * Applies the key stream of consecutive blocks.
+             *
+             * @param input The state words
+             * @param pre The counter independent part of the first round (see below)
+             * @param seq The sequence number of the first block
+             * @param dst The output (`count` * 64 bytes)
+             * @param src The input (nullptr stores the key stream itself)
+             * @param count # of blocks to process
+             *
+             * @remarks `dst` may be equal to `src`.
+             */
+            void    (*applyBlocks) (const input_t &input, const input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) ;
+            /// # of independent states processed by applyLanes
+            size_t  lanes ;
+            /**
+             * Applies one block of the key stream for each of `lanes` independent states.
+             *
+             * @param inputs The state words of each lane
+             * @param dst The output of each lane (64 bytes each)
+             * @param src The input of each lane (nullptr stores the key stream itself)
+             */
+            void    (*applyLanes) (const input_t *inputs, uint8_t *const *dst, const uint8_t *const *src) ;
+            /**
+             * Computes HSalsa20 (the rounds without the final addition).
+             *
+             * @param input The state words (the nonce occupies the words 6...9)
+             * @param output Receives the 8 words of the subkey
+             */
+            void    (*hSalsa20) (const input_t &input, uint32_t *output) ;
+            /**
+             * Converts the key stream into floats in [0, 1) in place.
+             *
+             * @param buffer The key stream (`count` little-endian 32bit words)
+             * @param count # of floats
+             *
+             * @remarks The result is (w >> 8) * 2^-24
+             */
+            void    (*toFloat) (void *buffer, size_t count) ;
+            /**
+             * Converts the key stream into doubles in [0, 1) in place.
+             *
+             * @param buffer The key stream (`count` little-endian 64bit words)
+             * @param count # of doubles
+             *
+             * @remarks The result is (w >> 12) * 2^-52
+             */
+            void    (*toDouble) (void *buffer, size_t count) ;
+            /**
+             * Maps the key stream into [0, bound) by multiplication in place.
+             *
+             * @param buffer The key stream (`count` little-endian 32bit words)
+             * @param count # of words
+             * @param bound The upper bound
+             * @param threshold Words whose (w * bound) mod 2^32 is less than this are rejected
+             *
+             * @returns # of words converted before the first rejected one
+             *          (the rejected one and the following ones are left intact)
+             */
+            size_t  (*toBounded) (void *buffer, size_t count, uint32_t bound, uint32_t threshold) ;
+            /**
+             * Absorbs the full 16 byte blocks into the Poly1305 accumulator.
+             *
+             * @param h The accumulator (3 limbs, see salsa20_poly1305_core.h)
+             * @param r The clamped key (3 limbs)
+             * @param message The message (`count` * 16 bytes)
+             * @param count # of blocks
+             */
+            void    (*poly1305Blocks) (uint64_t *h, const uint64_t *r, const uint8_t *message, size_t count) ;
+            /**
+             * Applies the ChaCha20 key stream of consecutive blocks.
+             *
+             * @param input The ChaCha20 state words
+             * @param seq The counter of the first block (the words 12 and 13)
+             * @param dst The output (`count` * 64 bytes)
+             * @param src The input (nullptr stores the key stream itself)
+             * @param count # of blocks to process
+             *
+             * @remarks `dst` may be equal to `src`.
+             */
+            void    (*chaCha20Blocks) (const input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) ;
+            /// computeHashValue and applyBlocks for Salsa20/8
+            RoundEntry  salsa20_8 ;
+            /// computeHashValue and applyBlocks for Salsa20/12
+            RoundEntry  salsa20_12 ;
+            /**
+             * Performs the scrypt BlockMix with Salsa20/8.
+             *
+             * @param output Receives 2 * `r` blocks (the even blocks first, then the odd ones)
+             * @param x The input (2 * `r` blocks)
+             * @param v The blocks XORed into `x` before mixing (nullptr for none)
+             * @param r The block size parameter
+             *
+             * @remarks The blocks are 16 words each, held in the SCRYPT_ORDER layout.
+             *          `output` must not overlap with `x` nor `v`.
+             *          nullptr for the AVX2 and AVX512 kernels, which use the SSE2 one:
+             *          BlockMix is a serial chain of dependent Salsa20/8 cores,
+             *          so there is nothing for the wider registers to work on.
+             */
+            void    (*scryptBlockMix) (uint32_t *output, const uint32_t *x, const uint32_t *v, size_t r) ;
+        } ;
+
+        /*
+         * The counter independent part of the first round (State::precomputed_) holds:
+         *   - The words 2, 3, 6, 7, 10, 11, 14 and 15 after the first column round
+         *   - The word 4 after the first step of the column (0, 4, 8, 12)
+         *   - The term XORed into the word 9 by the first step of the column (5, 9, 13, 1) as the word 9
+         *   - The input words for the others (0 for the word 8)
+         * so the kernels only have to finish the columns (0, 4, 8, 12) and (5, 9, 13, 1).
+         */
+
+        extern const Entry  Scalar ;
+#ifdef HAVE_SSE2
+        extern const Entry  SSE2 ;
+#endif
+#ifdef HAVE_AVX2
+        extern const Entry  AVX2 ;
+#endif
+#ifdef HAVE_AVX512
+        extern const Entry  AVX512 ;
+#endif
+
+        /**
+         * Retrieves the kernel to use.
+         *
+         * @remarks The best kernel for the running CPU is selected at the first call.
+         */
+        const Entry &   Active () ;
+
+        /*
+         * The helpers shared by the kernels live in the unnamed namespace,
+         * as the kernels are compiled with their own target flags: an external
+         * inline copy built for AVX2 could be the one the linker keeps for all.
+         */
+        namespace {
+            /**
+             * Retrieves the entry points for the number of the double rounds.
+             */
+            template <int DOUBLE_ROUNDS>
+                RoundEntry  ForRounds (const Entry &entry) ;
+
+            template <>
+                inline RoundEntry   ForRounds<4> (const Entry &entry) {
+                    return entry.salsa20_8 ;
+                }
+
+            template <>
+                inline RoundEntry   ForRounds<6> (const Entry &entry) {
+                    return entry.salsa20_12 ;
+                }
+
+            template <>
+                inline RoundEntry   ForRounds<10> (const Entry &entry) {
+                    return RoundEntry { entry.computeHashValue, entry.applyBlocks } ;
+                }
+
+            /**
+             * Makes a copy of `input` with the sequence number replaced by `seq`.
+             */
+            inline input_t  WithSequenceNumber (const input_t &input, uint64_t seq) {
+                input_t result = input ;
+                result [8] = static_cast<uint32_t> (seq >>  0) ;
+                result [9] = static_cast<uint32_t> (seq >> 32) ;
+                return result ;
+            }
+
+            /**
+             * Makes a copy of the ChaCha20 `input` with the counter replaced by `seq`.
+             */
+            inline input_t  WithChaCha20Counter (const input_t &input, uint64_t seq) {
+                input_t result = input ;
+                result [12] = static_cast<uint32_t> (seq >>  0) ;
+                result [13] = static_cast<uint32_t> (seq >> 32) ;
+                return result ;
+            }
+
+            /**
+             * Advances the (optional) source pointer.
+             */
+            inline const uint8_t *  Advance (const uint8_t *src, size_t amount) {
+                return (src != nullptr) ? src + amount : nullptr ;
+            }
+        }
+    }
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_kernel_h__2f6b1c0e_8d4a_4f0b_9a57_3c1e6d2b7f48 */
+/*
+ * [END OF FILE]
+ */
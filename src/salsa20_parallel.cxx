@@ -0,0 +1,336 @@
+/*
+ * salsa20_parallel.cxx: Multi-threaded salsa20 encryption
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "salsa20_parallel.h"
+
+struct Salsa20::Executor::Impl {
+    std::mutex                          mutex_ ;
+    std::condition_variable             cv_ ;
+    std::deque<std::function<void ()>>  queue_ ;
+    bool                                stopping_ = false ;
+    std::vector<std::thread>            workers_ ;
+
+    void    Run () {
+        for (;;) {
+            std::function<void ()>  task ;
+            {
+                std::unique_lock<std::mutex>    lock { mutex_ } ;
+                cv_.wait (lock, [this]() { return stopping_ || ! queue_.empty () ; }) ;
+                if (queue_.empty ()) {
+                    return ;
+                }
+                task = std::move (queue_.front ()) ;
+                queue_.pop_front () ;
+            }
+            task () ;
+        }
+    }
+} ;
+
+Salsa20::Executor::Executor (size_t num_threads) : impl_ { new Impl } {
+    if (num_threads == 0) {
+        num_threads = std::max<size_t> (1, std::thread::hardware_concurrency ()) ;
+    }
+    for (size_t i = 0 ; i < num_threads ; ++i) {
+        impl_->workers_.emplace_back ([this]() { impl_->Run () ; }) ;
+    }
+}
+
+Salsa20::Executor::~Executor () {
+    {
+        std::lock_guard<std::mutex> lock { impl_->mutex_ } ;
+        impl_->stopping_ = true ;
+    }
+    impl_->cv_.notify_all () ;
+    for (auto &t : impl_->workers_) {
+        t.join () ;
+    }
+}
+
+size_t  Salsa20::Executor::GetThreadCount () const {
+    return impl_->workers_.size () ;
+}
+
+void    Salsa20::Executor::Submit (std::function<void ()> task) {
+    {
+        std::lock_guard<std::mutex> lock { impl_->mutex_ } ;
+        impl_->queue_.emplace_back (std::move (task)) ;
+    }
+    impl_->cv_.notify_one () ;
+}
+
+void    Salsa20::Executor::ParallelFor (size_t count, const std::function<void (size_t)> &fn) {
+    // Shared with the helpers (they may start after this returns)
+    struct Loop {
+        std::atomic<size_t>     next { 0 } ;
+        std::mutex              mutex ;
+        std::condition_variable cv ;
+        size_t                  done = 0 ;
+    } ;
+    auto    loop = std::make_shared<Loop> () ;
+    auto    body = [loop, count, &fn]() {
+        size_t  n = 0 ;
+        for (size_t i ; (i = loop->next.fetch_add (1)) < count ; ++n) {
+            fn (i) ;
+        }
+        if (0 < n) {
+            std::lock_guard<std::mutex> lock { loop->mutex } ;
+            loop->done += n ;
+            if (loop->done == count) {
+                loop->cv.notify_all () ;
+            }
+        }
+    } ;
+    // `fn` is referenced only while some iterations remain, i.e. while the caller waits.
+    const size_t    num_helpers = std::min (GetThreadCount (), (0 < count) ? count - 1 : 0) ;
+    for (size_t i = 0 ; i < num_helpers ; ++i) {
+        Submit (body) ;
+    }
+    body () ;
+
+    std::unique_lock<std::mutex>    lock { loop->mutex } ;
+    loop->cv.wait (lock, [&loop, count]() { return loop->done == count ; }) ;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+void    Salsa20::ParallelApply (Salsa20::State &state, void *dst, const void *src, size_t length, Executor &executor) {
+    const size_t    BLOCK_SIZE = std::tuple_size<hash_value_t>::value ;
+    const size_t    MIN_CHUNK_SIZE = 64 * 1024 ;
+    const size_t    MAX_CHUNK_SIZE = 4 * 1024 * 1024 ;
+
+    // A few chunks per thread to even out the load
+    size_t  chunk_size = length / (4 * (executor.GetThreadCount () + 1)) ;
+    chunk_size = std::min (std::max (chunk_size, MIN_CHUNK_SIZE), MAX_CHUNK_SIZE) ;
+    chunk_size = (chunk_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE ;
+
+    const size_t    num_chunks = (length + chunk_size - 1) / chunk_size ;
+    if (num_chunks <= 1) {
+        Apply (state, dst, src, length) ;
+        return ;
+    }
+    const uint64_t  seq = state.GetSequenceNumber () ;
+    const State     base { state } ;
+
+    auto    p = static_cast<const uint8_t *> (src) ;
+    auto    q = static_cast<uint8_t *> (dst) ;
+
+    executor.ParallelFor (num_chunks, [&](size_t i) {
+        const size_t    offset = i * chunk_size ;
+        State   s { base } ;
+        s.SetSequenceNumber (seq + offset / BLOCK_SIZE) ;
+        Apply (s, q + offset, p + offset, std::min (chunk_size, length - offset)) ;
+    }) ;
+    state.SetSequenceNumber (seq + (length + BLOCK_SIZE - 1) / BLOCK_SIZE) ;
+}
+
+void    Salsa20::ParallelApply (Salsa20::State &state, void *message, size_t length, Executor &executor) {
+    ParallelApply (state, message, message, length, executor) ;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+namespace {
+    const size_t    BLOCK_SIZE = std::tuple_size<Salsa20::hash_value_t>::value ;
+
+    /// Ranges larger than this are split to be stolen
+    const size_t    GRAIN_SIZE = 256 * 1024 ;
+
+    struct Job {
+        Salsa20::State          state ;
+        uint64_t                seq ;
+        uint8_t *               dst ;
+        const uint8_t *         src ;
+        /// # of bytes not processed yet
+        std::atomic<size_t>     remain ;
+        std::function<void ()>  on_complete ;
+
+        Job (const Salsa20::State &state, void *dst, const void *src, size_t length, std::function<void ()> &&on_complete)
+                : state (state)
+                , seq (state.GetSequenceNumber ())
+                , dst (static_cast<uint8_t *> (dst))
+                , src (static_cast<const uint8_t *> (src))
+                , remain (length)
+                , on_complete (std::move (on_complete)) {
+            /* NO-OP */
+        }
+    } ;
+
+    /// <summary>The block aligned part of a job.</summary>
+    struct Range {
+        std::shared_ptr<Job>    job ;
+        size_t                  begin ;
+        size_t                  end ;
+    } ;
+
+    /// <summary>The ranges owned by a worker (the owner works at the back, thieves at the front).</summary>
+    struct Queue {
+        std::mutex          mutex ;
+        std::deque<Range>   ranges ;
+    } ;
+}
+
+struct Salsa20::Scheduler::Impl {
+    std::vector<std::unique_ptr<Queue>> queues_ ;
+    std::vector<std::thread>            workers_ ;
+    std::atomic<size_t>                 nextQueue_ { 0 } ;
+
+    std::mutex                          mutex_ ;
+    /// Signaled when a range is queued
+    std::condition_variable             cvRange_ ;
+    /// Signaled when all the jobs are done
+    std::condition_variable             cvIdle_ ;
+    /// # of queued ranges (guarded by mutex_)
+    size_t                              numRanges_ = 0 ;
+    /// # of unfinished jobs (guarded by mutex_)
+    size_t                              numJobs_ = 0 ;
+    bool                                stopping_ = false ;
+
+    void    Push (size_t q, Range &&range) {
+        {
+            // Counts the range before the queue lock is released (in the same order as Pop),
+            // so that a thief never decrements numRanges_ below the # of the queued ranges
+            std::lock_guard<std::mutex> lock { queues_ [q]->mutex } ;
+            queues_ [q]->ranges.emplace_back (std::move (range)) ;
+            std::lock_guard<std::mutex> lock_count { mutex_ } ;
+            ++numRanges_ ;
+        }
+        cvRange_.notify_one () ;
+    }
+
+    bool    Pop (size_t self, Range &range) {
+        const size_t    n = queues_.size () ;
+        for (size_t i = 0 ; i < n ; ++i) {
+            auto &  q = *queues_ [(self + i) % n] ;
+            std::lock_guard<std::mutex> lock { q.mutex } ;
+            if (q.ranges.empty ()) {
+                continue ;
+            }
+            if (i == 0) {
+                // Newest (smallest) one of ours
+                range = std::move (q.ranges.back ()) ;
+                q.ranges.pop_back () ;
+            }
+            else {
+                // Steals the oldest (largest) one
+                range = std::move (q.ranges.front ()) ;
+                q.ranges.pop_front () ;
+            }
+            std::lock_guard<std::mutex> lock_count { mutex_ } ;
+            --numRanges_ ;
+            return true ;
+        }
+        return false ;
+    }
+
+    void    Process (size_t self, Range &&range) {
+        // Leaves the upper halves for the thieves
+        while (GRAIN_SIZE < range.end - range.begin) {
+            size_t  mid = range.begin + (range.end - range.begin) / 2 / BLOCK_SIZE * BLOCK_SIZE ;
+            Push (self, Range { range.job, mid, range.end }) ;
+            range.end = mid ;
+        }
+        auto &  job = *range.job ;
+        size_t  length = range.end - range.begin ;
+
+        State   s { job.state } ;
+        s.SetSequenceNumber (job.seq + range.begin / BLOCK_SIZE) ;
+        Apply (s, job.dst + range.begin, job.src + range.begin, length) ;
+
+        if (job.remain.fetch_sub (length) == length) {
+            Complete (job) ;
+        }
+    }
+
+    void    Complete (Job &job) {
+        if (job.on_complete) {
+            job.on_complete () ;
+        }
+        std::lock_guard<std::mutex> lock { mutex_ } ;
+        if (--numJobs_ == 0) {
+            cvIdle_.notify_all () ;
+        }
+    }
+
+    void    Run (size_t self) {
+        for (;;) {
+            Range   range ;
+            if (Pop (self, range)) {
+                Process (self, std::move (range)) ;
+                continue ;
+            }
+            std::unique_lock<std::mutex>    lock { mutex_ } ;
+            cvRange_.wait (lock, [this]() { return stopping_ || 0 < numRanges_ ; }) ;
+            if (numRanges_ == 0) {
+                return ;
+            }
+        }
+    }
+} ;
+
+Salsa20::Scheduler::Scheduler (size_t num_threads) : impl_ { new Impl } {
+    if (num_threads == 0) {
+        num_threads = std::max<size_t> (1, std::thread::hardware_concurrency ()) ;
+    }
+    for (size_t i = 0 ; i < num_threads ; ++i) {
+        impl_->queues_.emplace_back (new Queue) ;
+    }
+    for (size_t i = 0 ; i < num_threads ; ++i) {
+        impl_->workers_.emplace_back ([this, i]() { impl_->Run (i) ; }) ;
+    }
+}
+
+Salsa20::Scheduler::~Scheduler () {
+    Wait () ;
+    {
+        std::lock_guard<std::mutex> lock { impl_->mutex_ } ;
+        impl_->stopping_ = true ;
+    }
+    impl_->cvRange_.notify_all () ;
+    for (auto &t : impl_->workers_) {
+        t.join () ;
+    }
+}
+
+size_t  Salsa20::Scheduler::GetThreadCount () const {
+    return impl_->workers_.size () ;
+}
+
+void    Salsa20::Scheduler::Submit (const Salsa20::State &state, void *dst, const void *src, size_t length, std::function<void ()> on_complete) {
+    // Empty jobs are queued too, so `on_complete` always runs on a worker
+    {
+        std::lock_guard<std::mutex> lock { impl_->mutex_ } ;
+        ++impl_->numJobs_ ;
+    }
+    auto    job = std::make_shared<Job> (state, dst, src, length, std::move (on_complete)) ;
+    // Spreads the jobs over the workers
+    const size_t    q = impl_->nextQueue_.fetch_add (1) % impl_->queues_.size () ;
+    impl_->Push (q, Range { std::move (job), 0, length }) ;
+}
+
+std::future<void>   Salsa20::Scheduler::Submit (const Salsa20::State &state, void *dst, const void *src, size_t length) {
+    auto    promise = std::make_shared<std::promise<void>> () ;
+    auto    result = promise->get_future () ;
+    Submit (state, dst, src, length, [promise]() { promise->set_value () ; }) ;
+    return result ;
+}
+
+void    Salsa20::Scheduler::Wait () {
+    std::unique_lock<std::mutex>    lock { impl_->mutex_ } ;
+    impl_->cvIdle_.wait (lock, [this]() { return impl_->numJobs_ == 0 ; }) ;
+}
+
+/*
+ * [END OF FILE]
+ */
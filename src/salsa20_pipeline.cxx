@@ -0,0 +1,515 @@
+/*
+ * salsa20_pipeline.cxx: Asynchronous file encryption
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+#include "salsa20.h"
+#include "salsa20_parallel.h"
+#include "salsa20_pipeline.h"
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined (HAVE_LINUX_IO_URING_H)
+#   include <linux/io_uring.h>
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <sys/uio.h>
+#   if defined (__NR_io_uring_setup) && defined (__NR_io_uring_enter)
+#       define USE_IO_URING    1
+#   endif
+#endif
+
+namespace {
+    const size_t    CIPHER_BLOCK_SIZE = std::tuple_size<Salsa20::hash_value_t>::value ;
+
+    uint64_t    GetFileSize (int fd) {
+        struct stat st ;
+        if (::fstat (fd, &st) != 0) {
+            throw std::system_error { errno, std::generic_category (), "fstat" } ;
+        }
+        return static_cast<uint64_t> (st.st_size) ;
+    }
+
+    /// <summary>The shape of the work.</summary>
+    struct Plan {
+        uint64_t    size ;
+        size_t      chunk_size ;
+        uint64_t    num_chunks ;
+
+        Plan (uint64_t size, const Salsa20::PipelineOptions &options)
+                : size (size)
+                , chunk_size ((std::max<size_t> (options.chunk_size, 1) + CIPHER_BLOCK_SIZE - 1) / CIPHER_BLOCK_SIZE * CIPHER_BLOCK_SIZE)
+                , num_chunks ((size + chunk_size - 1) / chunk_size) {
+            /* NO-OP */
+        }
+
+        size_t  GetLength (uint64_t chunk) const {
+            return static_cast<size_t> (std::min<uint64_t> (chunk_size, size - chunk * chunk_size)) ;
+        }
+    } ;
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+    /**
+     * Runs the pread/encrypt/pwrite loops on the thread pool.
+     *
+     * Each loop owns a chunk buffer and claims the chunks one by one,
+     * so the loops overlap each other's reads, encryption and writes.
+     */
+    void    ApplyWithThreads (const Salsa20::State &state, int dst_fd, int src_fd, const Plan &plan, const Salsa20::PipelineOptions &options) {
+        Salsa20::Executor   executor { std::max<size_t> (options.queue_depth, 1) - 1 } ;
+        std::atomic<uint64_t>   next { 0 } ;
+        std::mutex              mutex ;
+        std::exception_ptr      error ;
+
+        auto    fail = [&](int err, const char *what) {
+            std::lock_guard<std::mutex> lock { mutex } ;
+            if (! error) {
+                error = std::make_exception_ptr (std::system_error { err, std::generic_category (), what }) ;
+            }
+            // Stops the others
+            next.store (plan.num_chunks) ;
+        } ;
+        const size_t    num_loops = static_cast<size_t> (std::min<uint64_t> (std::max<size_t> (options.queue_depth, 1), plan.num_chunks)) ;
+        executor.ParallelFor (num_loops, [&](size_t) {
+            std::unique_ptr<uint8_t []> buffer { new uint8_t [plan.chunk_size] } ;
+            for (uint64_t chunk ; (chunk = next.fetch_add (1)) < plan.num_chunks ; ) {
+                const uint64_t  offset = chunk * plan.chunk_size ;
+                const size_t    length = plan.GetLength (chunk) ;
+                for (size_t done = 0 ; done < length ; ) {
+                    ssize_t n = ::pread (src_fd, &buffer [done], length - done, static_cast<off_t> (offset + done)) ;
+                    if (n <= 0) {
+                        if (n < 0 && errno == EINTR) {
+                            continue ;
+                        }
+                        fail ((n < 0) ? errno : EIO, "pread") ;
+                        return ;
+                    }
+                    done += static_cast<size_t> (n) ;
+                }
+                Salsa20::ApplyAt (state, buffer.get (), length, offset) ;
+                for (size_t done = 0 ; done < length ; ) {
+                    ssize_t n = ::pwrite (dst_fd, &buffer [done], length - done, static_cast<off_t> (offset + done)) ;
+                    if (n <= 0) {
+                        if (n < 0 && errno == EINTR) {
+                            continue ;
+                        }
+                        fail ((n < 0) ? errno : EIO, "pwrite") ;
+                        return ;
+                    }
+                    done += static_cast<size_t> (n) ;
+                }
+            }
+        }) ;
+        if (error) {
+            std::rethrow_exception (error) ;
+        }
+    }
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+#if defined (USE_IO_URING)
+    /// <summary>The minimal io_uring wrapper (single reaper, serialized submitters).</summary>
+    class Ring {
+    private:
+        int         fd_ = -1 ;
+        void *      sq_ring_ = MAP_FAILED ;
+        size_t      sq_ring_size_ = 0 ;
+        void *      cq_ring_ = MAP_FAILED ;
+        size_t      cq_ring_size_ = 0 ;
+        io_uring_sqe *  sqes_ = static_cast<io_uring_sqe *> (MAP_FAILED) ;
+        size_t      sqes_size_ = 0 ;
+
+        unsigned *  sq_tail_ ;
+        unsigned    sq_mask_ ;
+        unsigned *  sq_array_ ;
+        unsigned *  cq_head_ ;
+        unsigned *  cq_tail_ ;
+        unsigned    cq_mask_ ;
+        io_uring_cqe *  cqes_ ;
+
+        std::mutex  submit_mutex_ ;
+    public:
+        /**
+         * Creates the ring.
+         *
+         * @param entries # of submission queue entries
+         *
+         * @remarks Throws std::system_error when io_uring is not usable.
+         */
+        explicit Ring (unsigned entries) {
+            io_uring_params params ;
+            ::memset (&params, 0, sizeof (params)) ;
+            fd_ = static_cast<int> (::syscall (__NR_io_uring_setup, entries, &params)) ;
+            if (fd_ < 0) {
+                throw std::system_error { errno, std::generic_category (), "io_uring_setup" } ;
+            }
+            sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof (unsigned) ;
+            cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe) ;
+            const bool  single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0 ;
+            if (single_mmap) {
+                sq_ring_size_ = cq_ring_size_ = std::max (sq_ring_size_, cq_ring_size_) ;
+            }
+            sq_ring_ = ::mmap (nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING) ;
+            if (sq_ring_ == MAP_FAILED) {
+                Fail ("mmap") ;
+            }
+            if (single_mmap) {
+                cq_ring_ = sq_ring_ ;
+            }
+            else {
+                cq_ring_ = ::mmap (nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING) ;
+                if (cq_ring_ == MAP_FAILED) {
+                    Fail ("mmap") ;
+                }
+            }
+            sqes_size_ = params.sq_entries * sizeof (io_uring_sqe) ;
+            sqes_ = static_cast<io_uring_sqe *> (::mmap (nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES)) ;
+            if (sqes_ == MAP_FAILED) {
+                Fail ("mmap") ;
+            }
+            auto    sq = static_cast<uint8_t *> (sq_ring_) ;
+            auto    cq = static_cast<uint8_t *> (cq_ring_) ;
+            sq_tail_  = reinterpret_cast<unsigned *> (sq + params.sq_off.tail) ;
+            sq_mask_  = *reinterpret_cast<unsigned *> (sq + params.sq_off.ring_mask) ;
+            sq_array_ = reinterpret_cast<unsigned *> (sq + params.sq_off.array) ;
+            cq_head_  = reinterpret_cast<unsigned *> (cq + params.cq_off.head) ;
+            cq_tail_  = reinterpret_cast<unsigned *> (cq + params.cq_off.tail) ;
+            cq_mask_  = *reinterpret_cast<unsigned *> (cq + params.cq_off.ring_mask) ;
+            cqes_     = reinterpret_cast<io_uring_cqe *> (cq + params.cq_off.cqes) ;
+        }
+
+        Ring (const Ring &) = delete ;
+
+        Ring & operator = (const Ring &) = delete ;
+
+        ~Ring () {
+            Release () ;
+        }
+        /**
+         * Submits the vectored read or write.
+         *
+         * @remarks Only fails on the broken ring (e.g. the invalid descriptor).
+         *          Nothing is left in the ring when it throws.
+         */
+        void    Submit (uint8_t opcode, int fd, const iovec *iov, uint64_t offset, uint64_t user_data) {
+            io_uring_sqe    sqe ;
+            ::memset (&sqe, 0, sizeof (sqe)) ;
+            sqe.opcode = opcode ;
+            sqe.fd = fd ;
+            sqe.addr = reinterpret_cast<uint64_t> (iov) ;
+            sqe.len = 1 ;
+            sqe.off = offset ;
+            sqe.user_data = user_data ;
+            Push (sqe) ;
+        }
+        /**
+         * Posts a no-op, whose completion wakes up the thread blocked in Reap (callable from any thread).
+         */
+        void    Wake (uint64_t user_data) {
+            io_uring_sqe    sqe ;
+            ::memset (&sqe, 0, sizeof (sqe)) ;
+            sqe.opcode = IORING_OP_NOP ;
+            sqe.fd = -1 ;
+            sqe.user_data = user_data ;
+            Push (sqe) ;
+        }
+        /**
+         * Waits for at least one completion and passes each of them to `fn (user_data, result)`.
+         */
+        template <typename Fn_>
+            void    Reap (Fn_ &&fn) {
+                unsigned    head = *cq_head_ ;
+                while (head == __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE)) {
+                    int rc = static_cast<int> (::syscall (__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0)) ;
+                    if (rc < 0 && errno != EINTR) {
+                        throw std::system_error { errno, std::generic_category (), "io_uring_enter" } ;
+                    }
+                }
+                const unsigned  tail = __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE) ;
+                for (; head != tail ; ++head) {
+                    const io_uring_cqe &    cqe = cqes_ [head & cq_mask_] ;
+                    const uint64_t  user_data = cqe.user_data ;
+                    const int32_t   result = cqe.res ;
+                    __atomic_store_n (cq_head_, head + 1, __ATOMIC_RELEASE) ;
+                    fn (user_data, result) ;
+                }
+            }
+    private:
+        void    Push (const io_uring_sqe &sqe) {
+            std::lock_guard<std::mutex> lock { submit_mutex_ } ;
+            const unsigned  tail = *sq_tail_ ;
+            const unsigned  index = tail & sq_mask_ ;
+            sqes_ [index] = sqe ;
+            sq_array_ [index] = index ;
+            __atomic_store_n (sq_tail_, tail + 1, __ATOMIC_RELEASE) ;
+            for (;;) {
+                int rc = static_cast<int> (::syscall (__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0)) ;
+                if (0 <= rc) {
+                    break ;
+                }
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    const int   err = errno ;
+                    // Takes the entry back, so that a later call does not submit it behind our back
+                    __atomic_store_n (sq_tail_, tail, __ATOMIC_RELEASE) ;
+                    throw std::system_error { err, std::generic_category (), "io_uring_enter" } ;
+                }
+            }
+        }
+
+        [[noreturn]] void   Fail (const char *what) {
+            int err = errno ;
+            Release () ;
+            throw std::system_error { err, std::generic_category (), what } ;
+        }
+
+        void    Release () {
+            if (sqes_ != MAP_FAILED) {
+                ::munmap (sqes_, sqes_size_) ;
+            }
+            if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+                ::munmap (cq_ring_, cq_ring_size_) ;
+            }
+            if (sq_ring_ != MAP_FAILED) {
+                ::munmap (sq_ring_, sq_ring_size_) ;
+            }
+            if (0 <= fd_) {
+                ::close (fd_) ;
+            }
+        }
+    } ;
+
+    /**
+     * Runs the pipeline on io_uring.
+     *
+     * The calling thread keeps up to `queue_depth` chunks in flight and
+     * reaps the completions.  Each completed read is encrypted on the
+     * thread pool, which hands the chunk back to the calling thread to
+     * submit the write.  A chunk slot is reused for the next read once
+     * its write completes.
+     *
+     * All the reads and the writes are submitted by the calling thread, so
+     * a failed submission is noticed where the slots are accounted for.
+     * The slots are not released until the operations using them are
+     * reaped, whatever the failure is.
+     */
+    void    ApplyWithRing (Ring &ring, const Salsa20::State &state, int dst_fd, int src_fd, const Plan &plan, const Salsa20::PipelineOptions &options) {
+        struct Slot {
+            std::unique_ptr<uint8_t []> buffer ;
+            uint64_t    offset ;
+            size_t      length ;
+            /// # of bytes read/written so far
+            size_t      done ;
+            iovec       iov ;
+        } ;
+        enum : uint64_t { OP_READ = 0, OP_WRITE = 1, WAKE_UP = ~0ull } ;
+
+        const size_t    num_slots = static_cast<size_t> (std::min<uint64_t> (std::max<size_t> (options.queue_depth, 1), plan.num_chunks)) ;
+        // Leaked (instead of freed under the kernel) when the ring breaks with the operations in flight
+        std::unique_ptr<std::vector<Slot>>  slots_holder { new std::vector<Slot> (num_slots) } ;
+        auto &              slots = *slots_holder ;
+        std::vector<size_t> free_slots ;
+        for (size_t i = 0 ; i < num_slots ; ++i) {
+            slots [i].buffer.reset (new uint8_t [plan.chunk_size]) ;
+            free_slots.push_back (i) ;
+        }
+        std::exception_ptr  error ;
+        /// # of slots not in free_slots (reading, encrypting or writing)
+        size_t      busy = 0 ;
+        /// # of reads and writes in the ring
+        size_t      in_flight = 0 ;
+
+        auto    fail = [&error](std::exception_ptr e) {
+            if (! error) {
+                error = e ;
+            }
+        } ;
+        auto    release = [&busy, &free_slots](size_t index) {
+            --busy ;
+            free_slots.push_back (index) ;
+        } ;
+        auto    submit = [&](size_t index, uint64_t op) {
+            Slot &  s = slots [index] ;
+            s.iov.iov_base = &s.buffer [s.done] ;
+            s.iov.iov_len = s.length - s.done ;
+            try {
+                ring.Submit ( (op == OP_READ) ? IORING_OP_READV : IORING_OP_WRITEV
+                            , (op == OP_READ) ? src_fd : dst_fd
+                            , &s.iov, s.offset + s.done, (index << 1) | op) ;
+            }
+            catch (...) {
+                fail (std::current_exception ()) ;
+                release (index) ;
+                return ;
+            }
+            ++in_flight ;
+        } ;
+
+        // The chunks handed back by the encryption threads (guarded by mutex)
+        std::mutex          mutex ;
+        std::condition_variable cv ;
+        std::vector<size_t> encrypted ;
+        std::exception_ptr  encrypt_error ;
+        {
+            // Destroyed (i.e. joined) before the slots go away
+            Salsa20::Executor   executor { options.num_threads } ;
+            auto    encrypt = [&](size_t index) {
+                Slot &  s = slots [index] ;
+                try {
+                    Salsa20::ApplyAt (state, s.buffer.get (), s.length, s.offset) ;
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock { mutex } ;
+                    if (! encrypt_error) {
+                        encrypt_error = std::current_exception () ;
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock { mutex } ;
+                    encrypted.push_back (index) ;
+                }
+                cv.notify_one () ;
+                try {
+                    ring.Wake (WAKE_UP) ;
+                }
+                catch (const std::system_error &) {
+                    // The chunk is still picked up at the next completion
+                }
+            } ;
+            uint64_t    next = 0 ;
+            for (;;) {
+                while (! error && next < plan.num_chunks && ! free_slots.empty ()) {
+                    const size_t    index = free_slots.back () ;
+                    free_slots.pop_back () ;
+                    Slot &  s = slots [index] ;
+                    s.offset = next * plan.chunk_size ;
+                    s.length = plan.GetLength (next) ;
+                    s.done = 0 ;
+                    ++next ;
+                    ++busy ;
+                    submit (index, OP_READ) ;
+                }
+                std::vector<size_t> ready ;
+                {
+                    std::unique_lock<std::mutex>    lock { mutex } ;
+                    if (in_flight == 0 && 0 < busy) {
+                        // Nothing to reap, the rest are being encrypted
+                        cv.wait (lock, [&encrypted]() { return ! encrypted.empty () ; }) ;
+                    }
+                    ready.swap (encrypted) ;
+                    if (encrypt_error) {
+                        fail (encrypt_error) ;
+                    }
+                }
+                for (size_t index : ready) {
+                    if (error) {
+                        release (index) ;
+                        continue ;
+                    }
+                    slots [index].done = 0 ;
+                    submit (index, OP_WRITE) ;
+                }
+                if (busy == 0) {
+                    break ;
+                }
+                if (in_flight == 0) {
+                    continue ;
+                }
+                try {
+                    ring.Reap ([&](uint64_t user_data, int32_t result) {
+                        if (user_data == WAKE_UP) {
+                            return ;
+                        }
+                        --in_flight ;
+                        const size_t    index = static_cast<size_t> (user_data >> 1) ;
+                        const uint64_t  op = user_data & 1 ;
+                        Slot &  s = slots [index] ;
+                        if (result == -EINTR || result == -EAGAIN) {
+                            submit (index, op) ;
+                            return ;
+                        }
+                        if (result <= 0) {
+                            const int   err = (result < 0) ? -result : EIO ;
+                            fail (std::make_exception_ptr (std::system_error { err, std::generic_category (), (op == OP_READ) ? "read" : "write" })) ;
+                            release (index) ;
+                            return ;
+                        }
+                        s.done += static_cast<size_t> (result) ;
+                        if (s.done < s.length) {
+                            // Short transfer, continues with the rest
+                            submit (index, op) ;
+                            return ;
+                        }
+                        if (op == OP_READ && ! error) {
+                            try {
+                                executor.Submit ([&encrypt, index]() { encrypt (index) ; }) ;
+                                return ;
+                            }
+                            catch (...) {
+                                fail (std::current_exception ()) ;
+                            }
+                        }
+                        release (index) ;
+                    }) ;
+                }
+                catch (...) {
+                    // The operations in flight can no longer be reaped, so the kernel
+                    // may still be using the buffers and the iovecs
+                    slots_holder.release () ;
+                    fail (std::current_exception ()) ;
+                    break ;
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception (error) ;
+        }
+    }
+#endif  /* USE_IO_URING */
+}
+
+uint64_t    Salsa20::ApplyFile (const Salsa20::State &state, int dst_fd, int src_fd, const PipelineOptions &options) {
+    const Plan  plan { GetFileSize (src_fd), options } ;
+    if (plan.num_chunks == 0) {
+        return 0 ;
+    }
+#if defined (USE_IO_URING)
+    if (options.use_io_uring) {
+        std::unique_ptr<Ring>   ring ;
+        try {
+            ring.reset (new Ring { static_cast<unsigned> (std::min<size_t> (std::max<size_t> (options.queue_depth, 1), 4096)) }) ;
+        }
+        catch (const std::system_error &) {
+            // Not supported (old kernel or prohibited by the sandbox), falls back to the threads
+        }
+        if (ring) {
+            ApplyWithRing (*ring, state, dst_fd, src_fd, plan, options) ;
+            return plan.size ;
+        }
+    }
+#endif
+    ApplyWithThreads (state, dst_fd, src_fd, plan, options) ;
+    return plan.size ;
+}
+
+/*
+ * [END OF FILE]
+ */
@@ -0,0 +1,207 @@
+/*
+ * salsa20_poly1305.cxx: Poly1305 one-time authenticator and XSalsa20-Poly1305 secret box
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "salsa20_poly1305.h"
+#include "salsa20_kernel.h"
+#include "salsa20_poly1305_core.h"
+#include "salsa20_secure.h"
+
+namespace {
+    /// The messages are encrypted and authenticated in this unit (fits in L1 with the output)
+    const size_t    CHUNK_SIZE = 16 * 1024 ;
+
+    bool    EqualTags (const uint8_t *a, const uint8_t *b) {
+        uint8_t diff = 0 ;
+        for (size_t i = 0 ; i < Salsa20::Poly1305::TAG_SIZE ; ++i) {
+            diff |= a [i] ^ b [i] ;
+        }
+        return diff == 0 ;
+    }
+}
+
+constexpr size_t    Salsa20::Poly1305::KEY_SIZE ;
+constexpr size_t    Salsa20::Poly1305::TAG_SIZE ;
+
+Salsa20::Poly1305::Poly1305 (const void *key) : h_ { { 0, 0, 0 } }, buffered_ (0) {
+    namespace Core = Poly1305Core ;
+    auto    k = static_cast<const uint8_t *> (key) ;
+    const uint64_t  t0 = Core::LoadLE64 (&k [0]) ;
+    const uint64_t  t1 = Core::LoadLE64 (&k [8]) ;
+    // Clamped
+    r_ [0] = t0 & 0xFFC0FFFFFFFull ;
+    r_ [1] = ((t0 >> 44) | (t1 << 20)) & 0xFFFFFC0FFFFull ;
+    r_ [2] = (t1 >> 24) & 0x00FFFFFFC0Full ;
+    pad_ [0] = Core::LoadLE64 (&k [16]) ;
+    pad_ [1] = Core::LoadLE64 (&k [24]) ;
+}
+
+Salsa20::Poly1305::~Poly1305 () {
+    SecureZero (r_.data (), sizeof (r_)) ;
+    SecureZero (h_.data (), sizeof (h_)) ;
+    SecureZero (pad_.data (), sizeof (pad_)) ;
+    SecureZero (buffer_.data (), buffer_.size ()) ;
+}
+
+void    Salsa20::Poly1305::Update (const void *message, size_t length) {
+    auto const &    kernel = Kernel::Active () ;
+    auto    p = static_cast<const uint8_t *> (message) ;
+    if (0 < buffered_) {
+        size_t  n = std::min (length, buffer_.size () - buffered_) ;
+        ::memcpy (&buffer_ [buffered_], p, n) ;
+        buffered_ += n ;
+        p += n ;
+        length -= n ;
+        if (buffered_ < buffer_.size ()) {
+            return ;
+        }
+        kernel.poly1305Blocks (h_.data (), r_.data (), buffer_.data (), 1) ;
+        buffered_ = 0 ;
+    }
+    const size_t    nblocks = length / buffer_.size () ;
+    if (0 < nblocks) {
+        kernel.poly1305Blocks (h_.data (), r_.data (), p, nblocks) ;
+        p += nblocks * buffer_.size () ;
+        length -= nblocks * buffer_.size () ;
+    }
+    ::memcpy (buffer_.data (), p, length) ;
+    buffered_ = length ;
+}
+
+void    Salsa20::Poly1305::Finish (void *tag) {
+    namespace Core = Poly1305Core ;
+    const uint64_t  MASK44 = Core::MASK44 ;
+    const uint64_t  MASK42 = Core::MASK42 ;
+
+    if (0 < buffered_) {
+        // Padded with 1 instead of the 2^128 bit
+        buffer_ [buffered_] = 1 ;
+        std::fill (buffer_.begin () + buffered_ + 1, buffer_.end (), 0) ;
+        Core::Blocks (h_.data (), r_.data (), buffer_.data (), 1, 0) ;
+        buffered_ = 0 ;
+    }
+    uint64_t    h0 = h_ [0] ;
+    uint64_t    h1 = h_ [1] ;
+    uint64_t    h2 = h_ [2] ;
+    // Fully carries h
+    uint64_t    c = h1 >> 44 ;
+    h1 &= MASK44 ;
+    h2 += c ;       c = h2 >> 42 ;  h2 &= MASK42 ;
+    h0 += c * 5 ;   c = h0 >> 44 ;  h0 &= MASK44 ;
+    h1 += c ;       c = h1 >> 44 ;  h1 &= MASK44 ;
+    h2 += c ;       c = h2 >> 42 ;  h2 &= MASK42 ;
+    h0 += c * 5 ;   c = h0 >> 44 ;  h0 &= MASK44 ;
+    h1 += c ;
+    // g = h + 5 - 2^130
+    uint64_t    g0 = h0 + 5 ;   c = g0 >> 44 ;  g0 &= MASK44 ;
+    uint64_t    g1 = h1 + c ;   c = g1 >> 44 ;  g1 &= MASK44 ;
+    uint64_t    g2 = h2 + c - (1ull << 42) ;
+    // Selects h if g is negative (without branches)
+    c = (g2 >> 63) - 1 ;
+    g0 &= c ;
+    g1 &= c ;
+    g2 &= c ;
+    c = ~c ;
+    h0 = (h0 & c) | g0 ;
+    h1 = (h1 & c) | g1 ;
+    h2 = (h2 & c) | g2 ;
+    // h + pad (mod 2^128)
+    const uint64_t  t0 = pad_ [0] ;
+    const uint64_t  t1 = pad_ [1] ;
+    h0 += t0 & MASK44 ;                                 c = h0 >> 44 ;  h0 &= MASK44 ;
+    h1 += (((t0 >> 44) | (t1 << 20)) & MASK44) + c ;    c = h1 >> 44 ;  h1 &= MASK44 ;
+    h2 += ((t1 >> 24) & MASK42) + c ;                   h2 &= MASK42 ;
+
+    auto    out = static_cast<uint8_t *> (tag) ;
+    Core::StoreLE64 (&out [0], h0 | (h1 << 44)) ;
+    Core::StoreLE64 (&out [8], (h1 >> 20) | (h2 << 24)) ;
+    h_ [0] = h_ [1] = h_ [2] = 0 ;
+}
+
+void    Salsa20::ComputePoly1305 (void *tag, const void *message, size_t length, const void *key) {
+    Poly1305    mac { key } ;
+    mac.Update (message, length) ;
+    mac.Finish (tag) ;
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+constexpr size_t    Salsa20::SecretBox::KEY_SIZE ;
+constexpr size_t    Salsa20::SecretBox::NONCE_SIZE ;
+constexpr size_t    Salsa20::SecretBox::MAC_SIZE ;
+
+Salsa20::SecretBox::SecretBox (const void *key) {
+    ::memcpy (key_.data (), key, key_.size ()) ;
+}
+
+Salsa20::SecretBox::~SecretBox () {
+    SecureZero (key_.data (), key_.size ()) ;
+}
+
+void    Salsa20::SecretBox::Seal (void *box, const void *message, size_t length, const void *nonce) const {
+    auto    dst = static_cast<uint8_t *> (box) + MAC_SIZE ;
+    auto    src = static_cast<const uint8_t *> (message) ;
+
+    XState  state { key_.data (), key_.size (), nonce } ;
+    hash_value_t    first ;
+    GenerateKeystream (state, first.data (), 1) ;
+    Poly1305    mac { first.data () } ;
+    // The rest of the first block
+    const size_t    head = std::min (length, first.size () - Poly1305::KEY_SIZE) ;
+    for (size_t i = 0 ; i < head ; ++i) {
+        dst [i] = src [i] ^ first [Poly1305::KEY_SIZE + i] ;
+    }
+    mac.Update (dst, head) ;
+    SecureZero (first.data (), first.size ()) ;
+    for (size_t offset = head ; offset < length ; offset += CHUNK_SIZE) {
+        const size_t    n = std::min (CHUNK_SIZE, length - offset) ;
+        Apply (state, &dst [offset], &src [offset], n) ;
+        mac.Update (&dst [offset], n) ;
+    }
+    mac.Finish (box) ;
+}
+
+bool    Salsa20::SecretBox::Open (void *message, const void *box, size_t box_size, const void *nonce) const {
+    if (box_size < MAC_SIZE) {
+        return false ;
+    }
+    const size_t    length = box_size - MAC_SIZE ;
+    auto    dst = static_cast<uint8_t *> (message) ;
+    auto    src = static_cast<const uint8_t *> (box) + MAC_SIZE ;
+    // `src` may be overwritten below
+    std::array<uint8_t, MAC_SIZE>   expected ;
+    ::memcpy (expected.data (), box, expected.size ()) ;
+
+    XState  state { key_.data (), key_.size (), nonce } ;
+    hash_value_t    first ;
+    GenerateKeystream (state, first.data (), 1) ;
+    Poly1305    mac { first.data () } ;
+    const size_t    head = std::min (length, first.size () - Poly1305::KEY_SIZE) ;
+    mac.Update (src, head) ;
+    for (size_t i = 0 ; i < head ; ++i) {
+        dst [i] = src [i] ^ first [Poly1305::KEY_SIZE + i] ;
+    }
+    SecureZero (first.data (), first.size ()) ;
+    for (size_t offset = head ; offset < length ; offset += CHUNK_SIZE) {
+        const size_t    n = std::min (CHUNK_SIZE, length - offset) ;
+        mac.Update (&src [offset], n) ;
+        Apply (state, &dst [offset], &src [offset], n) ;
+    }
+    std::array<uint8_t, MAC_SIZE>   actual ;
+    mac.Finish (actual.data ()) ;
+    if (! EqualTags (actual.data (), expected.data ())) {
+        // Never leaks the unauthenticated plain text
+        SecureZero (dst, length) ;
+        return false ;
+    }
+    return true ;
+}
+
+/*
+ * [END OF FILE]
+ */
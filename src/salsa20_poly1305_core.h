@@ -0,0 +1,198 @@
+/*
+ * salsa20_poly1305_core.h: Poly1305 arithmetic shared by the kernels (internal)
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_poly1305_core_h__7c3e95b1_0d4f_4a62_8e17_b5f2a9c04d63
+#define salsa20_poly1305_core_h__7c3e95b1_0d4f_4a62_8e17_b5f2a9c04d63 1
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * The accumulator and the key are held in 3 limbs of 44, 44 and 42 bits
+ * (i.e. h = h[0] + h[1] * 2^44 + h[2] * 2^88), so the products of the
+ * limbs fit in 128 bits with room for the lazy reduction.
+ *
+ * Everything lives in the unnamed namespace because each kernel translation
+ * unit is compiled with its own target flags, and the linker should not pick
+ * the copy compiled for the wider instruction set.
+ */
+namespace Salsa20 { namespace Poly1305Core { namespace {
+
+    const uint64_t  MASK44 = 0xFFFFFFFFFFFull ;
+    const uint64_t  MASK42 = 0x3FFFFFFFFFFull ;
+    const uint64_t  MASK26 = 0x3FFFFFFull ;
+
+    /// The 2^128 bit of the full block (in the top limb)
+    const uint64_t  HIBIT = 1ull << 40 ;
+
+#if defined (__SIZEOF_INT128__)
+    using uint128_t = unsigned __int128 ;
+
+    inline uint128_t    Mul (uint64_t a, uint64_t b) {
+        return static_cast<uint128_t> (a) * b ;
+    }
+
+    inline uint128_t    Add (uint128_t a, uint128_t b) {
+        return a + b ;
+    }
+
+    inline uint128_t    Add (uint128_t a, uint64_t b) {
+        return a + b ;
+    }
+
+    inline uint64_t     Low (uint128_t a) {
+        return static_cast<uint64_t> (a) ;
+    }
+    /// Shifts right by 0 < n < 64 (the result should fit in 64 bits)
+    inline uint64_t     Shr (uint128_t a, int n) {
+        return static_cast<uint64_t> (a >> n) ;
+    }
+#else
+    struct uint128_t {
+        uint64_t    lo ;
+        uint64_t    hi ;
+    } ;
+
+    inline uint128_t    Mul (uint64_t a, uint64_t b) {
+        const uint64_t  a0 = a & 0xFFFFFFFFu ;
+        const uint64_t  a1 = a >> 32 ;
+        const uint64_t  b0 = b & 0xFFFFFFFFu ;
+        const uint64_t  b1 = b >> 32 ;
+        const uint64_t  p00 = a0 * b0 ;
+        const uint64_t  p01 = a0 * b1 ;
+        const uint64_t  p10 = a1 * b0 ;
+        const uint64_t  p11 = a1 * b1 ;
+        const uint64_t  mid = (p00 >> 32) + (p01 & 0xFFFFFFFFu) + (p10 & 0xFFFFFFFFu) ;
+        return uint128_t { (p00 & 0xFFFFFFFFu) | (mid << 32), p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32) } ;
+    }
+
+    inline uint128_t    Add (uint128_t a, uint128_t b) {
+        const uint64_t  lo = a.lo + b.lo ;
+        return uint128_t { lo, a.hi + b.hi + (lo < a.lo ? 1 : 0) } ;
+    }
+
+    inline uint128_t    Add (uint128_t a, uint64_t b) {
+        const uint64_t  lo = a.lo + b ;
+        return uint128_t { lo, a.hi + (lo < a.lo ? 1 : 0) } ;
+    }
+
+    inline uint64_t     Low (uint128_t a) {
+        return a.lo ;
+    }
+
+    inline uint64_t     Shr (uint128_t a, int n) {
+        return (a.lo >> n) | (a.hi << (64 - n)) ;
+    }
+#endif
+
+    inline uint64_t     LoadLE64 (const uint8_t *p) {
+        uint64_t    result = 0 ;
+        for (int i = 7 ; 0 <= i ; --i) {
+            result = (result << 8) | p [i] ;
+        }
+        return result ;
+    }
+
+    inline void     StoreLE64 (uint8_t *p, uint64_t v) {
+        for (int i = 0 ; i < 8 ; ++i) {
+            p [i] = static_cast<uint8_t> (v >> (8 * i)) ;
+        }
+    }
+
+    /**
+     * Splits the 128bit little-endian value into the limbs.
+     */
+    inline void     Split (uint64_t *out, uint64_t t0, uint64_t t1) {
+        out [0] = t0 & MASK44 ;
+        out [1] = ((t0 >> 44) | (t1 << 20)) & MASK44 ;
+        out [2] = (t1 >> 24) & MASK42 ;
+    }
+
+    /**
+     * Computes h = h * r (partially reduced modulo 2^130 - 5).
+     */
+    inline void     MultiplyMod (uint64_t *h, const uint64_t *r) {
+        const uint64_t  s1 = r [1] * (5 << 2) ;
+        const uint64_t  s2 = r [2] * (5 << 2) ;
+
+        uint128_t   d0 = Add (Add (Mul (h [0], r [0]), Mul (h [1], s2)), Mul (h [2], s1)) ;
+        uint128_t   d1 = Add (Add (Mul (h [0], r [1]), Mul (h [1], r [0])), Mul (h [2], s2)) ;
+        uint128_t   d2 = Add (Add (Mul (h [0], r [2]), Mul (h [1], r [1])), Mul (h [2], r [0])) ;
+
+        uint64_t    c = Shr (d0, 44) ;
+        h [0] = Low (d0) & MASK44 ;
+        d1 = Add (d1, c) ;
+        c = Shr (d1, 44) ;
+        h [1] = Low (d1) & MASK44 ;
+        d2 = Add (d2, c) ;
+        c = Shr (d2, 42) ;
+        h [2] = Low (d2) & MASK42 ;
+        h [0] += c * 5 ;
+        c = h [0] >> 44 ;
+        h [0] &= MASK44 ;
+        h [1] += c ;
+    }
+
+    /**
+     * Absorbs the 16 byte blocks.
+     *
+     * @param h The accumulator
+     * @param r The clamped key
+     * @param message `count` * 16 bytes
+     * @param count # of blocks
+     * @param hibit HIBIT for the full blocks, 0 for the padded final block
+     */
+    inline void     Blocks (uint64_t *h, const uint64_t *r, const uint8_t *message, size_t count, uint64_t hibit) {
+        for (size_t i = 0 ; i < count ; ++i, message += 16) {
+            uint64_t    m [3] ;
+            Split (m, LoadLE64 (&message [0]), LoadLE64 (&message [8])) ;
+            h [0] += m [0] ;
+            h [1] += m [1] ;
+            h [2] += m [2] | hibit ;
+            MultiplyMod (h, r) ;
+        }
+    }
+
+    /**
+     * Converts the limbs into 5 limbs of 26 bits.
+     */
+    inline void     ToLimbs26 (uint32_t *out, const uint64_t *h) {
+        // Makes the bit fields disjoint
+        uint64_t    h0 = h [0] & MASK44 ;
+        uint64_t    h1 = h [1] + (h [0] >> 44) ;
+        uint64_t    h2 = h [2] + (h1 >> 44) ;
+        h1 &= MASK44 ;
+        out [0] = static_cast<uint32_t> (h0 & MASK26) ;
+        out [1] = static_cast<uint32_t> (((h0 >> 26) | (h1 << 18)) & MASK26) ;
+        out [2] = static_cast<uint32_t> ((h1 >> 8) & MASK26) ;
+        out [3] = static_cast<uint32_t> (((h1 >> 34) | (h2 << 10)) & MASK26) ;
+        out [4] = static_cast<uint32_t> (h2 >> 16) ;
+    }
+
+    /**
+     * Converts 5 limbs of 26 bits (with some excess) back.
+     */
+    inline void     FromLimbs26 (uint64_t *h, const uint64_t *l) {
+        h [0] = l [0] + ((l [1] & 0x3FFFFu) << 26) ;
+        h [1] = (l [1] >> 18) + (l [2] << 8) + ((l [3] & 0x3FFu) << 34) ;
+        h [2] = (l [3] >> 10) + (l [4] << 16) ;
+        uint64_t    c = h [0] >> 44 ;
+        h [0] &= MASK44 ;
+        h [1] += c ;
+        c = h [1] >> 44 ;
+        h [1] &= MASK44 ;
+        h [2] += c ;
+        c = h [2] >> 42 ;
+        h [2] &= MASK42 ;
+        h [0] += c * 5 ;
+    }
+} } } /* end of [namespace Salsa20::Poly1305Core::(unnamed)] */
+
+#endif  /* salsa20_poly1305_core_h__7c3e95b1_0d4f_4a62_8e17_b5f2a9c04d63 */
+/*
+ * [END OF FILE]
+ */
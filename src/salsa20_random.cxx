@@ -0,0 +1,177 @@
+/*
+ * salsa20_random.cxx: Cryptographically secure random bytes
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include "salsa20.h"
+#include "salsa20_random.h"
+#include "salsa20_secure.h"
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#if defined (_WIN32)
+#   include <windows.h>
+#   include <bcrypt.h>
+#else
+#   include <fcntl.h>
+#   include <pthread.h>
+#   include <unistd.h>
+#   if defined (HAVE_GETRANDOM)
+#       include <sys/random.h>
+#   endif
+#endif
+
+namespace {
+    const size_t    KEY_SIZE = 32 ;
+    const size_t    BUFFER_SIZE = 4096 ;
+
+    using Salsa20::SecureZero ;
+
+    /**
+     * Reads the seed from the OS.
+     */
+    void    GetEntropy (void *output, size_t length) {
+        auto    p = static_cast<uint8_t *> (output) ;
+#if defined (_WIN32)
+        if (! BCRYPT_SUCCESS (BCryptGenRandom (nullptr, p, static_cast<ULONG> (length), BCRYPT_USE_SYSTEM_PREFERRED_RNG))) {
+            throw std::system_error { std::make_error_code (std::errc::io_error), "BCryptGenRandom" } ;
+        }
+#elif defined (HAVE_GETRANDOM)
+        while (0 < length) {
+            ssize_t n = ::getrandom (p, length, 0) ;
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue ;
+                }
+                throw std::system_error { errno, std::generic_category (), "getrandom" } ;
+            }
+            p += n ;
+            length -= static_cast<size_t> (n) ;
+        }
+#else
+        int fd = ::open ("/dev/urandom", O_RDONLY) ;
+        if (fd < 0) {
+            throw std::system_error { errno, std::generic_category (), "/dev/urandom" } ;
+        }
+        while (0 < length) {
+            ssize_t n = ::read (fd, p, length) ;
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue ;
+                }
+                int err = (n < 0) ? errno : EIO ;
+                ::close (fd) ;
+                throw std::system_error { err, std::generic_category (), "/dev/urandom" } ;
+            }
+            p += n ;
+            length -= static_cast<size_t> (n) ;
+        }
+        ::close (fd) ;
+#endif
+    }
+
+    /// Incremented in the child process after fork
+    std::atomic<uint64_t>   forkGeneration_ { 0 } ;
+
+    void    RegisterForkHandler () {
+#if ! defined (_WIN32)
+        static std::once_flag   once ;
+        std::call_once (once, []() {
+            ::pthread_atfork (nullptr, nullptr, []() { ++forkGeneration_ ; }) ;
+        }) ;
+#endif
+    }
+
+    /// <summary>The per-thread generator.</summary>
+    class Generator {
+    private:
+        Salsa20::State  state_ ;
+        /// The key stream, first KEY_SIZE bytes are used as the next key
+        std::array<uint8_t, BUFFER_SIZE>    buffer_ ;
+        /// # of consumed bytes in buffer_
+        size_t      position_ = BUFFER_SIZE ;
+        bool        seeded_ = false ;
+        uint64_t    generation_ = 0 ;
+    public:
+        Generator () = default ;
+
+        ~Generator () {
+            SecureZero (buffer_.data (), buffer_.size ()) ;
+            // Both the state words and the precomputed round hold the key
+            SecureZero (&state_, sizeof (state_)) ;
+        }
+
+        void    Generate (uint8_t *output, size_t length) {
+            if (! seeded_ || generation_ != forkGeneration_.load ()) {
+                Seed () ;
+            }
+            if (BUFFER_SIZE <= length) {
+                // Straight into the output, the next key is taken from the head of the stream
+                std::array<uint8_t, std::tuple_size<Salsa20::hash_value_t>::value> key ;
+                Salsa20::GenerateKeystream (state_, key.data (), 1) ;
+                Salsa20::GenerateKeystreamBytes (state_, output, length) ;
+                Rekey (key.data ()) ;
+                SecureZero (key.data (), key.size ()) ;
+                return ;
+            }
+            while (0 < length) {
+                if (position_ == BUFFER_SIZE) {
+                    Refill () ;
+                }
+                size_t  n = std::min (length, BUFFER_SIZE - position_) ;
+                ::memcpy (output, &buffer_ [position_], n) ;
+                SecureZero (&buffer_ [position_], n) ;
+                position_ += n ;
+                output += n ;
+                length -= n ;
+            }
+        }
+    private:
+        void    Seed () {
+            RegisterForkHandler () ;
+            generation_ = forkGeneration_.load () ;
+
+            std::array<uint8_t, KEY_SIZE>   key ;
+            GetEntropy (key.data (), key.size ()) ;
+            Rekey (key.data ()) ;
+            SecureZero (key.data (), key.size ()) ;
+            // Drops the bytes inherited from the parent
+            SecureZero (buffer_.data (), buffer_.size ()) ;
+            position_ = BUFFER_SIZE ;
+            seeded_ = true ;
+        }
+
+        void    Rekey (const uint8_t *key) {
+            state_.SetKey (key, KEY_SIZE) ;
+            state_.SetInitialVector (0) ;
+        }
+
+        void    Refill () {
+            Salsa20::GenerateKeystream (state_, buffer_.data (), BUFFER_SIZE / std::tuple_size<Salsa20::hash_value_t>::value) ;
+            // Fast key erasure: the key producing this buffer is gone from now on
+            Rekey (buffer_.data ()) ;
+            SecureZero (buffer_.data (), KEY_SIZE) ;
+            position_ = KEY_SIZE ;
+        }
+    } ;
+}
+
+void    Salsa20::RandomBytes (void *output, size_t length) {
+    static thread_local Generator   generator ;
+    generator.Generate (static_cast<uint8_t *> (output), length) ;
+}
+
+/*
+ * [END OF FILE]
+ */
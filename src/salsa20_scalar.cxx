@@ -0,0 +1,295 @@
+/*
+ * salsa20_scalar.cxx: The portable salsa20 kernel.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <cstring>
+#include "salsa20_kernel.h"
+#include "salsa20_poly1305_core.h"
+
+static inline uint32_t  rot (uint32_t x, size_t n) {
+#if defined (_MSC_VER) && (1200 <= _MSC_VER)
+    return _rotl (x, n) ;
+#else
+    return(x << n) | (x >> (32 - n)) ;
+#endif
+}
+
+const int   STATE_SIZE = std::tuple_size<Salsa20::Kernel::input_t>::value ;
+
+/// # of the double rounds of Salsa20/20 and ChaCha20
+const int   NUM_ROUNDS = 10 ;
+
+static inline void  ColumnRound (uint32_t (&x) [STATE_SIZE]) {
+    x[ 4] ^= rot (x[ 0] + x[12],  7) ;
+    x[ 8] ^= rot (x[ 4] + x[ 0],  9) ;
+    x[12] ^= rot (x[ 8] + x[ 4], 13) ;
+    x[ 0] ^= rot (x[12] + x[ 8], 18) ;
+
+    x[ 9] ^= rot (x[ 5] + x[ 1],  7) ;
+    x[13] ^= rot (x[ 9] + x[ 5],  9) ;
+    x[ 1] ^= rot (x[13] + x[ 9], 13) ;
+    x[ 5] ^= rot (x[ 1] + x[13], 18) ;
+
+    x[14] ^= rot (x[10] + x[ 6],  7) ;
+    x[ 2] ^= rot (x[14] + x[10],  9) ;
+    x[ 6] ^= rot (x[ 2] + x[14], 13) ;
+    x[10] ^= rot (x[ 6] + x[ 2], 18) ;
+
+    x[ 3] ^= rot (x[15] + x[11],  7) ;
+    x[ 7] ^= rot (x[ 3] + x[15],  9) ;
+    x[11] ^= rot (x[ 7] + x[ 3], 13) ;
+    x[15] ^= rot (x[11] + x[ 7], 18) ;
+}
+
+static inline void  RowRound (uint32_t (&x) [STATE_SIZE]) {
+    x[ 1] ^= rot (x[ 0] + x[ 3],  7) ;
+    x[ 2] ^= rot (x[ 1] + x[ 0],  9) ;
+    x[ 3] ^= rot (x[ 2] + x[ 1], 13) ;
+    x[ 0] ^= rot (x[ 3] + x[ 2], 18) ;
+
+    x[ 6] ^= rot (x[ 5] + x[ 4],  7) ;
+    x[ 7] ^= rot (x[ 6] + x[ 5],  9) ;
+    x[ 4] ^= rot (x[ 7] + x[ 6], 13) ;
+    x[ 5] ^= rot (x[ 4] + x[ 7], 18) ;
+
+    x[11] ^= rot (x[10] + x[ 9],  7) ;
+    x[ 8] ^= rot (x[11] + x[10],  9) ;
+    x[ 9] ^= rot (x[ 8] + x[11], 13) ;
+    x[10] ^= rot (x[ 9] + x[ 8], 18) ;
+
+    x[12] ^= rot (x[15] + x[14],  7) ;
+    x[13] ^= rot (x[12] + x[15],  9) ;
+    x[14] ^= rot (x[13] + x[12], 13) ;
+    x[15] ^= rot (x[14] + x[13], 18) ;
+}
+
+/**
+ * Performs the salsa20 rounds (without the final addition).
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds (10 for Salsa20/20)
+ * @param x The state words to update
+ */
+template <int DOUBLE_ROUNDS>
+static void     Rounds (uint32_t (&x) [STATE_SIZE]) {
+    for (int i = 0 ; i < DOUBLE_ROUNDS ; ++i) {
+        ColumnRound (x) ;
+        RowRound (x) ;
+    }
+}
+
+/**
+ * Adds the input to the rounds output and stores it.
+ *
+ * @param x The rounds output
+ * @param input The state words
+ * @param dst The output
+ * @param src The input (nullptr stores the key stream itself)
+ */
+static inline void  Store (const uint32_t (&x) [STATE_SIZE], const Salsa20::Kernel::input_t &input, uint8_t *dst, const uint8_t *src) {
+    for (int i = 0 ; i < STATE_SIZE ; ++i) {
+        uint32_t        v = x [i] + input [i] ;
+
+        if (src != nullptr) {
+            v ^= (  (static_cast<uint32_t> (src [4 * i + 0]) <<  0)
+                  | (static_cast<uint32_t> (src [4 * i + 1]) <<  8)
+                  | (static_cast<uint32_t> (src [4 * i + 2]) << 16)
+                  | (static_cast<uint32_t> (src [4 * i + 3]) << 24)) ;
+        }
+        dst [4 * i + 0] = static_cast<unsigned char> (v >>  0) ;
+        dst [4 * i + 1] = static_cast<unsigned char> (v >>  8) ;
+        dst [4 * i + 2] = static_cast<unsigned char> (v >> 16) ;
+        dst [4 * i + 3] = static_cast<unsigned char> (v >> 24) ;
+    }
+}
+
+/**
+ * Applies the key stream of a block.
+ *
+ * @param input The state words
+ * @param dst The output
+ * @param src The input (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlock (const Salsa20::Kernel::input_t &input, uint8_t *dst, const uint8_t *src) {
+    uint32_t    x [STATE_SIZE] ;
+
+    for (int i = 0 ; i < STATE_SIZE ; ++i) {
+        x [i] = input [i] ;
+    }
+    Rounds<DOUBLE_ROUNDS> (x) ;
+    Store (x, input, dst, src) ;
+}
+
+template <int DOUBLE_ROUNDS>
+static void     ComputeHashValue (const Salsa20::Kernel::input_t &input, uint8_t *output) {
+    ApplyBlock<DOUBLE_ROUNDS> (input, output, nullptr) ;
+}
+
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    for (size_t i = 0 ; i < count ; ++i) {
+        auto const  block = Salsa20::Kernel::WithSequenceNumber (input, seq + i) ;
+        uint32_t    x [STATE_SIZE] ;
+
+        for (int k = 0 ; k < STATE_SIZE ; ++k) {
+            x [k] = pre [k] ;
+        }
+        x [ 8]  = block [8] ;
+        x [ 9] ^= block [9] ;
+        // Finishes the first column round
+        x[ 8] ^= rot (x[ 4] + x[ 0],  9) ;
+        x[12] ^= rot (x[ 8] + x[ 4], 13) ;
+        x[ 0] ^= rot (x[12] + x[ 8], 18) ;
+
+        x[13] ^= rot (x[ 9] + x[ 5],  9) ;
+        x[ 1] ^= rot (x[13] + x[ 9], 13) ;
+        x[ 5] ^= rot (x[ 1] + x[13], 18) ;
+
+        RowRound (x) ;
+        for (int r = 1 ; r < DOUBLE_ROUNDS ; ++r) {
+            ColumnRound (x) ;
+            RowRound (x) ;
+        }
+        Store (x, block, dst, src) ;
+        dst += Salsa20::Kernel::BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, Salsa20::Kernel::BLOCK_SIZE) ;
+    }
+}
+
+static void     ApplyLanes1 (const Salsa20::Kernel::input_t *inputs, uint8_t *const *dst, const uint8_t *const *src) {
+    ApplyBlock<NUM_ROUNDS> (inputs [0], dst [0], src [0]) ;
+}
+
+static void     ComputeHSalsa20 (const Salsa20::Kernel::input_t &input, uint32_t *output) {
+    uint32_t    x [STATE_SIZE] ;
+
+    for (int i = 0 ; i < STATE_SIZE ; ++i) {
+        x [i] = input [i] ;
+    }
+    Rounds<NUM_ROUNDS> (x) ;
+    for (int i = 0 ; i < 8 ; ++i) {
+        output [i] = x [Salsa20::Kernel::HSALSA20_OUTPUT [i]] ;
+    }
+}
+
+static inline void  ChaChaQuarterRound (uint32_t &a, uint32_t &b, uint32_t &c, uint32_t &d) {
+    a += b ; d = rot (d ^ a, 16) ;
+    c += d ; b = rot (b ^ c, 12) ;
+    a += b ; d = rot (d ^ a,  8) ;
+    c += d ; b = rot (b ^ c,  7) ;
+}
+
+static void     ChaCha20Blocks (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    for (size_t i = 0 ; i < count ; ++i) {
+        auto const  block = Salsa20::Kernel::WithChaCha20Counter (input, seq + i) ;
+        uint32_t    x [STATE_SIZE] ;
+
+        for (int k = 0 ; k < STATE_SIZE ; ++k) {
+            x [k] = block [k] ;
+        }
+        for (int r = 0 ; r < NUM_ROUNDS ; ++r) {
+            // Columns
+            ChaChaQuarterRound (x [ 0], x [ 4], x [ 8], x [12]) ;
+            ChaChaQuarterRound (x [ 1], x [ 5], x [ 9], x [13]) ;
+            ChaChaQuarterRound (x [ 2], x [ 6], x [10], x [14]) ;
+            ChaChaQuarterRound (x [ 3], x [ 7], x [11], x [15]) ;
+            // Diagonals
+            ChaChaQuarterRound (x [ 0], x [ 5], x [10], x [15]) ;
+            ChaChaQuarterRound (x [ 1], x [ 6], x [11], x [12]) ;
+            ChaChaQuarterRound (x [ 2], x [ 7], x [ 8], x [13]) ;
+            ChaChaQuarterRound (x [ 3], x [ 4], x [ 9], x [14]) ;
+        }
+        Store (x, block, dst, src) ;
+        dst += Salsa20::Kernel::BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, Salsa20::Kernel::BLOCK_SIZE) ;
+    }
+}
+
+static inline uint32_t  LoadWord (const uint8_t *p) {
+    return (  (static_cast<uint32_t> (p [0]) <<  0)
+            | (static_cast<uint32_t> (p [1]) <<  8)
+            | (static_cast<uint32_t> (p [2]) << 16)
+            | (static_cast<uint32_t> (p [3]) << 24)) ;
+}
+
+static void     ToFloat (void *buffer, size_t count) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    for (size_t i = 0 ; i < count ; ++i, p += 4) {
+        float   v = static_cast<float> (LoadWord (p) >> 8) * (1.0f / 16777216.0f) ;
+        ::memcpy (p, &v, sizeof (v)) ;
+    }
+}
+
+static void     ToDouble (void *buffer, size_t count) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    for (size_t i = 0 ; i < count ; ++i, p += 8) {
+        uint64_t    w = (static_cast<uint64_t> (LoadWord (p + 4)) << 32) | LoadWord (p) ;
+        // [1, 2) with 52 random bits
+        uint64_t    bits = 0x3FF0000000000000ull | (w >> 12) ;
+        double      v ;
+        ::memcpy (&v, &bits, sizeof (v)) ;
+        v -= 1.0 ;
+        ::memcpy (p, &v, sizeof (v)) ;
+    }
+}
+
+static size_t   ToBounded (void *buffer, size_t count, uint32_t bound, uint32_t threshold) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    for (size_t i = 0 ; i < count ; ++i, p += 4) {
+        uint64_t    m = static_cast<uint64_t> (LoadWord (p)) * bound ;
+        if (static_cast<uint32_t> (m) < threshold) {
+            return i ;
+        }
+        uint32_t    v = static_cast<uint32_t> (m >> 32) ;
+        ::memcpy (p, &v, sizeof (v)) ;
+    }
+    return count ;
+}
+
+static void     Poly1305Blocks (uint64_t *h, const uint64_t *r, const uint8_t *message, size_t count) {
+    Salsa20::Poly1305Core::Blocks (h, r, message, count, Salsa20::Poly1305Core::HIBIT) ;
+}
+
+static void     ScryptBlockMix (uint32_t *output, const uint32_t *x, const uint32_t *v, size_t r) {
+    using Salsa20::Kernel::SCRYPT_ORDER ;
+    const size_t    count = 2 * r ;
+    uint32_t        t [STATE_SIZE] ;
+    uint32_t        b [STATE_SIZE] ;
+
+    auto    last = x + STATE_SIZE * (count - 1) ;
+    for (int k = 0 ; k < STATE_SIZE ; ++k) {
+        t [SCRYPT_ORDER [k]] = last [k] ^ ((v != nullptr) ? v [STATE_SIZE * (count - 1) + k] : 0) ;
+    }
+    for (size_t i = 0 ; i < count ; ++i) {
+        auto    src = x + STATE_SIZE * i ;
+        for (int k = 0 ; k < STATE_SIZE ; ++k) {
+            t [SCRYPT_ORDER [k]] ^= src [k] ^ ((v != nullptr) ? v [STATE_SIZE * i + k] : 0) ;
+        }
+        for (int k = 0 ; k < STATE_SIZE ; ++k) {
+            b [k] = t [k] ;
+        }
+        Rounds<4> (t) ;
+        for (int k = 0 ; k < STATE_SIZE ; ++k) {
+            t [k] += b [k] ;
+        }
+        auto    dst = output + STATE_SIZE * ((i / 2) + (i & 1) * r) ;
+        for (int k = 0 ; k < STATE_SIZE ; ++k) {
+            dst [k] = t [SCRYPT_ORDER [k]] ;
+        }
+    }
+}
+
+const Salsa20::Kernel::Entry    Salsa20::Kernel::Scalar { "scalar"
+                                                        , ComputeHashValue<NUM_ROUNDS>, ApplyBlocks<NUM_ROUNDS>
+                                                        , 1, ApplyLanes1
+                                                        , ComputeHSalsa20, ToFloat, ToDouble, ToBounded, Poly1305Blocks, ChaCha20Blocks
+                                                        , { ComputeHashValue<4>, ApplyBlocks<4> }
+                                                        , { ComputeHashValue<6>, ApplyBlocks<6> }
+                                                        , ScryptBlockMix } ;
+
+/*
+ * [END OF FILE]
+ */
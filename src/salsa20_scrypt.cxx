@@ -0,0 +1,439 @@
+/*
+ * salsa20_scrypt.cxx: The scrypt password based key derivation function (RFC 7914)
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "salsa20_scrypt.h"
+#include "salsa20_parallel.h"
+#include "salsa20_kernel.h"
+#include "salsa20_secure.h"
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#if defined (__unix__) || defined (__APPLE__)
+#   include <sys/mman.h>
+#   define USE_MMAP    1
+#endif
+
+namespace {
+
+    using Salsa20::SecureZero ;
+
+    uint32_t    LoadBE32 (const uint8_t *p) {
+        return (  (static_cast<uint32_t> (p [0]) << 24)
+                | (static_cast<uint32_t> (p [1]) << 16)
+                | (static_cast<uint32_t> (p [2]) <<  8)
+                | (static_cast<uint32_t> (p [3]) <<  0)) ;
+    }
+
+    void    StoreBE32 (uint8_t *p, uint32_t v) {
+        p [0] = static_cast<uint8_t> (v >> 24) ;
+        p [1] = static_cast<uint8_t> (v >> 16) ;
+        p [2] = static_cast<uint8_t> (v >>  8) ;
+        p [3] = static_cast<uint8_t> (v >>  0) ;
+    }
+
+    uint32_t    LoadLE32 (const uint8_t *p) {
+        return (  (static_cast<uint32_t> (p [0]) <<  0)
+                | (static_cast<uint32_t> (p [1]) <<  8)
+                | (static_cast<uint32_t> (p [2]) << 16)
+                | (static_cast<uint32_t> (p [3]) << 24)) ;
+    }
+
+    void    StoreLE32 (uint8_t *p, uint32_t v) {
+        p [0] = static_cast<uint8_t> (v >>  0) ;
+        p [1] = static_cast<uint8_t> (v >>  8) ;
+        p [2] = static_cast<uint8_t> (v >> 16) ;
+        p [3] = static_cast<uint8_t> (v >> 24) ;
+    }
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+    /// <summary>SHA-256 (FIPS 180-4), only for the PBKDF2 steps around ROMix.</summary>
+    class Sha256 {
+    public:
+        static constexpr size_t BLOCK_SIZE = 64 ;
+        static constexpr size_t DIGEST_SIZE = 32 ;
+    private:
+        uint32_t    h_ [8] ;
+        uint8_t     buffer_ [BLOCK_SIZE] ;
+        size_t      buffered_ ;
+        uint64_t    length_ ;
+    public:
+        Sha256 () : h_ { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A
+                       , 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 }
+                  , buffered_ (0)
+                  , length_ (0) {
+            /* NO-OP */
+        }
+
+        ~Sha256 () {
+            SecureZero (h_, sizeof (h_)) ;
+            SecureZero (buffer_, sizeof (buffer_)) ;
+        }
+
+        void    Update (const void *message, size_t length) {
+            auto    p = static_cast<const uint8_t *> (message) ;
+            length_ += length ;
+            if (0 < buffered_) {
+                size_t  n = std::min (length, BLOCK_SIZE - buffered_) ;
+                ::memcpy (&buffer_ [buffered_], p, n) ;
+                buffered_ += n ;
+                p += n ;
+                length -= n ;
+                if (buffered_ < BLOCK_SIZE) {
+                    return ;
+                }
+                Compress (buffer_) ;
+                buffered_ = 0 ;
+            }
+            for ( ; BLOCK_SIZE <= length ; p += BLOCK_SIZE, length -= BLOCK_SIZE) {
+                Compress (p) ;
+            }
+            ::memcpy (buffer_, p, length) ;
+            buffered_ = length ;
+        }
+
+        void    Finish (uint8_t *digest) {
+            const uint64_t  bits = length_ * 8 ;
+            uint8_t         pad [BLOCK_SIZE + 8] = { 0x80 } ;
+            size_t          n = ((buffered_ < 56) ? 56 : 120) - buffered_ ;
+            for (int i = 0 ; i < 8 ; ++i) {
+                pad [n + i] = static_cast<uint8_t> (bits >> (56 - 8 * i)) ;
+            }
+            Update (pad, n + 8) ;
+            for (int i = 0 ; i < 8 ; ++i) {
+                StoreBE32 (&digest [4 * i], h_ [i]) ;
+            }
+        }
+    private:
+        static uint32_t ror (uint32_t x, int n) {
+            return (x >> n) | (x << (32 - n)) ;
+        }
+
+        void    Compress (const uint8_t *block) {
+            static const uint32_t   K [64] = {
+                0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+                0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+                0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+                0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+                0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+                0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+                0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+                0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2 } ;
+            uint32_t    w [64] ;
+
+            for (int i = 0 ; i < 16 ; ++i) {
+                w [i] = LoadBE32 (&block [4 * i]) ;
+            }
+            for (int i = 16 ; i < 64 ; ++i) {
+                uint32_t    s0 = ror (w [i - 15],  7) ^ ror (w [i - 15], 18) ^ (w [i - 15] >>  3) ;
+                uint32_t    s1 = ror (w [i -  2], 17) ^ ror (w [i -  2], 19) ^ (w [i -  2] >> 10) ;
+                w [i] = w [i - 16] + s0 + w [i - 7] + s1 ;
+            }
+            uint32_t    a = h_ [0], b = h_ [1], c = h_ [2], d = h_ [3] ;
+            uint32_t    e = h_ [4], f = h_ [5], g = h_ [6], h = h_ [7] ;
+            for (int i = 0 ; i < 64 ; ++i) {
+                uint32_t    t1 = h + (ror (e, 6) ^ ror (e, 11) ^ ror (e, 25)) + ((e & f) ^ (~e & g)) + K [i] + w [i] ;
+                uint32_t    t2 = (ror (a, 2) ^ ror (a, 13) ^ ror (a, 22)) + ((a & b) ^ (a & c) ^ (b & c)) ;
+                h = g ; g = f ; f = e ; e = d + t1 ;
+                d = c ; c = b ; b = a ; a = t1 + t2 ;
+            }
+            h_ [0] += a ; h_ [1] += b ; h_ [2] += c ; h_ [3] += d ;
+            h_ [4] += e ; h_ [5] += f ; h_ [6] += g ; h_ [7] += h ;
+            SecureZero (w, sizeof (w)) ;
+        }
+    } ;
+
+    constexpr size_t    Sha256::BLOCK_SIZE ;
+    constexpr size_t    Sha256::DIGEST_SIZE ;
+
+    /**
+     * Derives the key with PBKDF2-HMAC-SHA256 with a single iteration (all scrypt needs).
+     *
+     * @param output Receives the derived key
+     * @param output_size The derived key length
+     * @param password The HMAC key
+     * @param password_size The HMAC key length
+     * @param salt The salt
+     * @param salt_size The salt length
+     */
+    void    Pbkdf2Sha256 (uint8_t *output, size_t output_size, const void *password, size_t password_size, const void *salt, size_t salt_size) {
+        uint8_t key [Sha256::BLOCK_SIZE] = { 0 } ;
+        if (Sha256::BLOCK_SIZE < password_size) {
+            Sha256  sha ;
+            sha.Update (password, password_size) ;
+            sha.Finish (key) ;
+        }
+        else if (0 < password_size) {
+            ::memcpy (key, password, password_size) ;
+        }
+        uint8_t ipad [Sha256::BLOCK_SIZE] ;
+        uint8_t opad [Sha256::BLOCK_SIZE] ;
+        for (size_t i = 0 ; i < Sha256::BLOCK_SIZE ; ++i) {
+            ipad [i] = key [i] ^ 0x36 ;
+            opad [i] = key [i] ^ 0x5C ;
+        }
+        // The keyed inner state absorbing the salt is shared by all the output blocks
+        Sha256  inner ;
+        inner.Update (ipad, sizeof (ipad)) ;
+        inner.Update (salt, salt_size) ;
+
+        uint8_t digest [Sha256::DIGEST_SIZE] ;
+        for (uint32_t index = 1 ; 0 < output_size ; ++index) {
+            uint8_t be [4] ;
+            StoreBE32 (be, index) ;
+
+            Sha256  ih { inner } ;
+            ih.Update (be, sizeof (be)) ;
+            ih.Finish (digest) ;
+
+            Sha256  oh ;
+            oh.Update (opad, sizeof (opad)) ;
+            oh.Update (digest, sizeof (digest)) ;
+            oh.Finish (digest) ;
+
+            size_t  n = std::min (output_size, sizeof (digest)) ;
+            ::memcpy (output, digest, n) ;
+            output += n ;
+            output_size -= n ;
+        }
+        SecureZero (key, sizeof (key)) ;
+        SecureZero (ipad, sizeof (ipad)) ;
+        SecureZero (opad, sizeof (opad)) ;
+        SecureZero (digest, sizeof (digest)) ;
+    }
+
+    /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+    /// # of words in a Salsa20 block
+    const size_t    BLOCK_WORDS = 16 ;
+
+    /**
+     * <summary>The working memory of a lane (V, X and Y of ROMix).</summary>
+     *
+     * On POSIX systems the memory is mapped directly and aligned to the
+     * huge page boundary, so the transparent huge pages can back it and
+     * the random accesses to V do not thrash the TLB.
+     */
+    class ScratchBuffer {
+    private:
+#if defined (USE_MMAP)
+        static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024 ;
+        void *      mapped_ ;
+        size_t      mapped_size_ ;
+#else
+        std::unique_ptr<uint32_t []>    storage_ ;
+#endif
+        uint32_t *  words_ ;
+        size_t      size_ ;
+    public:
+        ScratchBuffer (size_t num_words, bool use_huge_pages) : size_ (num_words * sizeof (uint32_t)) {
+#if defined (USE_MMAP)
+            const size_t    align = use_huge_pages ? HUGE_PAGE_SIZE : 0 ;
+            mapped_size_ = size_ + align ;
+            mapped_ = ::mmap (nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+            if (mapped_ == MAP_FAILED) {
+                throw std::bad_alloc {} ;
+            }
+            auto    addr = reinterpret_cast<uintptr_t> (mapped_) ;
+            if (0 < align) {
+                addr = (addr + align - 1) & ~static_cast<uintptr_t> (align - 1) ;
+#   if defined (MADV_HUGEPAGE)
+                // Only a hint, the small pages still work
+                ::madvise (reinterpret_cast<void *> (addr), size_, MADV_HUGEPAGE) ;
+#   endif
+            }
+            words_ = reinterpret_cast<uint32_t *> (addr) ;
+#else
+            (void)use_huge_pages ;
+            storage_.reset (new uint32_t [num_words]) ;
+            words_ = storage_.get () ;
+#endif
+        }
+
+        ScratchBuffer (const ScratchBuffer &) = delete ;
+
+        ScratchBuffer & operator = (const ScratchBuffer &) = delete ;
+
+        ~ScratchBuffer () {
+#if defined (USE_MMAP)
+            // The kernel zero-fills the pages before handing them out again
+            ::munmap (mapped_, mapped_size_) ;
+#else
+            SecureZero (words_, size_) ;
+#endif
+        }
+
+        uint32_t *  data () {
+            return words_ ;
+        }
+    } ;
+
+    using BlockMix = decltype (Salsa20::Kernel::Entry::scryptBlockMix) ;
+
+    /**
+     * Retrieves the BlockMix of `kernel` (the SSE2 one when the kernel has none of its own).
+     */
+    BlockMix    GetBlockMix (const Salsa20::Kernel::Entry &kernel) {
+#if defined (HAVE_SSE2)
+        if (kernel.scryptBlockMix == nullptr) {
+            return Salsa20::Kernel::SSE2.scryptBlockMix ;
+        }
+#endif
+        return kernel.scryptBlockMix ;
+    }
+
+    /**
+     * Performs ROMix on a lane in place.
+     *
+     * @param block_mix The BlockMix of the kernel to use
+     * @param b The lane (128 * `r` bytes)
+     * @param scratch The working memory (`N` + 2 lanes of the words)
+     * @param N The CPU/memory cost
+     * @param r The block size
+     *
+     * @remarks The blocks are converted into the kernel layout once,
+     *          so BlockMix runs on V without any shuffles.
+     */
+    void    ROMix (BlockMix block_mix, uint8_t *b, uint32_t *scratch, uint64_t N, size_t r) {
+        using Salsa20::Kernel::SCRYPT_ORDER ;
+        const size_t    lane_words = 2 * r * BLOCK_WORDS ;
+        uint32_t *      v = scratch ;
+        uint32_t *      x = scratch + N * lane_words ;
+        uint32_t *      y = x + lane_words ;
+
+        for (size_t i = 0 ; i < lane_words ; i += BLOCK_WORDS) {
+            for (size_t k = 0 ; k < BLOCK_WORDS ; ++k) {
+                v [i + k] = LoadLE32 (&b [4 * (i + SCRYPT_ORDER [k])]) ;
+            }
+        }
+        for (uint64_t i = 0 ; i < N - 1 ; ++i) {
+            block_mix (v + (i + 1) * lane_words, v + i * lane_words, nullptr, r) ;
+        }
+        block_mix (x, v + (N - 1) * lane_words, nullptr, r) ;
+
+        // Integerify takes the words 0 and 1 of the last block (the positions 0 and 12)
+        const size_t    last = lane_words - BLOCK_WORDS ;
+        for (uint64_t i = 0 ; i < N ; ++i) {
+            const uint64_t  j = ((static_cast<uint64_t> (x [last + 12]) << 32) | x [last + 0]) & (N - 1) ;
+            block_mix (y, x, v + j * lane_words, r) ;
+            std::swap (x, y) ;
+        }
+        for (size_t i = 0 ; i < lane_words ; i += BLOCK_WORDS) {
+            for (size_t k = 0 ; k < BLOCK_WORDS ; ++k) {
+                StoreLE32 (&b [4 * (i + SCRYPT_ORDER [k])], x [i + k]) ;
+            }
+        }
+    }
+
+    /**
+     * Runs ROMix on the lanes with `num_workers` workers.
+     *
+     * Each worker owns a scratch buffer and claims the lanes one by one,
+     * so the memory in use is bounded by the # of workers, not by `p`.
+     */
+    void    RunLanes (Salsa20::Executor *executor, size_t num_workers, uint8_t *lanes, uint32_t p, uint64_t N, size_t r, const Salsa20::ScryptOptions &options) {
+        auto const      block_mix = GetBlockMix (Salsa20::Kernel::Active ()) ;
+        const size_t    lane_size = 128 * r ;
+        const size_t    scratch_words = static_cast<size_t> (N + 2) * 2 * r * BLOCK_WORDS ;
+
+        std::atomic<uint32_t>   next { 0 } ;
+        std::mutex              mutex ;
+        std::exception_ptr      error ;
+
+        auto    worker = [&](size_t) {
+            try {
+                ScratchBuffer   scratch { scratch_words, options.use_huge_pages } ;
+                for (uint32_t lane ; (lane = next.fetch_add (1)) < p ; ) {
+                    ROMix (block_mix, lanes + lane * lane_size, scratch.data (), N, r) ;
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock { mutex } ;
+                if (! error) {
+                    error = std::current_exception () ;
+                }
+                // Stops the others
+                next.store (p) ;
+            }
+        } ;
+        if (executor == nullptr || num_workers <= 1) {
+            worker (0) ;
+        }
+        else {
+            executor->ParallelFor (num_workers, worker) ;
+        }
+        if (error) {
+            std::rethrow_exception (error) ;
+        }
+    }
+}
+
+void    Salsa20::Scrypt ( void *output, size_t output_size
+                        , const void *password, size_t password_size
+                        , const void *salt, size_t salt_size
+                        , uint64_t N, uint32_t r, uint32_t p
+                        , const ScryptOptions &options) {
+    if (N < 2 || (N & (N - 1)) != 0) {
+        throw std::invalid_argument { "Scrypt: N should be a power of 2 greater than 1" } ;
+    }
+    if (r == 0 || p == 0 || (1u << 30) <= static_cast<uint64_t> (r) * p) {
+        throw std::invalid_argument { "Scrypt: r * p should be in [1, 2^30)" } ;
+    }
+    // N < 2^(128 * r / 8)
+    if (16 * static_cast<uint64_t> (r) < 64 && (N >> (16 * r)) != 0) {
+        throw std::invalid_argument { "Scrypt: N is too large for r" } ;
+    }
+    if (output_size == 0 || static_cast<uint64_t> (0xFFFFFFFFu) * Sha256::DIGEST_SIZE < output_size) {
+        throw std::invalid_argument { "Scrypt: Invalid output size" } ;
+    }
+    const size_t    lane_size = 128 * static_cast<size_t> (r) ;
+    const size_t    max_size = std::numeric_limits<size_t>::max () ;
+    if (max_size / lane_size < p || max_size / lane_size < N + 2) {
+        throw std::invalid_argument { "Scrypt: N, r or p is too large" } ;
+    }
+    std::vector<uint8_t>    lanes (lane_size * p) ;
+    Pbkdf2Sha256 (lanes.data (), lanes.size (), password, password_size, salt, salt_size) ;
+
+    if (options.executor != nullptr) {
+        const size_t    num_workers = std::min<size_t> (p, options.executor->GetThreadCount () + 1) ;
+        RunLanes (options.executor, num_workers, lanes.data (), p, N, r, options) ;
+    }
+    else {
+        size_t  num_workers = options.num_threads ;
+        if (num_workers == 0) {
+            num_workers = std::max<size_t> (1, std::thread::hardware_concurrency ()) ;
+        }
+        num_workers = std::min<size_t> (num_workers, p) ;
+        if (num_workers <= 1) {
+            RunLanes (nullptr, 1, lanes.data (), p, N, r, options) ;
+        }
+        else {
+            // The calling thread runs a worker too
+            Executor    executor { num_workers - 1 } ;
+            RunLanes (&executor, num_workers, lanes.data (), p, N, r, options) ;
+        }
+    }
+    Pbkdf2Sha256 (static_cast<uint8_t *> (output), output_size, password, password_size, lanes.data (), lanes.size ()) ;
+    SecureZero (lanes.data (), lanes.size ()) ;
+}
+
+/*
+ * [END OF FILE]
+ */
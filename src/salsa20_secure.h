@@ -0,0 +1,39 @@
+/*
+ * salsa20_secure.h: Wiping the secrets (internal)
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+#pragma once
+#ifndef salsa20_secure_h__3b8d0f62_a4c7_4e19_9f5a_c17e2d84b6f0
+#define salsa20_secure_h__3b8d0f62_a4c7_4e19_9f5a_c17e2d84b6f0 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Salsa20 {
+    /**
+     * Fills the memory with 0 in the way the compiler does not elide.
+     *
+     * @param p The start of the memory
+     * @param length # of bytes to fill
+     */
+    inline void SecureZero (void *p, size_t length) {
+#if defined (__GNUC__)
+        ::memset (p, 0, length) ;
+        // Makes the stores observable, so they are not removed as dead
+        __asm__ __volatile__ ("" : : "r" (p) : "memory") ;
+#else
+        volatile uint8_t *  q = static_cast<volatile uint8_t *> (p) ;
+        while (0 < length--) {
+            *q++ = 0 ;
+        }
+#endif
+    }
+} /* end of [namespace Salsa20] */
+
+#endif  /* salsa20_secure_h__3b8d0f62_a4c7_4e19_9f5a_c17e2d84b6f0 */
+/*
+ * [END OF FILE]
+ */
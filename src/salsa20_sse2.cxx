@@ -0,0 +1,541 @@
+/*
+ * salsa20_sse2.cxx: The SSE2 salsa20 kernel.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include "salsa20_kernel.h"
+#include <emmintrin.h>
+
+static inline __m128i   vrot (__m128i v, int cnt) {
+    __m128i t0 = _mm_slli_epi32 (v, cnt) ;
+    __m128i t1 = _mm_srli_epi32 (v, 32 - cnt) ;
+    return _mm_or_si128 (t0, t1) ;
+}
+
+/**
+ * Stores the key stream (XORed with the source if supplied).
+ */
+static inline void  Store (uint8_t *dst, const uint8_t *src, size_t offset, __m128i v) {
+    if (src != nullptr) {
+        v = _mm_xor_si128 (v, _mm_loadu_si128 ((const __m128i *)&src [offset])) ;
+    }
+    _mm_storeu_si128 ((__m128i *)&dst [offset], v) ;
+}
+
+#define SWAP_(a_, b_)   do {        \
+        __m128i     t_ = (a_) ;     \
+        (a_) = (b_) ;               \
+        (b_) = t_ ;                 \
+    } while (false)
+
+#define TRANSPOSE_(V0_, V1_, V2_, V3_) do {                 \
+        __m128i t0_ = _mm_unpacklo_epi32 ((V0_), (V1_)) ;   \
+        __m128i t1_ = _mm_unpacklo_epi32 ((V2_), (V3_)) ;   \
+        __m128i t2_ = _mm_unpackhi_epi32 ((V0_), (V1_)) ;   \
+        __m128i t3_ = _mm_unpackhi_epi32 ((V2_), (V3_)) ;   \
+        (V0_) = _mm_unpacklo_epi64 (t0_, t1_) ;             \
+        (V1_) = _mm_unpackhi_epi64 (t0_, t1_) ;             \
+        (V2_) = _mm_unpacklo_epi64 (t2_, t3_) ;             \
+        (V3_) = _mm_unpackhi_epi64 (t2_, t3_) ;             \
+    } while (false)
+
+/**
+ * Performs a double round on the state held in the row layout.
+ *
+ * The row layout keeps (0 5 10 15), (3 4 9 14), (2 7 8 13) and (1 6 11 12)
+ * in v0...v3, which is the layout both before and after the double round.
+ */
+static inline void  DoubleRound (__m128i &v0, __m128i &v1, __m128i &v2, __m128i &v3) {
+    // 15 10  5  0
+    // 14  9  4  3
+    // 13  8  7  2
+    // 12 11  6  1
+    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (0, 3, 2, 1)) ;
+    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
+    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (2, 1, 0, 3)) ;
+    // 15 10  5  0
+    //  3 14  9  4
+    //  7  2 13  8
+    // 11  6  1 12
+    v1 = _mm_xor_si128 (v1, vrot (_mm_add_epi32 (v0, v3),  7)) ;
+    v2 = _mm_xor_si128 (v2, vrot (_mm_add_epi32 (v1, v0),  9)) ;
+    v3 = _mm_xor_si128 (v3, vrot (_mm_add_epi32 (v2, v1), 13)) ;
+    v0 = _mm_xor_si128 (v0, vrot (_mm_add_epi32 (v3, v2), 18)) ;
+
+    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (2, 1, 0, 3)) ;
+    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
+    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (0, 3, 2, 1)) ;
+    // 15 10  5  0
+    // 14  9  4  3
+    // 13  8  7  2
+    // 12 11  6  1
+    v3 = _mm_xor_si128 (v3, vrot (_mm_add_epi32 (v0, v1),  7)) ;
+    v2 = _mm_xor_si128 (v2, vrot (_mm_add_epi32 (v3, v0),  9)) ;
+    v1 = _mm_xor_si128 (v1, vrot (_mm_add_epi32 (v2, v3), 13)) ;
+    v0 = _mm_xor_si128 (v0, vrot (_mm_add_epi32 (v1, v2), 18)) ;
+}
+
+/**
+ * Performs the salsa20 rounds (without the final addition).
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds (10 for Salsa20/20)
+ * @param v0 The state words 0...3 (updated)
+ * @param v1 The state words 4...7 (updated)
+ * @param v2 The state words 8...11 (updated)
+ * @param v3 The state words 12...15 (updated)
+ */
+template <int DOUBLE_ROUNDS>
+static inline void  Rounds (__m128i &v0, __m128i &v1, __m128i &v2, __m128i &v3) {
+    //  3  2  1  0
+    //  7  6  5  4
+    // 11 10  9  8
+    // 15 14 13 12
+    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (0, 3, 2, 1)) ;
+    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (1, 0, 3, 2)) ;
+    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (2, 1, 0, 3)) ;
+    //  3  2  1  0
+    //  4  7  6  5
+    //  9  8 11 10
+    // 14 13 12 15
+    TRANSPOSE_(v0, v1, v2, v3) ;
+    // 15 10  5  0
+    // 12 11  6  1
+    // 13  8  7  2
+    // 14  9  4  3
+    SWAP_(v1, v3) ;
+    for (int i = 0 ; i < DOUBLE_ROUNDS ; ++i) {
+        DoubleRound (v0, v1, v2, v3) ;
+    }
+    TRANSPOSE_ (v0, v1, v2, v3) ;
+    //  1  2  3  0
+    //  6  7  4  5
+    // 11  8  9 10
+    // 12 13 14 15
+    v0 = _mm_shuffle_epi32 (v0, _MM_SHUFFLE (1, 2, 3, 0)) ;
+    v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (2, 3, 0, 1)) ;
+    v2 = _mm_shuffle_epi32 (v2, _MM_SHUFFLE (3, 0, 1, 2)) ;
+    v3 = _mm_shuffle_epi32 (v3, _MM_SHUFFLE (0, 1, 2, 3)) ;
+    //  3  2  1  0
+    //  7  6  5  4
+    // 11 10  9  8
+    // 15 14 13 12
+}
+
+/**
+ * Applies the key stream of a block.
+ *
+ * @param input The state words
+ * @param dst The output
+ * @param src The input (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlock (const Salsa20::Kernel::input_t &input, uint8_t *dst, const uint8_t *src) {
+    __m128i     v0orig = _mm_loadu_si128 ((const __m128i *)&input [ 0]) ;
+    __m128i     v1orig = _mm_loadu_si128 ((const __m128i *)&input [ 4]) ;
+    __m128i     v2orig = _mm_loadu_si128 ((const __m128i *)&input [ 8]) ;
+    __m128i     v3orig = _mm_loadu_si128 ((const __m128i *)&input [12]) ;
+
+    __m128i     v0 = v0orig ;
+    __m128i     v1 = v1orig ;
+    __m128i     v2 = v2orig ;
+    __m128i     v3 = v3orig ;
+
+    Rounds<DOUBLE_ROUNDS> (v0, v1, v2, v3) ;
+
+    v0 = _mm_add_epi32 (v0, v0orig) ;
+    v1 = _mm_add_epi32 (v1, v1orig) ;
+    v2 = _mm_add_epi32 (v2, v2orig) ;
+    v3 = _mm_add_epi32 (v3, v3orig) ;
+
+    Store (dst, src,  0, v0) ;
+    Store (dst, src, 16, v1) ;
+    Store (dst, src, 32, v2) ;
+    Store (dst, src, 48, v3) ;
+}
+
+template <int DOUBLE_ROUNDS>
+static void     ComputeHashValue (const Salsa20::Kernel::input_t &input, uint8_t *output) {
+    ApplyBlock<DOUBLE_ROUNDS> (input, output, nullptr) ;
+}
+
+static void     ComputeHSalsa20 (const Salsa20::Kernel::input_t &input, uint32_t *output) {
+    __m128i     v0 = _mm_loadu_si128 ((const __m128i *)&input [ 0]) ;
+    __m128i     v1 = _mm_loadu_si128 ((const __m128i *)&input [ 4]) ;
+    __m128i     v2 = _mm_loadu_si128 ((const __m128i *)&input [ 8]) ;
+    __m128i     v3 = _mm_loadu_si128 ((const __m128i *)&input [12]) ;
+
+    Rounds<10> (v0, v1, v2, v3) ;
+
+    // (0 5 10 15) and (6 7 8 9)
+    __m128i t0 = _mm_unpacklo_epi32 (v0, _mm_srli_si128 (v1, 4)) ;     // 0 5 1 6
+    __m128i t1 = _mm_unpackhi_epi32 (v2, _mm_srli_si128 (v3, 4)) ;     // 10 15 11 x
+    _mm_storeu_si128 ((__m128i *)&output [0], _mm_unpacklo_epi64 (t0, t1)) ;
+    _mm_storeu_si128 ((__m128i *)&output [4], _mm_unpacklo_epi64 (_mm_unpackhi_epi64 (v1, v1), v2)) ;
+}
+
+/**
+ * Adds the input words and stores the key stream of each lane.
+ *
+ * @param x The state words after the rounds (lane n holds the n-th block)
+ * @param orig The input words
+ * @param dst The output of each block
+ * @param src The input of each block (nullptr stores the key stream itself)
+ */
+static inline void  StoreLanes (const __m128i (&x) [16], const __m128i (&orig) [16], uint8_t *const *dst, const uint8_t *const *src) {
+    for (int i = 0 ; i < 16 ; i += 4) {
+        __m128i v0 = _mm_add_epi32 (x [i + 0], orig [i + 0]) ;
+        __m128i v1 = _mm_add_epi32 (x [i + 1], orig [i + 1]) ;
+        __m128i v2 = _mm_add_epi32 (x [i + 2], orig [i + 2]) ;
+        __m128i v3 = _mm_add_epi32 (x [i + 3], orig [i + 3]) ;
+        // Lane n of v0...v3 holds the words i...i+3 of the n-th block
+        TRANSPOSE_ (v0, v1, v2, v3) ;
+        Store (dst [0], src [0], 4 * i, v0) ;
+        Store (dst [1], src [1], 4 * i, v1) ;
+        Store (dst [2], src [2], 4 * i, v2) ;
+        Store (dst [3], src [3], 4 * i, v3) ;
+    }
+}
+
+/**
+ * Splits the sequence numbers of 4 consecutive blocks into the lower and the upper words.
+ */
+static inline void  SequenceLanes (uint64_t seq, __m128i &lo, __m128i &hi) {
+    lo = _mm_set_epi32 ( static_cast<int32_t> (seq + 3), static_cast<int32_t> (seq + 2)
+                       , static_cast<int32_t> (seq + 1), static_cast<int32_t> (seq + 0)) ;
+    hi = _mm_set_epi32 ( static_cast<int32_t> ((seq + 3) >> 32), static_cast<int32_t> ((seq + 2) >> 32)
+                       , static_cast<int32_t> ((seq + 1) >> 32), static_cast<int32_t> ((seq + 0) >> 32)) ;
+}
+
+#define QUARTERROUND4_(a_, b_, c_, d_)  do {                                        \
+        x [b_] = _mm_xor_si128 (x [b_], vrot (_mm_add_epi32 (x [a_], x [d_]),  7)) ; \
+        x [c_] = _mm_xor_si128 (x [c_], vrot (_mm_add_epi32 (x [b_], x [a_]),  9)) ; \
+        x [d_] = _mm_xor_si128 (x [d_], vrot (_mm_add_epi32 (x [c_], x [b_]), 13)) ; \
+        x [a_] = _mm_xor_si128 (x [a_], vrot (_mm_add_epi32 (x [d_], x [c_]), 18)) ; \
+    } while (false)
+
+// The last 3 steps of QUARTERROUND4_
+#define FINISHQUARTERROUND4_(a_, b_, c_, d_)  do {                                   \
+        x [c_] = _mm_xor_si128 (x [c_], vrot (_mm_add_epi32 (x [b_], x [a_]),  9)) ; \
+        x [d_] = _mm_xor_si128 (x [d_], vrot (_mm_add_epi32 (x [c_], x [b_]), 13)) ; \
+        x [a_] = _mm_xor_si128 (x [a_], vrot (_mm_add_epi32 (x [d_], x [c_]), 18)) ; \
+    } while (false)
+
+/**
+ * Applies the key stream of 4 blocks at once.
+ *
+ * Each __m128i holds the same state word of 4 blocks (lane n holds the
+ * n-th block), so the rounds need no shuffles at all.
+ *
+ * @tparam DOUBLE_ROUNDS # of the double rounds (10 for Salsa20/20)
+ * @param orig The state words of 4 blocks
+ * @param pre The counter independent part of the first round of every block (nullptr performs the first round in full)
+ * @param dst The output of each block
+ * @param src The input of each block (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyLanes (const __m128i (&orig) [16], const __m128i *pre, uint8_t *const *dst, const uint8_t *const *src) {
+
+    __m128i     x [16] ;
+    if (pre != nullptr) {
+        for (int i = 0 ; i < 16 ; ++i) {
+            x [i] = pre [i] ;
+        }
+        x [8] = orig [8] ;
+        x [9] = _mm_xor_si128 (x [9], orig [9]) ;
+        FINISHQUARTERROUND4_ ( 0,  4,  8, 12) ;
+        FINISHQUARTERROUND4_ ( 5,  9, 13,  1) ;
+    }
+    else {
+        for (int i = 0 ; i < 16 ; ++i) {
+            x [i] = orig [i] ;
+        }
+        QUARTERROUND4_ ( 0,  4,  8, 12) ;
+        QUARTERROUND4_ ( 5,  9, 13,  1) ;
+        QUARTERROUND4_ (10, 14,  2,  6) ;
+        QUARTERROUND4_ (15,  3,  7, 11) ;
+    }
+    QUARTERROUND4_ ( 0,  1,  2,  3) ;
+    QUARTERROUND4_ ( 5,  6,  7,  4) ;
+    QUARTERROUND4_ (10, 11,  8,  9) ;
+    QUARTERROUND4_ (15, 12, 13, 14) ;
+
+    for (int i = 1 ; i < DOUBLE_ROUNDS ; ++i) {
+        QUARTERROUND4_ ( 0,  4,  8, 12) ;
+        QUARTERROUND4_ ( 5,  9, 13,  1) ;
+        QUARTERROUND4_ (10, 14,  2,  6) ;
+        QUARTERROUND4_ (15,  3,  7, 11) ;
+
+        QUARTERROUND4_ ( 0,  1,  2,  3) ;
+        QUARTERROUND4_ ( 5,  6,  7,  4) ;
+        QUARTERROUND4_ (10, 11,  8,  9) ;
+        QUARTERROUND4_ (15, 12, 13, 14) ;
+    }
+    StoreLanes (x, orig, dst, src) ;
+}
+
+/**
+ * Applies the key stream of 4 consecutive blocks at once.
+ *
+ * @param input The state words
+ * @param pre The counter independent part of the first round
+ * @param seq The sequence number of the first block
+ * @param dst The output (256 bytes)
+ * @param src The input (nullptr stores the key stream itself)
+ */
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks4 (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    __m128i     orig [16] ;
+    __m128i     p [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        orig [i] = _mm_set1_epi32 (static_cast<int32_t> (input [i])) ;
+        p [i] = _mm_set1_epi32 (static_cast<int32_t> (pre [i])) ;
+    }
+    SequenceLanes (seq, orig [8], orig [9]) ;
+
+    uint8_t * const         d [4] = { dst, dst + BLOCK_SIZE, dst + 2 * BLOCK_SIZE, dst + 3 * BLOCK_SIZE } ;
+    const uint8_t * const   s [4] = { src
+                                    , Salsa20::Kernel::Advance (src, 1 * BLOCK_SIZE)
+                                    , Salsa20::Kernel::Advance (src, 2 * BLOCK_SIZE)
+                                    , Salsa20::Kernel::Advance (src, 3 * BLOCK_SIZE) } ;
+    ApplyLanes<DOUBLE_ROUNDS> (orig, p, d, s) ;
+}
+
+/**
+ * Applies one block of the key stream for each of 4 independent states.
+ */
+static void     ApplyLanes4 (const Salsa20::Kernel::input_t *inputs, uint8_t *const *dst, const uint8_t *const *src) {
+    __m128i     orig [16] ;
+    for (int i = 0 ; i < 16 ; i += 4) {
+        __m128i v0 = _mm_loadu_si128 ((const __m128i *)&inputs [0][i]) ;
+        __m128i v1 = _mm_loadu_si128 ((const __m128i *)&inputs [1][i]) ;
+        __m128i v2 = _mm_loadu_si128 ((const __m128i *)&inputs [2][i]) ;
+        __m128i v3 = _mm_loadu_si128 ((const __m128i *)&inputs [3][i]) ;
+        // v0...v3 = the words i...i+3 of each state
+        TRANSPOSE_ (v0, v1, v2, v3) ;
+        orig [i + 0] = v0 ;
+        orig [i + 1] = v1 ;
+        orig [i + 2] = v2 ;
+        orig [i + 3] = v3 ;
+    }
+    ApplyLanes<10> (orig, nullptr, dst, src) ;
+}
+
+#undef FINISHQUARTERROUND4_
+#undef QUARTERROUND4_
+
+template <int DOUBLE_ROUNDS>
+static void     ApplyBlocks (const Salsa20::Kernel::input_t &input, const Salsa20::Kernel::input_t &pre, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    for ( ; 4 <= count ; count -= 4) {
+        ApplyBlocks4<DOUBLE_ROUNDS> (input, pre, seq, dst, src) ;
+        seq += 4 ;
+        dst += 4 * BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, 4 * BLOCK_SIZE) ;
+    }
+    for ( ; 0 < count ; --count) {
+        ApplyBlock<DOUBLE_ROUNDS> (Salsa20::Kernel::WithSequenceNumber (input, seq), dst, src) ;
+        seq += 1 ;
+        dst += BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, BLOCK_SIZE) ;
+    }
+}
+
+static inline __m128i   vrot16 (__m128i v) {
+    return _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, _MM_SHUFFLE (2, 3, 0, 1)), _MM_SHUFFLE (2, 3, 0, 1)) ;
+}
+
+#define CHACHA_QUARTERROUND4_(a_, b_, c_, d_)  do {                                       \
+        x [a_] = _mm_add_epi32 (x [a_], x [b_]) ; x [d_] = vrot16 (_mm_xor_si128 (x [d_], x [a_])) ;     \
+        x [c_] = _mm_add_epi32 (x [c_], x [d_]) ; x [b_] = vrot (_mm_xor_si128 (x [b_], x [c_]), 12) ;   \
+        x [a_] = _mm_add_epi32 (x [a_], x [b_]) ; x [d_] = vrot (_mm_xor_si128 (x [d_], x [a_]),  8) ;   \
+        x [c_] = _mm_add_epi32 (x [c_], x [d_]) ; x [b_] = vrot (_mm_xor_si128 (x [b_], x [c_]),  7) ;   \
+    } while (false)
+
+/**
+ * Applies the ChaCha20 key stream of 4 consecutive blocks at once.
+ *
+ * @param input The state words
+ * @param seq The counter of the first block
+ * @param dst The output (256 bytes)
+ * @param src The input (nullptr stores the key stream itself)
+ */
+static void     ChaCha20Blocks4 (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+    const int       NUM_ROUNDS = 10 ;
+
+    __m128i     orig [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        orig [i] = _mm_set1_epi32 (static_cast<int32_t> (input [i])) ;
+    }
+    SequenceLanes (seq, orig [12], orig [13]) ;
+
+    __m128i     x [16] ;
+    for (int i = 0 ; i < 16 ; ++i) {
+        x [i] = orig [i] ;
+    }
+    for (int i = 0 ; i < NUM_ROUNDS ; ++i) {
+        CHACHA_QUARTERROUND4_ ( 0,  4,  8, 12) ;
+        CHACHA_QUARTERROUND4_ ( 1,  5,  9, 13) ;
+        CHACHA_QUARTERROUND4_ ( 2,  6, 10, 14) ;
+        CHACHA_QUARTERROUND4_ ( 3,  7, 11, 15) ;
+
+        CHACHA_QUARTERROUND4_ ( 0,  5, 10, 15) ;
+        CHACHA_QUARTERROUND4_ ( 1,  6, 11, 12) ;
+        CHACHA_QUARTERROUND4_ ( 2,  7,  8, 13) ;
+        CHACHA_QUARTERROUND4_ ( 3,  4,  9, 14) ;
+    }
+    uint8_t * const         d [4] = { dst, dst + BLOCK_SIZE, dst + 2 * BLOCK_SIZE, dst + 3 * BLOCK_SIZE } ;
+    const uint8_t * const   s [4] = { src
+                                    , Salsa20::Kernel::Advance (src, 1 * BLOCK_SIZE)
+                                    , Salsa20::Kernel::Advance (src, 2 * BLOCK_SIZE)
+                                    , Salsa20::Kernel::Advance (src, 3 * BLOCK_SIZE) } ;
+    StoreLanes (x, orig, d, s) ;
+}
+
+#undef CHACHA_QUARTERROUND4_
+
+static void     ChaCha20Blocks (const Salsa20::Kernel::input_t &input, uint64_t seq, uint8_t *dst, const uint8_t *src, size_t count) {
+    const size_t    BLOCK_SIZE = Salsa20::Kernel::BLOCK_SIZE ;
+
+    for ( ; 4 <= count ; count -= 4) {
+        ChaCha20Blocks4 (input, seq, dst, src) ;
+        seq += 4 ;
+        dst += 4 * BLOCK_SIZE ;
+        src = Salsa20::Kernel::Advance (src, 4 * BLOCK_SIZE) ;
+    }
+    Salsa20::Kernel::Scalar.chaCha20Blocks (input, seq, dst, src, count) ;
+}
+
+static void     ToFloat (void *buffer, size_t count) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    const __m128    scale = _mm_set1_ps (1.0f / 16777216.0f) ;
+
+    for ( ; 4 <= count ; count -= 4, p += 16) {
+        __m128i w = _mm_loadu_si128 ((const __m128i *)p) ;
+        _mm_storeu_ps ((float *)p, _mm_mul_ps (_mm_cvtepi32_ps (_mm_srli_epi32 (w, 8)), scale)) ;
+    }
+    Salsa20::Kernel::Scalar.toFloat (p, count) ;
+}
+
+static void     ToDouble (void *buffer, size_t count) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    const __m128i   exponent = _mm_set1_epi64x (0x3FF0000000000000ll) ;
+    const __m128d   one = _mm_set1_pd (1.0) ;
+
+    for ( ; 2 <= count ; count -= 2, p += 16) {
+        __m128i w = _mm_loadu_si128 ((const __m128i *)p) ;
+        // [1, 2) with 52 random bits
+        __m128i bits = _mm_or_si128 (_mm_srli_epi64 (w, 12), exponent) ;
+        _mm_storeu_pd ((double *)p, _mm_sub_pd (_mm_castsi128_pd (bits), one)) ;
+    }
+    Salsa20::Kernel::Scalar.toDouble (p, count) ;
+}
+
+static size_t   ToBounded (void *buffer, size_t count, uint32_t bound, uint32_t threshold) {
+    auto    p = static_cast<uint8_t *> (buffer) ;
+    const __m128i   b = _mm_set1_epi32 (static_cast<int32_t> (bound)) ;
+    // For the unsigned comparison
+    const __m128i   bias = _mm_set1_epi32 (static_cast<int32_t> (0x80000000u)) ;
+    const __m128i   t = _mm_set1_epi32 (static_cast<int32_t> (threshold ^ 0x80000000u)) ;
+    const __m128i   lo_mask = _mm_set1_epi64x (0x00000000FFFFFFFFll) ;
+    const __m128i   hi_mask = _mm_set1_epi64x (static_cast<int64_t> (0xFFFFFFFF00000000ull)) ;
+
+    size_t  i = 0 ;
+    for ( ; i + 4 <= count ; i += 4, p += 16) {
+        __m128i w = _mm_loadu_si128 ((const __m128i *)p) ;
+        __m128i m02 = _mm_mul_epu32 (w, b) ;
+        __m128i m13 = _mm_mul_epu32 (_mm_srli_epi64 (w, 32), b) ;
+        __m128i lo = _mm_or_si128 (_mm_and_si128 (m02, lo_mask), _mm_slli_epi64 (m13, 32)) ;
+        __m128i hi = _mm_or_si128 (_mm_srli_epi64 (m02, 32), _mm_and_si128 (m13, hi_mask)) ;
+        if (_mm_movemask_epi8 (_mm_cmplt_epi32 (_mm_xor_si128 (lo, bias), t)) != 0) {
+            return i + Salsa20::Kernel::Scalar.toBounded (p, 4, bound, threshold) ;
+        }
+        _mm_storeu_si128 ((__m128i *)p, hi) ;
+    }
+    return i + Salsa20::Kernel::Scalar.toBounded (p, count - i, bound, threshold) ;
+}
+
+static void     Poly1305Blocks (uint64_t *h, const uint64_t *r, const uint8_t *message, size_t count) {
+    // The 64bit limbs beat the 2 lanes of 32x32 bits multiplication
+    Salsa20::Kernel::Scalar.poly1305Blocks (h, r, message, count) ;
+}
+
+/**
+ * Performs the scrypt BlockMix keeping the running block in the row layout.
+ *
+ * @tparam WITH_V true to XOR `v` into the input blocks
+ */
+template <bool WITH_V>
+static void     ScryptBlockMix (uint32_t *output, const uint32_t *x, const uint32_t *v, size_t r) {
+    const size_t    count = 2 * r ;
+    auto    px = reinterpret_cast<const __m128i *> (x) ;
+    auto    pv = reinterpret_cast<const __m128i *> (v) ;
+    auto    py = reinterpret_cast<__m128i *> (output) ;
+
+    const size_t    last = 4 * (count - 1) ;
+    __m128i x0 = _mm_loadu_si128 (px + last + 0) ;
+    __m128i x1 = _mm_loadu_si128 (px + last + 1) ;
+    __m128i x2 = _mm_loadu_si128 (px + last + 2) ;
+    __m128i x3 = _mm_loadu_si128 (px + last + 3) ;
+    if (WITH_V) {
+        x0 = _mm_xor_si128 (x0, _mm_loadu_si128 (pv + last + 0)) ;
+        x1 = _mm_xor_si128 (x1, _mm_loadu_si128 (pv + last + 1)) ;
+        x2 = _mm_xor_si128 (x2, _mm_loadu_si128 (pv + last + 2)) ;
+        x3 = _mm_xor_si128 (x3, _mm_loadu_si128 (pv + last + 3)) ;
+    }
+    for (size_t i = 0 ; i < count ; ++i) {
+        x0 = _mm_xor_si128 (x0, _mm_loadu_si128 (px + 4 * i + 0)) ;
+        x1 = _mm_xor_si128 (x1, _mm_loadu_si128 (px + 4 * i + 1)) ;
+        x2 = _mm_xor_si128 (x2, _mm_loadu_si128 (px + 4 * i + 2)) ;
+        x3 = _mm_xor_si128 (x3, _mm_loadu_si128 (px + 4 * i + 3)) ;
+        if (WITH_V) {
+            x0 = _mm_xor_si128 (x0, _mm_loadu_si128 (pv + 4 * i + 0)) ;
+            x1 = _mm_xor_si128 (x1, _mm_loadu_si128 (pv + 4 * i + 1)) ;
+            x2 = _mm_xor_si128 (x2, _mm_loadu_si128 (pv + 4 * i + 2)) ;
+            x3 = _mm_xor_si128 (x3, _mm_loadu_si128 (pv + 4 * i + 3)) ;
+        }
+        __m128i t0 = x0 ;
+        __m128i t1 = x1 ;
+        __m128i t2 = x2 ;
+        __m128i t3 = x3 ;
+        for (int k = 0 ; k < 4 ; ++k) {
+            DoubleRound (x0, x1, x2, x3) ;
+        }
+        x0 = _mm_add_epi32 (x0, t0) ;
+        x1 = _mm_add_epi32 (x1, t1) ;
+        x2 = _mm_add_epi32 (x2, t2) ;
+        x3 = _mm_add_epi32 (x3, t3) ;
+
+        auto    y = py + 4 * ((i / 2) + (i & 1) * r) ;
+        _mm_storeu_si128 (y + 0, x0) ;
+        _mm_storeu_si128 (y + 1, x1) ;
+        _mm_storeu_si128 (y + 2, x2) ;
+        _mm_storeu_si128 (y + 3, x3) ;
+    }
+}
+
+static void     ScryptBlockMix (uint32_t *output, const uint32_t *x, const uint32_t *v, size_t r) {
+    if (v != nullptr) {
+        ScryptBlockMix<true> (output, x, v, r) ;
+    }
+    else {
+        ScryptBlockMix<false> (output, x, v, r) ;
+    }
+}
+
+const Salsa20::Kernel::Entry    Salsa20::Kernel::SSE2 { "sse2"
+                                                      , ComputeHashValue<10>, ApplyBlocks<10>
+                                                      , 4, ApplyLanes4
+                                                      , ComputeHSalsa20, ToFloat, ToDouble, ToBounded, Poly1305Blocks, ChaCha20Blocks
+                                                      , { ComputeHashValue<4>, ApplyBlocks<4> }
+                                                      , { ComputeHashValue<6>, ApplyBlocks<6> }
+                                                      , ScryptBlockMix } ;
+
+/*
+ * [END OF FILE]
+ */
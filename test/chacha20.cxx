@@ -0,0 +1,215 @@
+/*
+ * chacha20.cxx: Checks ChaCha20 against the known vectors and every kernel against the portable one.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20_chacha20.h"
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+TEST_CASE ("ChaCha20 vectors", "[chacha20]") {
+    // RFC 8439 section 2.4.2
+    std::array<uint8_t, 32> key ;
+    for (size_t i = 0 ; i < key.size () ; ++i) {
+        key [i] = static_cast<uint8_t> (i) ;
+    }
+    const std::array<uint8_t, 12>   nonce { 0, 0, 0, 0, 0, 0, 0, 0x4a, 0, 0, 0, 0 } ;
+    const std::string   plaintext { "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it." } ;
+    const std::vector<uint8_t>  ciphertext { 0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80
+                                           , 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81
+                                           , 0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2
+                                           , 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b
+                                           , 0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab
+                                           , 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57
+                                           , 0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab
+                                           , 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8
+                                           , 0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61
+                                           , 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e
+                                           , 0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06
+                                           , 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36
+                                           , 0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6
+                                           , 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42
+                                           , 0x87, 0x4d } ;
+    // The all zero key and initial vector (256 and 128 bits keys)
+    const std::vector<uint8_t>  zero32 { 0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90
+                                       , 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28
+                                       , 0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a
+                                       , 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7
+                                       , 0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d
+                                       , 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37
+                                       , 0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c
+                                       , 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86 } ;
+    const std::vector<uint8_t>  zero16 { 0x89, 0x67, 0x09, 0x52, 0x60, 0x83, 0x64, 0xfd
+                                       , 0x00, 0xb2, 0xf9, 0x09, 0x36, 0xf0, 0x31, 0xc8
+                                       , 0xe7, 0x56, 0xe1, 0x5d, 0xba, 0x04, 0xb8, 0x49
+                                       , 0x3d, 0x00, 0x42, 0x92, 0x59, 0xb2, 0x0f, 0x46
+                                       , 0xcc, 0x04, 0xf1, 0x11, 0x24, 0x6b, 0x6c, 0x2c
+                                       , 0xe0, 0x66, 0xbe, 0x3b, 0xfb, 0x32, 0xd9, 0xaa
+                                       , 0x0f, 0xdd, 0xfb, 0xc1, 0x21, 0x23, 0xd4, 0xb9
+                                       , 0xe4, 0x4f, 0x34, 0xdc, 0xa0, 0x5a, 0x10, 0x3f } ;
+
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        {
+            Salsa20::ChaCha20::State    state { key.data (), key.size () } ;
+            state.SetNonce (nonce.data ()) ;
+            state.SetSequenceNumber (1) ;
+            std::vector<uint8_t>    actual (plaintext.size ()) ;
+            Salsa20::ChaCha20::Apply (state, actual.data (), plaintext.data (), plaintext.size ()) ;
+            REQUIRE (actual == ciphertext) ;
+            REQUIRE (state.GetSequenceNumber () == 3) ;
+
+            // The block 0 is the one used for the Poly1305 key
+            std::vector<uint8_t>    at (plaintext.begin (), plaintext.end ()) ;
+            Salsa20::ChaCha20::ApplyAt (state, at.data (), at.size (), 64) ;
+            REQUIRE (at == ciphertext) ;
+        }
+        {
+            const std::array<uint8_t, 32>   k {} ;
+            Salsa20::ChaCha20::State    state { k.data (), 32, 0 } ;
+            std::vector<uint8_t>    actual (64) ;
+            Salsa20::ChaCha20::GenerateKeystream (state, actual.data (), 1) ;
+            REQUIRE (actual == zero32) ;
+
+            Salsa20::ChaCha20::State    state16 { k.data (), 16, 0 } ;
+            Salsa20::ChaCha20::GenerateKeystream (state16, actual.data (), 1) ;
+            REQUIRE (actual == zero16) ;
+        }
+    }) ;
+}
+
+namespace {
+    std::vector<uint8_t>    Encrypt (const char *kernel, bool ietf, uint64_t seq, const std::vector<uint8_t> &message) {
+        const std::string   key_string { "The ChaCha family of stream ciphers" } ;
+        const std::array<uint8_t, 12>   nonce { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 } ;
+        Salsa20::ChaCha20::State    state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+        if (ietf) {
+            state.SetNonce (nonce.data ()) ;
+        }
+        state.SetSequenceNumber (seq) ;
+
+        REQUIRE (Salsa20::SelectKernel (kernel)) ;
+        std::vector<uint8_t>    result (message.size ()) ;
+        Salsa20::ChaCha20::Apply (state, result.data (), message.data (), message.size ()) ;
+        REQUIRE (state.GetSequenceNumber () == seq + (message.size () + 63) / 64) ;
+        return result ;
+    }
+}
+
+TEST_CASE ("ChaCha20 kernels", "[chacha20][kernel]") {
+    KernelGuard guard ;
+
+    std::vector<uint8_t>    message (64 * 45 + 17) ;
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 13 + 5) ;
+    }
+    for (bool ietf : { false, true }) {
+        INFO ("IETF: " << ietf) ;
+        // Crosses the 32bit boundary of the counter inside a SIMD pass (in the original layout)
+        const uint64_t  seq = ietf ? 0x12345u : 0xFFFFFFF9u ;
+        auto const  expected = Encrypt ("scalar", ietf, seq, message) ;
+
+        ForEachKernel ({ "sse2", "avx2", "avx512" }, [&](const char *name) {
+            INFO ("Kernel: " << name) ;
+            for (size_t length : { 0u, 1u, 64u, 255u, 256u, 511u, 512u, 1024u, 64u * 45u + 17u }) {
+                std::vector<uint8_t>    m (message.begin (), message.begin () + length) ;
+                auto const  actual = Encrypt (name, ietf, seq, m) ;
+                REQUIRE (::memcmp (actual.data (), expected.data (), length) == 0) ;
+            }
+        }) ;
+    }
+}
+
+TEST_CASE ("ChaCha20 counter limit", "[chacha20]") {
+    std::array<uint8_t, 32> key ;
+    for (size_t i = 0 ; i < key.size () ; ++i) {
+        key [i] = static_cast<uint8_t> (i) ;
+    }
+    const std::array<uint8_t, 12>   nonce { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 } ;
+    // The block at the counter 0xFFFFFFFF
+    const std::vector<uint8_t>  last { 0xc4, 0xe9, 0xbc, 0x95, 0x85, 0x5b, 0xfc, 0x7f
+                                     , 0x54, 0x56, 0xe7, 0x9b, 0x23, 0x56, 0x44, 0x22
+                                     , 0xa6, 0x62, 0xe1, 0x95, 0x20, 0x8f, 0xc8, 0xa7
+                                     , 0xd2, 0x4b, 0xd6, 0xc3, 0x5a, 0x36, 0x65, 0x73
+                                     , 0x68, 0x8f, 0xeb, 0xc5, 0x4e, 0xad, 0xe6, 0x8b
+                                     , 0xc3, 0xd3, 0xe3, 0x52, 0x9d, 0xce, 0xc5, 0x8a
+                                     , 0xc7, 0x34, 0x40, 0x10, 0x7f, 0xf9, 0x02, 0x1d
+                                     , 0xef, 0xca, 0x77, 0x1a, 0xd3, 0x82, 0x5c, 0x3d } ;
+    const uint64_t  LIMIT = 1ull << 32 ;
+
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        Salsa20::ChaCha20::State    state { key.data (), key.size () } ;
+        state.SetNonce (nonce.data ()) ;
+        state.SetSequenceNumber (LIMIT - 1) ;
+        {
+            auto const  hash = state.ComputeHashValue () ;
+            REQUIRE (std::vector<uint8_t> (hash.begin (), hash.end ()) == last) ;
+        }
+        {
+            // Spanning the last block and the one past it writes nothing
+            std::vector<uint8_t>    output (65, 0xAA) ;
+            std::vector<uint8_t>    input (65, 0) ;
+            REQUIRE_THROWS_AS (Salsa20::ChaCha20::Apply (state, output.data (), input.data (), input.size ()), std::overflow_error) ;
+            REQUIRE (output == std::vector<uint8_t> (65, 0xAA)) ;
+            REQUIRE (state.GetSequenceNumber () == LIMIT - 1) ;
+            REQUIRE_THROWS_AS (Salsa20::ChaCha20::ApplyAt (state, output.data (), input.data (), 65, 64 * (LIMIT - 1)), std::overflow_error) ;
+            REQUIRE_THROWS_AS (Salsa20::ChaCha20::ApplyAt (state, output.data (), 1, 64 * LIMIT), std::overflow_error) ;
+        }
+        {
+            std::vector<uint8_t>    actual (64) ;
+            Salsa20::ChaCha20::ApplyAt (state, actual.data (), actual.size (), 64 * (LIMIT - 1)) ;
+            REQUIRE (actual == last) ;
+        }
+        {
+            // The last block is usable, then the counter is used up
+            std::vector<uint8_t>    actual (64) ;
+            Salsa20::ChaCha20::GenerateKeystream (state, actual.data (), 1) ;
+            REQUIRE (actual == last) ;
+            REQUIRE (state.GetSequenceNumber () == LIMIT) ;
+            REQUIRE_THROWS_AS (Salsa20::ChaCha20::GenerateKeystream (state, actual.data (), 1), std::overflow_error) ;
+            REQUIRE_THROWS_AS (Salsa20::ChaCha20::Apply (state, actual.data (), 1), std::overflow_error) ;
+            REQUIRE_THROWS_AS (state.ComputeHashValue (), std::overflow_error) ;
+            REQUIRE_THROWS_AS (state.IncrementSequenceNumber (), std::out_of_range) ;
+            REQUIRE (state.GetSequenceNumber () == LIMIT) ;
+            // A new nonce starts over
+            state.SetNonce (nonce.data ()) ;
+            REQUIRE (state.GetSequenceNumber () == 0) ;
+        }
+    }) ;
+}
+
+TEST_CASE ("ChaCha20 with offset", "[chacha20]") {
+    const std::string   key_string { "0123456789abcdef0123456789abcdef" } ;
+    const Salsa20::ChaCha20::State  state { key_string.c_str (), key_string.size (), 0x0123456789ABCDEFull } ;
+
+    std::vector<uint8_t>    expected (64 * 20) ;
+    {
+        Salsa20::ChaCha20::State    tmp { state } ;
+        Salsa20::ChaCha20::GenerateKeystream (tmp, expected.data (), 20) ;
+    }
+    for (size_t offset : { 0u, 1u, 63u, 64u, 100u, 640u }) {
+        for (size_t length : { 0u, 1u, 5u, 64u, 200u, 512u }) {
+            INFO ("offset: " << offset << ", length: " << length) ;
+            std::vector<uint8_t>    actual (length) ;
+            Salsa20::ChaCha20::ApplyAt (state, actual.data (), length, offset) ;
+            REQUIRE (::memcmp (actual.data (), &expected [offset], length) == 0) ;
+
+            Salsa20::ChaCha20::State    s { state } ;
+            std::vector<uint8_t>    in_place (length) ;
+            Salsa20::ChaCha20::Apply (s, in_place.data (), length, offset) ;
+            REQUIRE (in_place == actual) ;
+            // The stateful one continues from the end
+            REQUIRE (s.GetSequenceNumber () == (offset + length) / 64) ;
+        }
+    }
+}
+
+/*
+ * [END of FILE]
+ */
@@ -23,6 +23,167 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <array>
+#include <cerrno>
+#include <initializer_list>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "salsa20.h"
+
+#if ! defined (_WIN32)
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>Selects the kernel active at the construction again on scope exit.</summary>
+class KernelGuard {
+private:
+    std::string saved_ ;
+public:
+    KernelGuard () : saved_ (Salsa20::GetKernelName ()) {
+        /* NO-OP */
+    }
+
+    KernelGuard (const KernelGuard &) = delete ;
+
+    KernelGuard & operator = (const KernelGuard &) = delete ;
+
+    ~KernelGuard () {
+        Salsa20::SelectKernel (saved_.c_str ()) ;
+    }
+
+    const std::string & GetSaved () const {
+        return saved_ ;
+    }
+} ;
+
+/**
+ * Runs `fn (name)` with each of the kernels selected.
+ *
+ * @param names The kernels to run
+ * @param fn The body
+ *
+ * @returns The names of the kernels not available (skipped)
+ *
+ * @remarks The kernel selected before the call is restored even if `fn` throws.
+ */
+template <typename FN_>
+    std::vector<std::string>    ForEachKernel (std::initializer_list<const char *> names, FN_ &&fn) {
+        KernelGuard                 guard ;
+        std::vector<std::string>    skipped ;
+        for (auto name : names) {
+            if (! Salsa20::SelectKernel (name)) {
+                skipped.emplace_back (name) ;
+                continue ;
+            }
+            fn (name) ;
+        }
+        return skipped ;
+    }
+
+/**
+ * Runs `fn (name)` with every kernel selected.
+ */
+template <typename FN_>
+    std::vector<std::string>    ForEachKernel (FN_ &&fn) {
+        return ForEachKernel ({ "scalar", "sse2", "avx2", "avx512" }, std::forward<FN_> (fn)) ;
+    }
+
+/// The key shared by the tests that do not care about its value
+const std::array<uint8_t, 32>   TEST_KEY { {  1,  2,  3,  4,  5,  6,  7,  8
+                                           ,  9, 10, 11, 12, 13, 14, 15, 16
+                                           , 17, 18, 19, 20, 21, 22, 23, 24
+                                           , 25, 26, 27, 28, 29, 30, 31, 32 } } ;
+
+/**
+ * Makes the plain text of `length` bytes (not repeating in a block nor in 256 bytes).
+ *
+ * @remarks `CONTAINER_` is std::vector<uint8_t> or std::string.
+ */
+template <typename CONTAINER_ = std::vector<uint8_t>>
+    CONTAINER_  MakePlain (size_t length) {
+        CONTAINER_  result (length, 0) ;
+        for (size_t i = 0 ; i < length ; ++i) {
+            result [i] = static_cast<typename CONTAINER_::value_type> ((i * 7 + i / 251) & 0xFF) ;
+        }
+        return result ;
+    }
+
+#if ! defined (_WIN32)
+/// <summary>The temporary file (on tmpfs when available) removed on scope exit.</summary>
+class TemporaryFile {
+private:
+    std::string path_ ;
+    int         fd_ ;
+public:
+    TemporaryFile () {
+        struct stat st ;
+        const char *    dir = ::getenv ("TMPDIR") ;
+        if (::stat ("/dev/shm", &st) == 0 && S_ISDIR (st.st_mode)) {
+            dir = "/dev/shm" ;
+        }
+        std::string pattern = std::string { (dir != nullptr) ? dir : "/tmp" } + "/salsa20-XXXXXX" ;
+        std::vector<char>   tmp { pattern.begin (), pattern.end () } ;
+        tmp.push_back (0) ;
+        fd_ = ::mkstemp (tmp.data ()) ;
+        if (fd_ < 0) {
+            throw std::system_error { errno, std::generic_category (), "mkstemp" } ;
+        }
+        path_ = tmp.data () ;
+    }
+
+    TemporaryFile (const TemporaryFile &) = delete ;
+
+    TemporaryFile & operator = (const TemporaryFile &) = delete ;
+
+    ~TemporaryFile () {
+        ::close (fd_) ;
+        ::unlink (path_.c_str ()) ;
+    }
+
+    const std::string & GetPath () const {
+        return path_ ;
+    }
+
+    int GetDescriptor () const {
+        return fd_ ;
+    }
+
+    /// Replaces the contents with `data`
+    void    Write (const std::vector<uint8_t> &data) {
+        if (::ftruncate (fd_, 0) != 0) {
+            throw std::system_error { errno, std::generic_category (), "ftruncate" } ;
+        }
+        for (size_t done = 0 ; done < data.size () ; ) {
+            ssize_t n = ::pwrite (fd_, &data [done], data.size () - done, static_cast<off_t> (done)) ;
+            if (n <= 0) {
+                throw std::system_error { (n < 0) ? errno : EIO, std::generic_category (), "pwrite" } ;
+            }
+            done += static_cast<size_t> (n) ;
+        }
+    }
+
+    std::vector<uint8_t>    Read () const {
+        std::vector<uint8_t>    result ;
+        uint8_t tmp [4096] ;
+        for (off_t offset = 0 ; ; ) {
+            ssize_t n = ::pread (fd_, tmp, sizeof (tmp), offset) ;
+            if (n < 0) {
+                throw std::system_error { errno, std::generic_category (), "pread" } ;
+            }
+            if (n == 0) {
+                break ;
+            }
+            result.insert (result.end (), tmp, tmp + n) ;
+            offset += n ;
+        }
+        return result ;
+    }
+} ;
+#endif
 
 #endif  /* common_h__4015aa40_c2da_4c47_85eb_36d0336c3839 */
 /*
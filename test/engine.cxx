@@ -0,0 +1,162 @@
+/*
+ * engine.cxx: Checks the random number engine against the key stream.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20.h"
+#include "salsa20_engine.h"
+#include <random>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+TEST_CASE ("Random number engine", "[engine]") {
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+
+    const size_t    COUNT = 16 * 40 + 5 ;
+    std::vector<uint8_t>    stream (4 * COUNT) ;
+    {
+        Salsa20::State  tmp { state } ;
+        Salsa20::GenerateKeystreamBytes (tmp, stream.data (), stream.size ()) ;
+    }
+    auto const  word = [&stream](size_t i) {
+        return (  (static_cast<uint32_t> (stream [4 * i + 0]) <<  0)
+                | (static_cast<uint32_t> (stream [4 * i + 1]) <<  8)
+                | (static_cast<uint32_t> (stream [4 * i + 2]) << 16)
+                | (static_cast<uint32_t> (stream [4 * i + 3]) << 24)) ;
+    } ;
+    SECTION ("Sequential") {
+        Salsa20::Engine engine { key_string.c_str (), key_string.size (), 0x87654321u } ;
+        for (size_t i = 0 ; i < COUNT ; ++i) {
+            REQUIRE (engine () == word (i)) ;
+        }
+        REQUIRE (engine.GetPosition () == COUNT) ;
+    }
+    SECTION ("Jump ahead") {
+        for (size_t start : { 0u, 1u, 15u, 16u, 17u, 255u, 256u, 300u, 600u }) {
+            Salsa20::Engine engine { state } ;
+            engine () ;
+            engine.Seek (start) ;
+            REQUIRE (engine.GetPosition () == start) ;
+            for (size_t i = start ; i < COUNT ; ++i) {
+                REQUIRE (engine () == word (i)) ;
+            }
+            engine.Seek (start / 2) ;
+            engine.discard (start - start / 2) ;
+            REQUIRE (engine () == word (start)) ;
+        }
+        // Far away positions are O(1)
+        Salsa20::Engine engine { state } ;
+        engine.discard (1ull << 60) ;
+        REQUIRE (engine.GetPosition () == (1ull << 60)) ;
+        Salsa20::State  tmp { state } ;
+        tmp.SetSequenceNumber ((1ull << 60) / 16) ;
+        auto const  h = tmp.ComputeHashValue () ;
+        REQUIRE (engine () == (h [0] | (h [1] << 8) | (h [2] << 16) | (static_cast<uint32_t> (h [3]) << 24))) ;
+    }
+    SECTION ("Independent streams") {
+        Salsa20::Engine engine { state } ;
+        auto    split = engine.Split (12345) ;
+        Salsa20::Engine expected { key_string.c_str (), key_string.size (), 12345 } ;
+        bool    differs = false ;
+        for (size_t i = 0 ; i < COUNT ; ++i) {
+            auto const  v = split () ;
+            REQUIRE (v == expected ()) ;
+            differs = differs || v != word (i) ;
+        }
+        REQUIRE (differs) ;
+    }
+    SECTION ("Distributions") {
+        Salsa20::Engine engine { state } ;
+        std::uniform_int_distribution<int>  dist { 1, 6 } ;
+        std::vector<int>    histogram (7) ;
+        for (int i = 0 ; i < 6000 ; ++i) {
+            ++histogram [dist (engine)] ;
+        }
+        REQUIRE (histogram [0] == 0) ;
+        for (int i = 1 ; i <= 6 ; ++i) {
+            REQUIRE (800 < histogram [i]) ;
+            REQUIRE (histogram [i] < 1200) ;
+        }
+    }
+}
+
+TEST_CASE ("Bulk random numbers", "[engine]") {
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        for (size_t count : { 0u, 1u, 7u, 100u, 1000u, 5003u }) {
+            INFO ("Count: " << count) ;
+            // Raw
+            {
+                Salsa20::Engine expected { state } ;
+                Salsa20::Engine engine { state } ;
+                expected () ;
+                engine () ;
+                std::vector<uint32_t>   actual (count) ;
+                engine.Fill (actual.data (), count) ;
+                for (size_t i = 0 ; i < count ; ++i) {
+                    REQUIRE (actual [i] == expected ()) ;
+                }
+                REQUIRE (engine () == expected ()) ;
+            }
+            // Float
+            {
+                Salsa20::Engine expected { state } ;
+                Salsa20::Engine engine { state } ;
+                std::vector<float>  actual (count) ;
+                engine.FillUniform01 (actual.data (), count) ;
+                for (size_t i = 0 ; i < count ; ++i) {
+                    REQUIRE (actual [i] == static_cast<float> (expected () >> 8) / 16777216.0f) ;
+                }
+                REQUIRE (engine () == expected ()) ;
+            }
+            // Double
+            {
+                Salsa20::Engine expected { state } ;
+                Salsa20::Engine engine { state } ;
+                std::vector<double> actual (count) ;
+                engine.FillUniform01 (actual.data (), count) ;
+                for (size_t i = 0 ; i < count ; ++i) {
+                    uint64_t    lo = expected () ;
+                    uint64_t    hi = expected () ;
+                    REQUIRE (actual [i] == static_cast<double> (((hi << 32) | lo) >> 12) / 4503599627370496.0) ;
+                    REQUIRE (0.0 <= actual [i]) ;
+                    REQUIRE (actual [i] < 1.0) ;
+                }
+                REQUIRE (engine () == expected ()) ;
+            }
+            // Bounded
+            {
+                // Large bounds make the rejection frequent
+                for (uint32_t bound : { 1u, 6u, 1000u, 0x80000001u, 0xFFFFFFFFu }) {
+                    INFO ("Bound: " << bound) ;
+                    Salsa20::Engine expected { state } ;
+                    Salsa20::Engine engine { state } ;
+                    std::vector<uint32_t>   actual (count) ;
+                    engine.FillBounded (actual.data (), count, bound) ;
+
+                    std::vector<uint32_t>   raw (count) ;
+                    expected.Fill (raw.data (), count) ;
+                    const uint32_t  threshold = (0u - bound) % bound ;
+                    for (size_t i = 0 ; i < count ; ++i) {
+                        uint64_t    m = static_cast<uint64_t> (raw [i]) * bound ;
+                        while (static_cast<uint32_t> (m) < threshold) {
+                            m = static_cast<uint64_t> (expected ()) * bound ;
+                        }
+                        REQUIRE (actual [i] == static_cast<uint32_t> (m >> 32)) ;
+                    }
+                    REQUIRE (engine () == expected ()) ;
+                }
+            }
+        }
+    }) ;
+}
+
+/*
+ * [END of FILE]
+ */
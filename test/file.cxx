@@ -0,0 +1,98 @@
+/*
+ * file.cxx: Tests the salsa20-file tool on the tmpfs files.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+#include <unistd.h>
+
+namespace {
+    const uint64_t  IV = 0xEFCDAB8967452301ull ;
+
+    std::string ToHex (const uint8_t *data, size_t length) {
+        static const char   digits [] = "0123456789abcdef" ;
+        std::string result ;
+        for (size_t i = 0 ; i < length ; ++i) {
+            result += digits [data [i] >> 4] ;
+            result += digits [data [i] & 0x0F] ;
+        }
+        return result ;
+    }
+
+    std::vector<uint8_t>    Encrypt (const std::vector<uint8_t> &plain) {
+        Salsa20::State  state { TEST_KEY.data (), TEST_KEY.size (), IV } ;
+        std::vector<uint8_t>    result (plain.size ()) ;
+        Salsa20::Apply (state, result.data (), plain.data (), plain.size ()) ;
+        return result ;
+    }
+
+    int     RunTool (const std::string &input, const std::string &output = std::string {}) {
+        // The tool reads the initial vector as the little endian
+        uint8_t iv [8] ;
+        for (size_t i = 0 ; i < sizeof (iv) ; ++i) {
+            iv [i] = static_cast<uint8_t> (IV >> (8 * i)) ;
+        }
+        std::string command { "'" SALSA20_FILE_TOOL "'" } ;
+        command += " -k " + ToHex (TEST_KEY.data (), TEST_KEY.size ()) ;
+        command += " -v " + ToHex (iv, sizeof (iv)) ;
+        command += " '" + input + "'" ;
+        if (! output.empty ()) {
+            command += " '" + output + "'" ;
+        }
+        return std::system (command.c_str ()) ;
+    }
+}
+
+TEST_CASE ("salsa20-file", "[file]") {
+    TemporaryFile   input ;
+    TemporaryFile   output ;
+    TemporaryFile   link ;
+    // Turns `link` into a hard link to `input` (removed by the destructor of `link`)
+    REQUIRE (::unlink (link.GetPath ().c_str ()) == 0) ;
+    REQUIRE (::link (input.GetPath ().c_str (), link.GetPath ().c_str ()) == 0) ;
+
+    for (size_t length : { 0u, 1u, 63u, 64u, 1000u, 100003u }) {
+        INFO ("Length: " << length) ;
+        auto const  plain = MakePlain (length) ;
+        auto const  expected = Encrypt (plain) ;
+        {
+            // Into the other file
+            input.Write (plain) ;
+            // Longer than the result, so the stale tail should go
+            output.Write (MakePlain (length + 100)) ;
+            REQUIRE (RunTool (input.GetPath (), output.GetPath ()) == 0) ;
+            REQUIRE (input.Read () == plain) ;
+            REQUIRE (output.Read () == expected) ;
+            // And back
+            REQUIRE (RunTool (output.GetPath (), input.GetPath ()) == 0) ;
+            REQUIRE (input.Read () == plain) ;
+        }
+        {
+            // In place
+            input.Write (plain) ;
+            REQUIRE (RunTool (input.GetPath ()) == 0) ;
+            REQUIRE (input.Read () == expected) ;
+        }
+        {
+            // Into the input itself
+            input.Write (plain) ;
+            REQUIRE (RunTool (input.GetPath (), input.GetPath ()) == 0) ;
+            REQUIRE (input.Read () == expected) ;
+        }
+        {
+            // Into the hard link to the input
+            input.Write (plain) ;
+            REQUIRE (RunTool (input.GetPath (), link.GetPath ()) == 0) ;
+            REQUIRE (input.Read () == expected) ;
+        }
+    }
+}
+
+/*
+ * [END of FILE]
+ */
@@ -0,0 +1,139 @@
+/*
+ * kernel.cxx: Checks every salsa20 kernel against the portable one.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20.h"
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+namespace {
+    std::vector<uint8_t>    Encrypt (const char *kernel, uint64_t seq, const std::vector<uint8_t> &message, bool in_place = false) {
+        std::string key_string { "No one could maintain the public order." } ;
+        Salsa20::State  state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+        state.SetSequenceNumber (seq) ;
+
+        REQUIRE (Salsa20::SelectKernel (kernel)) ;
+        std::vector<uint8_t>    result (message.size ()) ;
+        if (in_place) {
+            result = message ;
+            Salsa20::Apply (state, result.data (), result.size ()) ;
+        }
+        else {
+            Salsa20::Apply (state, result.data (), message.data (), message.size ()) ;
+        }
+        REQUIRE (state.GetSequenceNumber () == seq + (message.size () + 63) / 64) ;
+        return result ;
+    }
+}
+
+TEST_CASE ("Kernels", "[kernel]") {
+    KernelGuard guard ;
+
+    std::vector<uint8_t>    message (64 * 45 + 17) ;
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 13 + 5) ;
+    }
+    // Crosses the 32bit boundary of the sequence number inside a SIMD pass
+    const uint64_t  seq = 0xFFFFFFF9u ;
+    auto const  expected = Encrypt ("scalar", seq, message) ;
+
+    auto const  skipped = ForEachKernel ({ "sse2", "avx2", "avx512" }, [&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        for (size_t length : { 0u, 1u, 64u, 255u, 256u, 511u, 512u, 1024u, 64u * 45u + 17u }) {
+            std::vector<uint8_t>    m (message.begin (), message.begin () + length) ;
+            auto const  actual = Encrypt (name, seq, m) ;
+            REQUIRE (::memcmp (actual.data (), expected.data (), length) == 0) ;
+            auto const  in_place = Encrypt (name, seq, m, true) ;
+            REQUIRE (::memcmp (in_place.data (), expected.data (), length) == 0) ;
+        }
+    }) ;
+    for (auto const &name : skipped) {
+        WARN ("Kernel \"" << name << "\" is not available") ;
+    }
+    REQUIRE (! Salsa20::SelectKernel ("no-such-kernel")) ;
+    REQUIRE (Salsa20::SelectKernel (guard.GetSaved ().c_str ())) ;
+    REQUIRE (guard.GetSaved () == Salsa20::GetKernelName ()) ;
+}
+
+TEST_CASE ("Batch", "[kernel][batch]") {
+    const size_t    COUNT = 37 ;
+    std::vector<Salsa20::State>         states ;
+    std::vector<std::vector<uint8_t>>   messages ;
+    std::vector<std::vector<uint8_t>>   expected ;
+    for (size_t i = 0 ; i < COUNT ; ++i) {
+        std::string key_string = "Key #" + std::to_string (i) ;
+        states.emplace_back (key_string.c_str (), key_string.size (), 0x1234567890ABCDEFull + i) ;
+        // Some messages cross the 32bit boundary of the sequence number
+        states.back ().SetSequenceNumber ((i % 3 == 0) ? 0xFFFFFFFEu : i) ;
+
+        std::vector<uint8_t>    m ((i * 97) % 600) ;
+        for (size_t j = 0 ; j < m.size () ; ++j) {
+            m [j] = static_cast<uint8_t> (i + j * 7) ;
+        }
+        messages.push_back (m) ;
+
+        Salsa20::State  tmp { states.back () } ;
+        Salsa20::Apply (tmp, m.data (), m.size ()) ;
+        expected.push_back (m) ;
+    }
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        std::vector<std::vector<uint8_t>>   actual ;
+        std::vector<void *>         dst ;
+        std::vector<const void *>   src ;
+        std::vector<size_t>         length ;
+        for (size_t i = 0 ; i < COUNT ; ++i) {
+            actual.emplace_back (messages [i].size ()) ;
+        }
+        for (size_t i = 0 ; i < COUNT ; ++i) {
+            dst.push_back (actual [i].data ()) ;
+            src.push_back (messages [i].data ()) ;
+            length.push_back (messages [i].size ()) ;
+        }
+        Salsa20::ApplyBatch (states.data (), dst.data (), src.data (), length.data (), COUNT) ;
+        for (size_t i = 0 ; i < COUNT ; ++i) {
+            INFO ("Message #" << i) ;
+            REQUIRE (actual [i] == expected [i]) ;
+        }
+    }) ;
+}
+
+TEST_CASE ("Precomputed round", "[kernel]") {
+    // Compares the bulk path (uses the precomputed round) against ComputeHashValue (doesn't)
+    auto const  check = [](const Salsa20::State &state) {
+        Salsa20::State  tmp { state } ;
+        std::vector<uint8_t>    actual (64 * 9) ;
+        Salsa20::GenerateKeystream (tmp, actual.data (), 9) ;
+
+        Salsa20::State  expected { state } ;
+        for (size_t i = 0 ; i < 9 ; ++i) {
+            auto const  h = expected.ComputeHashValue () ;
+            expected.IncrementSequenceNumber () ;
+            REQUIRE (::memcmp (&actual [64 * i], h.data (), h.size ()) == 0) ;
+        }
+    } ;
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    check (state) ;
+    state.SetSequenceNumber (0xFFFFFFFBu) ;
+    check (state) ;
+    state.SetInitialVector (0x0123456789ABCDEFull) ;
+    check (state) ;
+
+    Salsa20::State  other { "short key", 9 } ;
+    check (other) ;
+    other = state ;
+    check (other) ;
+    other.SetKey ("another key", 11) ;
+    check (other) ;
+    check (Salsa20::State {}) ;
+}
+
+/*
+ * [END of FILE]
+ */
@@ -9,6 +9,9 @@
 #include "md5.h"
 #include "salsa20.h"
 #include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
@@ -198,6 +201,208 @@ TEST_CASE ("Incremental update", "[incremental update]") {
     REQUIRE (::memcmp (expected.data (), actual.data (), actual.size ()) == 0) ;
 }
 
+TEST_CASE ("Bulk apply", "[bulk]") {
+    auto message = std::array<uint8_t, 64 * 23 + 5> {} ;
+    auto expected = std::array<uint8_t, 64 * 23 + 5> {} ;
+    auto actual = std::array<uint8_t, 64 * 23 + 5> {} ;
+
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 7 + 3) ;
+    }
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state_0 { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    // Crosses the 32bit boundary of the sequence number
+    state_0.SetSequenceNumber (0xFFFFFFFEu) ;
+    Salsa20::State  state_1 { state_0 } ;
+
+    for (size_t i = 0 ; i < message.size () ; i += 64) {
+        auto const hash = state_0.ComputeHashValue () ;
+        state_0.IncrementSequenceNumber () ;
+        for (size_t j = 0 ; j < hash.size () && i + j < message.size () ; ++j) {
+            expected [i + j] = message [i + j] ^ hash [j] ;
+        }
+    }
+    SECTION ("Out of place") {
+        Salsa20::Apply (state_1, actual.data (), message.data (), message.size ()) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), actual.size ()) == 0) ;
+        REQUIRE (state_1.GetSequenceNumber () == state_0.GetSequenceNumber ()) ;
+    }
+    SECTION ("In place") {
+        actual = message ;
+        Salsa20::Apply (state_1, actual.data (), actual.size ()) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), actual.size ()) == 0) ;
+        REQUIRE (state_1.GetSequenceNumber () == state_0.GetSequenceNumber ()) ;
+    }
+}
+
+TEST_CASE ("Random access", "[random access]") {
+    auto message = std::array<uint8_t, 4096> {} ;
+    auto expected = std::array<uint8_t, 4096> {} ;
+
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 11 + 1) ;
+    }
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state_0 { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    Salsa20::State  state_1 { state_0 } ;
+
+    Salsa20::Apply (state_0, expected.data (), message.data (), message.size ()) ;
+
+    for (size_t offset : { 0u, 1u, 63u, 64u, 65u, 100u, 1000u }) {
+        for (size_t length : { 0u, 1u, 63u, 64u, 65u, 128u, 1000u, 2048u }) {
+            auto actual = std::array<uint8_t, 4096> {} ;
+
+            Salsa20::Apply (state_1, &actual [offset], &message [offset], length, offset) ;
+            REQUIRE (::memcmp (&expected [offset], &actual [offset], length) == 0) ;
+            REQUIRE (state_1.GetSequenceNumber () == (offset + length) / 64) ;
+
+            ::memcpy (&actual [offset], &message [offset], length) ;
+            Salsa20::Apply (state_1, &actual [offset], length, offset) ;
+            REQUIRE (::memcmp (&expected [offset], &actual [offset], length) == 0) ;
+            REQUIRE (state_1.GetSequenceNumber () == (offset + length) / 64) ;
+        }
+    }
+}
+
+TEST_CASE ("Stateless random access", "[random access]") {
+    auto message = std::array<uint8_t, 4096> {} ;
+    auto expected = std::array<uint8_t, 4096> {} ;
+
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 11 + 1) ;
+    }
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state_0 { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    const Salsa20::State    state_1 { state_0 } ;
+
+    Salsa20::Apply (state_0, expected.data (), message.data (), message.size ()) ;
+
+    std::vector<std::thread>    readers ;
+    std::atomic<int>            failures { 0 } ;
+    for (size_t t = 0 ; t < 4 ; ++t) {
+        readers.emplace_back ([&, t]() {
+            for (size_t offset : { 0u, 1u, 63u, 64u, 65u, 100u, 1000u }) {
+                for (size_t length : { 0u, 1u, 63u, 64u, 65u, 128u, 1000u, 2048u }) {
+                    auto actual = std::array<uint8_t, 4096> {} ;
+                    size_t  off = offset + t ;
+
+                    Salsa20::ApplyAt (state_1, &actual [off], &message [off], length, off) ;
+                    failures += (::memcmp (&expected [off], &actual [off], length) != 0) ;
+
+                    ::memcpy (&actual [off], &message [off], length) ;
+                    Salsa20::ApplyAt (state_1, &actual [off], length, off) ;
+                    failures += (::memcmp (&expected [off], &actual [off], length) != 0) ;
+                }
+            }
+        }) ;
+    }
+    for (auto &t : readers) {
+        t.join () ;
+    }
+    REQUIRE (failures.load () == 0) ;
+    REQUIRE (state_1.GetSequenceNumber () == 0) ;
+}
+
+TEST_CASE ("Key stream generation", "[keystream]") {
+    auto expected = std::array<uint8_t, 64 * 37> {} ;
+    auto actual = std::array<uint8_t, 64 * 37> {} ;
+
+    expected.fill (0) ;
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state_0 { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    Salsa20::State  state_1 { state_0 } ;
+
+    Salsa20::Apply (state_0, expected.data (), expected.size ()) ;
+    SECTION ("Blocks") {
+        Salsa20::GenerateKeystream (state_1, actual.data (), 37) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), actual.size ()) == 0) ;
+        REQUIRE (state_1.GetSequenceNumber () == 37) ;
+    }
+    SECTION ("Bytes") {
+        actual.fill (0) ;
+        Salsa20::GenerateKeystreamBytes (state_1, actual.data (), 64 * 36 + 5) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), 64 * 36 + 5) == 0) ;
+        REQUIRE (actual [64 * 36 + 5] == 0) ;
+        REQUIRE (state_1.GetSequenceNumber () == 37) ;
+    }
+}
+
+TEST_CASE ("Scatter/gather apply", "[iovec]") {
+    auto message = std::array<uint8_t, 4096> {} ;
+    auto expected = std::array<uint8_t, 4096> {} ;
+    auto actual = std::array<uint8_t, 4096> {} ;
+
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 3 + 7) ;
+    }
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state_0 { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    Salsa20::State  state_1 { state_0 } ;
+
+    Salsa20::Apply (state_0, expected.data (), message.data (), 4000) ;
+
+    // Fragment boundaries of the source and the destination differ
+    std::vector<Salsa20::IOVec> src ;
+    std::vector<Salsa20::IOVec> dst ;
+    for (size_t pos = 0, i = 0 ; pos < 4000 ; ++i) {
+        size_t  n = std::min<size_t> (1 + (i * 37) % 300, 4000 - pos) ;
+        src.push_back ({ &message [pos], n }) ;
+        pos += n ;
+    }
+    for (size_t pos = 0, i = 0 ; pos < 4000 ; ++i) {
+        size_t  n = std::min<size_t> (1 + (i * 91) % 500, 4000 - pos) ;
+        dst.push_back ({ &actual [pos], n }) ;
+        pos += n ;
+    }
+    SECTION ("Out of place") {
+        Salsa20::Apply (state_1, dst.data (), dst.size (), src.data (), src.size ()) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), 4000) == 0) ;
+        REQUIRE (state_1.GetSequenceNumber () == state_0.GetSequenceNumber ()) ;
+    }
+    SECTION ("In place") {
+        actual = message ;
+        Salsa20::Apply (state_1, dst.data (), dst.size ()) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), 4000) == 0) ;
+        REQUIRE (state_1.GetSequenceNumber () == state_0.GetSequenceNumber ()) ;
+    }
+}
+
+TEST_CASE ("Stream cipher", "[stream]") {
+    auto message = std::array<uint8_t, 4096> {} ;
+    auto expected = std::array<uint8_t, 4096> {} ;
+    auto actual = std::array<uint8_t, 4096> {} ;
+
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 5 + 9) ;
+    }
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    Salsa20::StreamCipher   cipher { state } ;
+
+    Salsa20::Apply (state, expected.data (), message.data (), message.size ()) ;
+
+    SECTION ("Irregular chunks") {
+        static const size_t chunks [] = { 7, 7, 1, 49, 64, 200, 3, 1024, 61, 500 } ;
+        size_t  pos = 0 ;
+        for (int i = 0 ; pos < message.size () ; ++i) {
+            size_t  n = std::min (chunks [i % 10], message.size () - pos) ;
+            cipher.Process (&actual [pos], &message [pos], n) ;
+            pos += n ;
+            REQUIRE (cipher.GetPosition () == pos) ;
+        }
+        REQUIRE (::memcmp (expected.data (), actual.data (), actual.size ()) == 0) ;
+    }
+    SECTION ("Seek") {
+        actual = message ;
+        cipher.Seek (1000) ;
+        REQUIRE (cipher.GetPosition () == 1000) ;
+        cipher.Process (&actual [1000], 3000) ;
+        cipher.Seek (0) ;
+        cipher.Process (&actual [0], 1000) ;
+        REQUIRE (::memcmp (expected.data (), actual.data (), 4000) == 0) ;
+    }
+}
+
 /*
  * [END of FILE]
  */
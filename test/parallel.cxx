@@ -0,0 +1,131 @@
+/*
+ * parallel.cxx: Checks the multi-threaded encryption against the sequential one.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20.h"
+#include "salsa20_parallel.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+
+TEST_CASE ("Executor", "[parallel]") {
+    Salsa20::Executor   executor { 3 } ;
+    REQUIRE (executor.GetThreadCount () == 3) ;
+
+    std::vector<std::atomic<int>>   hits (1000) ;
+    executor.ParallelFor (hits.size (), [&hits](size_t i) { ++hits [i] ; }) ;
+    for (auto const &h : hits) {
+        REQUIRE (h.load () == 1) ;
+    }
+    // Nested loops run on the calling thread if all workers are busy
+    std::atomic<int>    total { 0 } ;
+    executor.ParallelFor (8, [&](size_t) {
+        executor.ParallelFor (8, [&](size_t) { ++total ; }) ;
+    }) ;
+    REQUIRE (total.load () == 64) ;
+    executor.ParallelFor (0, [](size_t) { FAIL ("Should not be called") ; }) ;
+}
+
+TEST_CASE ("Parallel apply", "[parallel]") {
+    std::string key_string { "No one could maintain the public order." } ;
+    Salsa20::State  state { key_string.c_str (), key_string.size (), 0x87654321u } ;
+    state.SetSequenceNumber (0xFFFFFF00u) ;
+
+    std::vector<uint8_t>    message (3 * 1024 * 1024 + 1234) ;
+    for (size_t i = 0 ; i < message.size () ; ++i) {
+        message [i] = static_cast<uint8_t> (i * 7 + 3) ;
+    }
+    Salsa20::Executor   executor { 4 } ;
+    for (size_t length : { 0u, 100u, 64u * 1024u, 1024u * 1024u + 64u, 3u * 1024u * 1024u + 1234u }) {
+        INFO ("Length: " << length) ;
+        Salsa20::State  expected_state { state } ;
+        std::vector<uint8_t>    expected (length) ;
+        Salsa20::Apply (expected_state, expected.data (), message.data (), length) ;
+
+        Salsa20::State  actual_state { state } ;
+        std::vector<uint8_t>    actual (length) ;
+        Salsa20::ParallelApply (actual_state, actual.data (), message.data (), length, executor) ;
+        REQUIRE (actual == expected) ;
+        REQUIRE (actual_state.GetSequenceNumber () == expected_state.GetSequenceNumber ()) ;
+
+        std::vector<uint8_t>    in_place (message.begin (), message.begin () + length) ;
+        Salsa20::State  in_place_state { state } ;
+        Salsa20::ParallelApply (in_place_state, in_place.data (), in_place.size (), executor) ;
+        REQUIRE (in_place == expected) ;
+    }
+}
+
+TEST_CASE ("Scheduler", "[parallel]") {
+    // Mixes tiny records with a few large blobs
+    std::vector<size_t> sizes ;
+    for (size_t i = 0 ; i < 300 ; ++i) {
+        sizes.push_back ((i % 50 == 7) ? 5 * 1024 * 1024 + i : 100 + i) ;
+    }
+    std::vector<Salsa20::State>         states ;
+    std::vector<std::vector<uint8_t>>   messages ;
+    std::vector<std::vector<uint8_t>>   expected ;
+    for (size_t i = 0 ; i < sizes.size () ; ++i) {
+        std::string key_string = "Key #" + std::to_string (i) ;
+        states.emplace_back (key_string.c_str (), key_string.size (), i) ;
+        states.back ().SetSequenceNumber (i * 12345) ;
+
+        std::vector<uint8_t>    m (sizes [i]) ;
+        for (size_t j = 0 ; j < m.size () ; ++j) {
+            m [j] = static_cast<uint8_t> (i + j * 3) ;
+        }
+        messages.push_back (m) ;
+        Salsa20::State  tmp { states.back () } ;
+        Salsa20::Apply (tmp, m.data (), m.size ()) ;
+        expected.push_back (m) ;
+    }
+    std::vector<std::vector<uint8_t>>   actual ;
+    for (auto const &m : messages) {
+        actual.emplace_back (m.size ()) ;
+    }
+    std::atomic<size_t> completed { 0 } ;
+    std::vector<std::future<void>>  futures ;
+    {
+        Salsa20::Scheduler  scheduler { 4 } ;
+        REQUIRE (scheduler.GetThreadCount () == 4) ;
+        for (size_t i = 0 ; i < sizes.size () ; ++i) {
+            if (i % 2 == 0) {
+                futures.push_back (scheduler.Submit (states [i], actual [i].data (), messages [i].data (), sizes [i])) ;
+            }
+            else {
+                scheduler.Submit (states [i], actual [i].data (), messages [i].data (), sizes [i], [&completed]() { ++completed ; }) ;
+            }
+        }
+        for (auto &f : futures) {
+            f.get () ;
+        }
+        scheduler.Wait () ;
+        REQUIRE (completed.load () == sizes.size () / 2) ;
+
+        // Also usable after Wait
+        std::vector<uint8_t>    in_place (messages [7]) ;
+        scheduler.Submit (states [7], in_place.data (), in_place.data (), in_place.size ()).get () ;
+        REQUIRE (in_place == expected [7]) ;
+
+        // Empty jobs complete on a worker as well
+        std::atomic<bool>   on_caller { true } ;
+        const auto          caller = std::this_thread::get_id () ;
+        scheduler.Submit (states [0], nullptr, nullptr, 0, [&on_caller, caller]() {
+            on_caller = (std::this_thread::get_id () == caller) ;
+        }) ;
+        scheduler.Wait () ;
+        REQUIRE (! on_caller.load ()) ;
+        scheduler.Submit (states [0], nullptr, nullptr, 0).get () ;
+    }
+    for (size_t i = 0 ; i < sizes.size () ; ++i) {
+        INFO ("Job #" << i) ;
+        REQUIRE (actual [i] == expected [i]) ;
+    }
+}
+
+/*
+ * [END of FILE]
+ */
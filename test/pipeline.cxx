@@ -0,0 +1,148 @@
+/*
+ * pipeline.cxx: Tests the asynchronous file encryption.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20_pipeline.h"
+#include <vector>
+#include <catch.hpp>
+
+#if ! defined (_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined (__linux__)
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined (__linux__) && defined (__NR_io_uring_setup) && defined (__NR_io_uring_enter)
+namespace {
+    /// # of the io_uring submissions let through before failing the rest (negative for no failures)
+    std::atomic<int>    submissions_to_pass { -1 } ;
+    /// Set once io_uring_setup succeeds
+    std::atomic<bool>   io_uring_used { false } ;
+}
+
+/*
+ * Stands in for the libc one, so that the test can fail the io_uring submissions.
+ */
+extern "C" long syscall (long number, ...) noexcept {
+    long    args [6] ;
+    va_list ap ;
+    va_start (ap, number) ;
+    for (auto &a : args) {
+        a = va_arg (ap, long) ;
+    }
+    va_end (ap) ;
+    if (number == __NR_io_uring_enter && 0 < args [1]) {
+        int n = submissions_to_pass.load () ;
+        while (0 <= n && ! submissions_to_pass.compare_exchange_weak (n, (0 < n) ? n - 1 : 0)) {
+            /* NO-OP */
+        }
+        if (n == 0) {
+            errno = ENOMEM ;
+            return -1 ;
+        }
+    }
+    using syscall_t = long (*) (long, ...) ;
+    static const auto   next = reinterpret_cast<syscall_t> (::dlsym (RTLD_NEXT, "syscall")) ;
+    long    result = next (number, args [0], args [1], args [2], args [3], args [4], args [5]) ;
+    if (number == __NR_io_uring_setup && 0 <= result) {
+        io_uring_used.store (true) ;
+    }
+    return result ;
+}
+#define HAVE_SUBMISSION_FAULTS  1
+#endif
+
+TEST_CASE ("File pipeline", "[pipeline]") {
+    const Salsa20::State    state { TEST_KEY.data (), TEST_KEY.size (), 0x0123456789ABCDEFull } ;
+    for (bool use_io_uring : { true, false }) {
+        for (size_t length : { 0u, 1u, 1000u, 65536u, 1234567u }) {
+            INFO ("io_uring: " << use_io_uring << ", Length: " << length) ;
+            auto const  plain = MakePlain (length) ;
+            auto        expected { plain } ;
+            Salsa20::ApplyAt (state, expected.data (), expected.size (), 0) ;
+
+            Salsa20::PipelineOptions    options ;
+            options.chunk_size = 100000 ;   // Not block aligned
+            options.queue_depth = 4 ;
+            options.num_threads = 3 ;
+            options.use_io_uring = use_io_uring ;
+            // Out of place
+            {
+                TemporaryFile   src ;
+                TemporaryFile   dst ;
+                src.Write (plain) ;
+                REQUIRE (Salsa20::ApplyFile (state, dst.GetDescriptor (), src.GetDescriptor (), options) == length) ;
+                REQUIRE (dst.Read () == expected) ;
+                REQUIRE (src.Read () == plain) ;
+            }
+            // In place, back and forth
+            {
+                TemporaryFile   f ;
+                f.Write (plain) ;
+                REQUIRE (Salsa20::ApplyFile (state, f.GetDescriptor (), f.GetDescriptor (), options) == length) ;
+                REQUIRE (f.Read () == expected) ;
+                REQUIRE (Salsa20::ApplyFile (state, f.GetDescriptor (), f.GetDescriptor (), options) == length) ;
+                REQUIRE (f.Read () == plain) ;
+            }
+        }
+    }
+    SECTION ("Reports errors") {
+        TemporaryFile   src ;
+        src.Write (MakePlain (1000)) ;
+        int fd = ::open ("/dev/null", O_RDONLY) ;
+        REQUIRE (0 <= fd) ;
+        for (bool use_io_uring : { true, false }) {
+            Salsa20::PipelineOptions    options ;
+            options.use_io_uring = use_io_uring ;
+            REQUIRE_THROWS_AS (Salsa20::ApplyFile (state, fd, src.GetDescriptor (), options), std::system_error) ;
+        }
+        ::close (fd) ;
+    }
+#if defined (HAVE_SUBMISSION_FAULTS)
+    SECTION ("Reports the failed write submissions") {
+        const size_t    length = 1000000 ;
+        TemporaryFile   src ;
+        TemporaryFile   dst ;
+        src.Write (MakePlain (length)) ;
+        Salsa20::PipelineOptions    options ;
+        options.chunk_size = 100000 ;
+        options.queue_depth = 4 ;
+        options.num_threads = 2 ;
+        io_uring_used.store (false) ;
+        // The first 4 are the reads filling the slots, the writes (and the wake-ups) fail after them
+        submissions_to_pass.store (4) ;
+        bool    thrown = false ;
+        try {
+            Salsa20::ApplyFile (state, dst.GetDescriptor (), src.GetDescriptor (), options) ;
+        }
+        catch (const std::system_error &e) {
+            thrown = true ;
+            REQUIRE (e.code ().value () == ENOMEM) ;
+        }
+        submissions_to_pass.store (-1) ;
+        if (io_uring_used.load ()) {
+            REQUIRE (thrown) ;
+        }
+        else {
+            WARN ("io_uring is not available") ;
+        }
+        // Nothing is left behind for the next run
+        auto    expected = MakePlain (length) ;
+        Salsa20::ApplyAt (state, expected.data (), expected.size (), 0) ;
+        REQUIRE (Salsa20::ApplyFile (state, dst.GetDescriptor (), src.GetDescriptor (), options) == length) ;
+        REQUIRE (dst.Read () == expected) ;
+    }
+#endif
+}
+#endif
+/*
+ * [END of FILE]
+ */
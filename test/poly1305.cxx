@@ -0,0 +1,150 @@
+/*
+ * poly1305.cxx: Tests Poly1305 and the secret box.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20_poly1305.h"
+#include <array>
+#include <vector>
+#include <catch.hpp>
+
+namespace {
+    std::vector<uint8_t>    FromHex (const char *s) {
+        std::vector<uint8_t>    result ;
+        auto    digit = [](char ch) {
+            return ('0' <= ch && ch <= '9') ? ch - '0' : ch - 'a' + 10 ;
+        } ;
+        for ( ; s [0] != 0 && s [1] != 0 ; s += 2) {
+            result.push_back (static_cast<uint8_t> ((digit (s [0]) << 4) | digit (s [1]))) ;
+        }
+        return result ;
+    }
+
+    std::vector<uint8_t>    MakeMessage (size_t length) {
+        std::vector<uint8_t>    result (length) ;
+        for (size_t i = 0 ; i < length ; ++i) {
+            result [i] = static_cast<uint8_t> (i * 7 + i / 251) ;
+        }
+        return result ;
+    }
+
+    std::vector<uint8_t>    Tag (const void *message, size_t length, const void *key) {
+        std::vector<uint8_t>    result (Salsa20::Poly1305::TAG_SIZE) ;
+        Salsa20::ComputePoly1305 (result.data (), message, length, key) ;
+        return result ;
+    }
+}
+
+TEST_CASE ("Poly1305", "[poly1305]") {
+    KernelGuard guard ;
+
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        // RFC 8439 2.5.2
+        {
+            auto const  key = FromHex ("85d6be7857556d337f4452fe42d506a80103808afb0db2fd4abff6af4149f51b") ;
+            std::string msg { "Cryptographic Forum Research Group" } ;
+            REQUIRE (Tag (msg.data (), msg.size (), key.data ()) == FromHex ("a8061dc1305136c6c22b8baf0c0127a9")) ;
+        }
+        // All bits set (the largest limbs)
+        {
+            std::vector<uint8_t>    key (32, 0xFF) ;
+            std::vector<uint8_t>    msg (1000, 0xFF) ;
+            REQUIRE (Tag (msg.data (), msg.size (), key.data ()) == FromHex ("de9406b10e7023bcd692ff687f4cbc7f")) ;
+        }
+        // Long enough for the multi-block path
+        {
+            std::vector<uint8_t>    key (32) ;
+            for (size_t i = 0 ; i < key.size () ; ++i) {
+                key [i] = static_cast<uint8_t> (i * 29 + 3) ;
+            }
+            auto const  msg = MakeMessage (1000) ;
+            REQUIRE (Tag (msg.data (), msg.size (), key.data ()) == FromHex ("90aea944a9abb802bf16a010c58ac896")) ;
+        }
+    }) ;
+    // Incremental updates agree with the scalar kernel
+    {
+        std::vector<uint8_t>    key (32) ;
+        for (size_t i = 0 ; i < key.size () ; ++i) {
+            key [i] = static_cast<uint8_t> (0xA5 ^ (i * 41)) ;
+        }
+        for (size_t length : { 0u, 1u, 15u, 16u, 17u, 63u, 64u, 65u, 255u, 256u, 257u, 1023u, 4099u, 100000u }) {
+            INFO ("Length: " << length) ;
+            auto const  msg = MakeMessage (length) ;
+            REQUIRE (Salsa20::SelectKernel ("scalar")) ;
+            auto const  expected = Tag (msg.data (), msg.size (), key.data ()) ;
+            ForEachKernel ([&](const char *name) {
+                INFO ("Kernel: " << name) ;
+                REQUIRE (Tag (msg.data (), msg.size (), key.data ()) == expected) ;
+                Salsa20::Poly1305   mac { key.data () } ;
+                size_t  step = 1 ;
+                for (size_t pos = 0 ; pos < length ; ) {
+                    size_t  n = std::min (step, length - pos) ;
+                    mac.Update (&msg [pos], n) ;
+                    pos += n ;
+                    step = 3 * step + 2 ;
+                }
+                std::vector<uint8_t>    actual (Salsa20::Poly1305::TAG_SIZE) ;
+                mac.Finish (actual.data ()) ;
+                REQUIRE (actual == expected) ;
+            }) ;
+        }
+    }
+}
+
+TEST_CASE ("Secret box", "[poly1305]") {
+    // From the NaCl test suite (tests/secretbox.c)
+    auto const  key = FromHex ("1b27556473e985d462cd51197a9a46c76009549eac6474f206c4ee0844f68389") ;
+    auto const  nonce = FromHex ("69696ee955b62b73cd62bda875fc73d68219e0036b7a0b37") ;
+    auto const  msg = FromHex ("be075fc53c81f2d5cf141316ebeb0c7b5228c52a4c62cbd44b66849b64244ffc"
+                               "e5ecbaaf33bd751a1ac728d45e6c61296cdc3c01233561f41db66cce314adb31"
+                               "0e3be8250c46f06dceea3a7fa1348057e2f6556ad6b1318a024a838f21af1fde"
+                               "048977eb48f59ffd4924ca1c60902e52f0a089bc76897040e082f93776384864"
+                               "5e0705") ;
+    auto const  expected = FromHex ("f3ffc7703f9400e52a7dfb4b3d3305d98e993b9f48681273c29650ba32fc76ce"
+                                    "48332ea7164d96a4476fb8c531a1186ac0dfc17c98dce87b4da7f011ec48c972"
+                                    "71d2c20f9b928fe2270d6fb863d51738b48eeee314a7cc8ab932164548e526ae"
+                                    "90224368517acfeabd6bb3732bc0e9da99832b61ca01b6de56244a9e88d5f9b3"
+                                    "7973f622a43d14a6599b1f654cb45a74e355a5") ;
+    const Salsa20::SecretBox    box { key.data () } ;
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        std::vector<uint8_t>    sealed (Salsa20::SecretBox::MAC_SIZE + msg.size ()) ;
+        box.Seal (sealed.data (), msg.data (), msg.size (), nonce.data ()) ;
+        REQUIRE (sealed == expected) ;
+
+        std::vector<uint8_t>    opened (msg.size ()) ;
+        REQUIRE (box.Open (opened.data (), sealed.data (), sealed.size (), nonce.data ())) ;
+        REQUIRE (opened == msg) ;
+
+        for (size_t length : { 0u, 1u, 32u, 33u, 1000u, 16384u, 100003u }) {
+            INFO ("Length: " << length) ;
+            auto const  plain = MakeMessage (length) ;
+            // In place
+            std::vector<uint8_t>    buffer (Salsa20::SecretBox::MAC_SIZE + length) ;
+            std::copy (plain.begin (), plain.end (), buffer.begin () + Salsa20::SecretBox::MAC_SIZE) ;
+            auto const  p = buffer.data () + Salsa20::SecretBox::MAC_SIZE ;
+            box.Seal (buffer.data (), p, length, nonce.data ()) ;
+            auto const  copy { buffer } ;
+            REQUIRE (box.Open (p, buffer.data (), buffer.size (), nonce.data ())) ;
+            REQUIRE (std::equal (plain.begin (), plain.end (), p)) ;
+            // Forgeries
+            for (size_t i : { size_t { 0 }, size_t { 15 }, size_t { 16 }, copy.size () - 1 }) {
+                if (copy.size () <= i) {
+                    continue ;
+                }
+                auto    forged { copy } ;
+                forged [i] ^= 0x01 ;
+                std::vector<uint8_t>    out (length, 0xCC) ;
+                REQUIRE_FALSE (box.Open (out.data (), forged.data (), forged.size (), nonce.data ())) ;
+                REQUIRE (std::all_of (out.begin (), out.end (), [](uint8_t v) { return v == 0 ; })) ;
+            }
+        }
+        REQUIRE_FALSE (box.Open (opened.data (), sealed.data (), Salsa20::SecretBox::MAC_SIZE - 1, nonce.data ())) ;
+    }) ;
+}
+
+/*
+ * [END of FILE]
+ */
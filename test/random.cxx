@@ -0,0 +1,111 @@
+/*
+ * random.cxx: Sanity checks of the random byte generator.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20_random.h"
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <vector>
+#include <catch.hpp>
+
+#if ! defined (_WIN32)
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+namespace {
+    size_t  CountBits (const std::vector<uint8_t> &v) {
+        size_t  result = 0 ;
+        for (auto b : v) {
+            for (int i = 0 ; i < 8 ; ++i) {
+                result += (b >> i) & 1 ;
+            }
+        }
+        return result ;
+    }
+}
+
+TEST_CASE ("Random bytes", "[random]") {
+    SECTION ("Outputs differ") {
+        for (size_t length : { 1u, 31u, 64u, 1000u, 4096u, 100000u }) {
+            INFO ("Length: " << length) ;
+            std::vector<uint8_t>    a (length) ;
+            std::vector<uint8_t>    b (length) ;
+            Salsa20::RandomBytes (a.data (), a.size ()) ;
+            Salsa20::RandomBytes (b.data (), b.size ()) ;
+            if (8 <= length) {
+                REQUIRE (a != b) ;
+            }
+        }
+    }
+    SECTION ("Bits are balanced") {
+        std::vector<uint8_t>    v (1 << 16) ;
+        for (size_t i = 0 ; i < v.size () ; i += 100) {
+            Salsa20::RandomBytes (&v [i], std::min<size_t> (100, v.size () - i)) ;
+        }
+        auto const  ones = CountBits (v) ;
+        // 8 * 65536 bits, stddev = 362
+        REQUIRE (262144 - 2000 < ones) ;
+        REQUIRE (ones < 262144 + 2000) ;
+    }
+    SECTION ("Threads have their own streams") {
+        std::array<std::vector<uint8_t>, 4> results ;
+        std::vector<std::thread>    threads ;
+        for (size_t i = 0 ; i < results.size () ; ++i) {
+            threads.emplace_back ([&results, i]() {
+                results [i].resize (256) ;
+                Salsa20::RandomBytes (results [i].data (), results [i].size ()) ;
+            }) ;
+        }
+        for (auto &t : threads) {
+            t.join () ;
+        }
+        for (size_t i = 0 ; i < results.size () ; ++i) {
+            for (size_t j = i + 1 ; j < results.size () ; ++j) {
+                REQUIRE (results [i] != results [j]) ;
+            }
+        }
+    }
+#if ! defined (_WIN32)
+    SECTION ("Reseeded after fork") {
+        std::array<uint8_t, 64> warm ;
+        Salsa20::RandomBytes (warm.data (), warm.size ()) ;
+
+        int fds [2] ;
+        REQUIRE (::pipe (fds) == 0) ;
+        pid_t   pid = ::fork () ;
+        REQUIRE (0 <= pid) ;
+        if (pid == 0) {
+            std::array<uint8_t, 64> child ;
+            Salsa20::RandomBytes (child.data (), child.size ()) ;
+            ssize_t n = ::write (fds [1], child.data (), child.size ()) ;
+            ::_exit (n == static_cast<ssize_t> (child.size ()) ? 0 : 1) ;
+        }
+        ::close (fds [1]) ;
+        std::array<uint8_t, 64> parent ;
+        Salsa20::RandomBytes (parent.data (), parent.size ()) ;
+
+        std::array<uint8_t, 64> child ;
+        size_t  received = 0 ;
+        while (received < child.size ()) {
+            ssize_t n = ::read (fds [0], &child [received], child.size () - received) ;
+            if (n <= 0) {
+                break ;
+            }
+            received += static_cast<size_t> (n) ;
+        }
+        ::close (fds [0]) ;
+        int status = 0 ;
+        ::waitpid (pid, &status, 0) ;
+        REQUIRE (received == child.size ()) ;
+        REQUIRE (parent != child) ;
+    }
+#endif
+}
+
+/*
+ * [END of FILE]
+ */
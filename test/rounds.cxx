@@ -0,0 +1,123 @@
+/*
+ * rounds.cxx: Checks the reduced round variants (Salsa20/8 and Salsa20/12).
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20.h"
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+namespace {
+    const std::string   KEY { "Salsa20/8 is for the shuffling.." } ;
+    const uint64_t      IV = 0x0123456789ABCDEFull ;
+
+    template <int DOUBLE_ROUNDS>
+        std::vector<uint8_t>    Encrypt (const char *kernel, uint64_t seq, const std::vector<uint8_t> &message) {
+            Salsa20::RoundState<DOUBLE_ROUNDS>  state { KEY.c_str (), KEY.size (), IV } ;
+            state.SetSequenceNumber (seq) ;
+
+            REQUIRE (Salsa20::SelectKernel (kernel)) ;
+            std::vector<uint8_t>    result (message.size ()) ;
+            Salsa20::Apply (state, result.data (), message.data (), message.size ()) ;
+            REQUIRE (state.GetSequenceNumber () == seq + (message.size () + 63) / 64) ;
+            return result ;
+        }
+
+    template <int DOUBLE_ROUNDS>
+        void    CheckKernels () {
+            std::vector<uint8_t>    message (64 * 45 + 17) ;
+            for (size_t i = 0 ; i < message.size () ; ++i) {
+                message [i] = static_cast<uint8_t> (i * 13 + 5) ;
+            }
+            // Crosses the 32bit boundary of the sequence number inside a SIMD pass
+            const uint64_t  seq = 0xFFFFFFF9u ;
+            auto const  expected = Encrypt<DOUBLE_ROUNDS> ("scalar", seq, message) ;
+
+            ForEachKernel ({ "sse2", "avx2", "avx512" }, [&](const char *name) {
+                INFO ("Kernel: " << name) ;
+                for (size_t length : { 0u, 1u, 64u, 255u, 256u, 511u, 512u, 1024u, 64u * 45u + 17u }) {
+                    std::vector<uint8_t>    m (message.begin (), message.begin () + length) ;
+                    auto const  actual = Encrypt<DOUBLE_ROUNDS> (name, seq, m) ;
+                    REQUIRE (::memcmp (actual.data (), expected.data (), length) == 0) ;
+                }
+            }) ;
+        }
+}
+
+TEST_CASE ("Reduced rounds", "[rounds]") {
+    KernelGuard guard ;
+
+    const std::vector<uint8_t>  expected8 { 0x4d, 0x68, 0x57, 0x62, 0x5e, 0xb8, 0xc2, 0x06
+                                          , 0x4d, 0xb6, 0xd0, 0x7b, 0x24, 0x5d, 0x8e, 0x37
+                                          , 0x7c, 0xd0, 0xf6, 0x96, 0x55, 0xea, 0x94, 0x3e
+                                          , 0x53, 0xe2, 0x40, 0xe9, 0xcb, 0x32, 0xeb, 0xa2
+                                          , 0x76, 0xd2, 0x0b, 0xc1, 0x9e, 0x9a, 0x5f, 0xff
+                                          , 0x74, 0x82, 0xc8, 0xb2, 0x26, 0x2e, 0x1e, 0x15
+                                          , 0x12, 0xad, 0x3a, 0x22, 0x22, 0x38, 0x7c, 0xce
+                                          , 0xe4, 0xe2, 0xc4, 0xd7, 0x6b, 0x03, 0x83, 0x77 } ;
+    const std::vector<uint8_t>  expected12 { 0x94, 0xc0, 0xa7, 0x2d, 0xdb, 0x5d, 0x8b, 0x98
+                                           , 0x11, 0xac, 0x84, 0x7c, 0x3d, 0xa5, 0x4c, 0xde
+                                           , 0x41, 0xf9, 0xa0, 0x66, 0xf1, 0x1a, 0x5b, 0x70
+                                           , 0x8b, 0xc4, 0xbc, 0x3c, 0x7d, 0xf0, 0xf2, 0xbd
+                                           , 0xaa, 0x01, 0xf8, 0xfe, 0xec, 0xf5, 0x5c, 0x2b
+                                           , 0x9b, 0x0e, 0x7d, 0xab, 0x22, 0xfe, 0x4b, 0xbb
+                                           , 0x3f, 0xb5, 0xeb, 0xc7, 0x1d, 0x52, 0xa0, 0x59
+                                           , 0x6a, 0xfa, 0xe5, 0x84, 0x4f, 0x61, 0x1f, 0xd7 } ;
+
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        {
+            Salsa20::State8     state { KEY.c_str (), KEY.size (), IV } ;
+            auto const  hash = state.ComputeHashValue () ;
+            REQUIRE (std::vector<uint8_t> (hash.begin (), hash.end ()) == expected8) ;
+            std::vector<uint8_t>    actual (64) ;
+            Salsa20::GenerateKeystream (state, actual.data (), 1) ;
+            REQUIRE (actual == expected8) ;
+        }
+        {
+            Salsa20::State12    state { KEY.c_str (), KEY.size (), IV } ;
+            auto const  hash = state.ComputeHashValue () ;
+            REQUIRE (std::vector<uint8_t> (hash.begin (), hash.end ()) == expected12) ;
+        }
+        {
+            // 10 double rounds are the plain Salsa20
+            Salsa20::RoundState<10> state { KEY.c_str (), KEY.size (), IV } ;
+            Salsa20::State  reference { KEY.c_str (), KEY.size (), IV } ;
+            REQUIRE (state.ComputeHashValue () == reference.ComputeHashValue ()) ;
+        }
+    }) ;
+    CheckKernels<4> () ;
+    CheckKernels<6> () ;
+}
+
+TEST_CASE ("Reduced rounds with offset", "[rounds]") {
+    const Salsa20::State8   state { KEY.c_str (), KEY.size (), IV } ;
+
+    std::vector<uint8_t>    expected (64 * 20) ;
+    {
+        Salsa20::State8     tmp { state } ;
+        Salsa20::GenerateKeystream (tmp, expected.data (), 20) ;
+    }
+    for (size_t offset : { 0u, 1u, 63u, 64u, 100u, 640u }) {
+        for (size_t length : { 0u, 1u, 5u, 64u, 200u, 512u }) {
+            INFO ("offset: " << offset << ", length: " << length) ;
+            std::vector<uint8_t>    actual (length) ;
+            Salsa20::ApplyAt (state, actual.data (), length, offset) ;
+            REQUIRE (::memcmp (actual.data (), &expected [offset], length) == 0) ;
+
+            Salsa20::State8         s { state } ;
+            std::vector<uint8_t>    in_place (length) ;
+            Salsa20::Apply (s, in_place.data (), length, offset) ;
+            REQUIRE (in_place == actual) ;
+            REQUIRE (s.GetSequenceNumber () == (offset + length) / 64) ;
+        }
+    }
+}
+
+/*
+ * [END of FILE]
+ */
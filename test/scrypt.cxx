@@ -0,0 +1,97 @@
+/*
+ * scrypt.cxx: Tests the scrypt key derivation.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20_scrypt.h"
+#include "salsa20_parallel.h"
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+namespace {
+    std::vector<uint8_t>    FromHex (const char *s) {
+        std::vector<uint8_t>    result ;
+        auto    digit = [](char ch) {
+            return ('0' <= ch && ch <= '9') ? ch - '0' : ch - 'a' + 10 ;
+        } ;
+        for ( ; s [0] != 0 && s [1] != 0 ; s += 2) {
+            result.push_back (static_cast<uint8_t> ((digit (s [0]) << 4) | digit (s [1]))) ;
+        }
+        return result ;
+    }
+
+    std::vector<uint8_t>    Derive ( const char *password, const char *salt, size_t length
+                                   , uint64_t N, uint32_t r, uint32_t p
+                                   , const Salsa20::ScryptOptions &options = Salsa20::ScryptOptions {}) {
+        std::vector<uint8_t>    result (length) ;
+        Salsa20::Scrypt ( result.data (), result.size ()
+                        , password, ::strlen (password)
+                        , salt, ::strlen (salt)
+                        , N, r, p, options) ;
+        return result ;
+    }
+}
+
+TEST_CASE ("Scrypt", "[scrypt]") {
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        {
+            // RFC 7914 section 12
+            REQUIRE (Derive ("", "", 64, 16, 1, 1)
+                     == FromHex ("77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+                                 "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906")) ;
+            REQUIRE (Derive ("password", "NaCl", 64, 1024, 8, 16)
+                     == FromHex ("fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+                                 "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640")) ;
+            REQUIRE (Derive ("pleaseletmein", "SodiumChloride", 64, 16384, 8, 1)
+                     == FromHex ("7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+                                 "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887")) ;
+        }
+        {
+            // Odd r, more lanes than the output blocks and a partial output block
+            REQUIRE (Derive ("pw", "salt", 100, 64, 3, 5)
+                     == FromHex ("6e2434fae1aa4e97719c006277d6e196ab2d04dd05a623e4d27c78aa75893607"
+                                 "485f345c031eef3b46c65f3250c08837270dab2ae5ed1f3e7205671dd4632f52"
+                                 "e4ad4b2e5dd0f266b86470284a812c4cce1b387ed3c4b46203d44cd9f6245342"
+                                 "ebef4fad")) ;
+        }
+    }) ;
+}
+
+TEST_CASE ("Scrypt options", "[scrypt]") {
+    auto const  expected = Derive ("password", "NaCl", 64, 1024, 8, 16) ;
+    {
+        Salsa20::ScryptOptions  options ;
+        options.use_huge_pages = false ;
+        options.num_threads = 1 ;
+        REQUIRE (Derive ("password", "NaCl", 64, 1024, 8, 16, options) == expected) ;
+    }
+    {
+        Salsa20::Executor       executor { 3 } ;
+        Salsa20::ScryptOptions  options ;
+        options.executor = &executor ;
+        REQUIRE (Derive ("password", "NaCl", 64, 1024, 8, 16, options) == expected) ;
+    }
+}
+
+TEST_CASE ("Scrypt rejects invalid parameters", "[scrypt]") {
+    uint8_t out [32] ;
+    // N should be a power of 2 greater than 1
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, sizeof (out), "", 0, "", 0, 0, 1, 1), std::invalid_argument) ;
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, sizeof (out), "", 0, "", 0, 1, 1, 1), std::invalid_argument) ;
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, sizeof (out), "", 0, "", 0, 24, 1, 1), std::invalid_argument) ;
+    // N < 2^(128 * r / 8)
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, sizeof (out), "", 0, "", 0, 1u << 16, 1, 1), std::invalid_argument) ;
+    // r * p < 2^30
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, sizeof (out), "", 0, "", 0, 16, 0, 1), std::invalid_argument) ;
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, sizeof (out), "", 0, "", 0, 16, 1 << 15, 1 << 15), std::invalid_argument) ;
+    REQUIRE_THROWS_AS (Salsa20::Scrypt (out, 0, "", 0, "", 0, 16, 1, 1), std::invalid_argument) ;
+}
+
+/*
+ * [END of FILE]
+ */
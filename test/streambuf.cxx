@@ -0,0 +1,198 @@
+/*
+ * streambuf.cxx: Tests the encrypting stream buffer.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20_streambuf.h"
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <catch.hpp>
+
+namespace {
+    /// <summary>Accepts at most `limit` bytes at once.</summary>
+    class ChoppySink : public std::stringbuf {
+    private:
+        std::streamsize limit_ ;
+    public:
+        explicit ChoppySink (std::streamsize limit) : limit_ (limit) {
+            /* NO-OP */
+        }
+    protected:
+        std::streamsize xsputn (const char *s, std::streamsize count) override {
+            return std::stringbuf::xsputn (s, std::min (count, limit_)) ;
+        }
+    } ;
+
+    /// <summary>A sink that cannot seek (as pipes and sockets).</summary>
+    class PipeSink : public std::streambuf {
+    public:
+        std::string data ;
+    protected:
+        int_type    overflow (int_type ch) override {
+            if (! traits_type::eq_int_type (ch, traits_type::eof ())) {
+                data.push_back (traits_type::to_char_type (ch)) ;
+            }
+            return traits_type::not_eof (ch) ;
+        }
+
+        std::streamsize xsputn (const char *s, std::streamsize count) override {
+            data.append (s, static_cast<size_t> (count)) ;
+            return count ;
+        }
+    } ;
+
+    std::string Encrypt (const Salsa20::State &state, const std::string &plain) {
+        std::string result { plain } ;
+        Salsa20::ApplyAt (state, &result [0], result.size (), 0) ;
+        return result ;
+    }
+}
+
+TEST_CASE ("Cipher stream buffer", "[streambuf]") {
+    const Salsa20::State    state { TEST_KEY.data (), TEST_KEY.size (), 0x0123456789ABCDEFull } ;
+    SECTION ("Writes") {
+        for (size_t length : { 0u, 1u, 63u, 1000u, 4096u, 100000u }) {
+            INFO ("Length: " << length) ;
+            auto const  plain = MakePlain<std::string> (length) ;
+            std::stringbuf  sink ;
+            {
+                Salsa20::cipher_streambuf   cbuf { &sink, state, 4096 } ;
+                std::ostream    os { &cbuf } ;
+                // Mixes the character, the small and the large writes
+                size_t  pos = 0 ;
+                size_t  step = 1 ;
+                while (pos < length) {
+                    size_t  n = std::min (step, length - pos) ;
+                    if (n == 1) {
+                        os.put (plain [pos]) ;
+                    }
+                    else {
+                        os.write (&plain [pos], n) ;
+                    }
+                    pos += n ;
+                    step = 3 * step + 1 ;
+                }
+                REQUIRE (os.good ()) ;
+            }
+            REQUIRE (sink.str () == Encrypt (state, plain)) ;
+        }
+    }
+    SECTION ("Reads") {
+        for (size_t length : { 0u, 1u, 63u, 1000u, 4096u, 100000u }) {
+            INFO ("Length: " << length) ;
+            auto const  plain = MakePlain<std::string> (length) ;
+            std::stringbuf  source { Encrypt (state, plain) } ;
+            Salsa20::cipher_streambuf   cbuf { &source, state, 4096 } ;
+            std::istream    is { &cbuf } ;
+            std::string     result (length, 0) ;
+            size_t  pos = 0 ;
+            size_t  step = 1 ;
+            while (pos < length) {
+                size_t  n = std::min (step, length - pos) ;
+                if (n == 1) {
+                    result [pos] = static_cast<char> (is.get ()) ;
+                }
+                else {
+                    is.read (&result [pos], n) ;
+                }
+                pos += n ;
+                step = 3 * step + 1 ;
+            }
+            REQUIRE (result == plain) ;
+            REQUIRE (is.get () == std::char_traits<char>::eof ()) ;
+        }
+    }
+    SECTION ("Seeks") {
+        const size_t    length = 20000 ;
+        auto const  plain = MakePlain<std::string> (length) ;
+        std::stringbuf  source { Encrypt (state, plain) } ;
+        Salsa20::cipher_streambuf   cbuf { &source, state, 4096 } ;
+        std::istream    is { &cbuf } ;
+        for (size_t offset : { 12345u, 0u, 4095u, 19999u, 64u, 7u }) {
+            INFO ("Offset: " << offset) ;
+            is.seekg (offset) ;
+            REQUIRE (static_cast<size_t> (is.tellg ()) == offset) ;
+            std::string tmp (std::min<size_t> (100, length - offset), 0) ;
+            is.read (&tmp [0], tmp.size ()) ;
+            REQUIRE (tmp == plain.substr (offset, tmp.size ())) ;
+            REQUIRE (static_cast<size_t> (is.tellg ()) == offset + tmp.size ()) ;
+        }
+        is.seekg (-10, std::ios_base::end) ;
+        REQUIRE (static_cast<size_t> (is.tellg ()) == length - 10) ;
+        std::string tmp (10, 0) ;
+        is.read (&tmp [0], tmp.size ()) ;
+        REQUIRE (tmp == plain.substr (length - 10)) ;
+    }
+    SECTION ("Overwrites in the middle") {
+        const size_t    length = 10000 ;
+        auto    plain = MakePlain<std::string> (length) ;
+        std::stringbuf  sink ;
+        {
+            Salsa20::cipher_streambuf   cbuf { &sink, state, 1024 } ;
+            std::iostream   s { &cbuf } ;
+            s.write (plain.data (), plain.size ()) ;
+            s.seekp (3000) ;
+            s.write ("patched", 7) ;
+            plain.replace (3000, 7, "patched") ;
+            // Reads back after the write
+            s.seekg (2990) ;
+            std::string tmp (30, 0) ;
+            s.read (&tmp [0], tmp.size ()) ;
+            REQUIRE (tmp == plain.substr (2990, 30)) ;
+            // Writes after the read
+            s.write ("again", 5) ;
+            plain.replace (3020, 5, "again") ;
+        }
+        REQUIRE (sink.str () == Encrypt (state, plain)) ;
+    }
+    SECTION ("Plain header") {
+        std::stringbuf  sink ;
+        sink.sputn ("HEADER", 6) ;
+        auto const  plain = MakePlain<std::string> (5000) ;
+        {
+            Salsa20::cipher_streambuf   cbuf { &sink, state } ;
+            std::ostream    os { &cbuf } ;
+            os.write (plain.data (), plain.size ()) ;
+        }
+        REQUIRE (sink.str () == "HEADER" + Encrypt (state, plain)) ;
+    }
+    SECTION ("Short writes") {
+        auto const  plain = MakePlain<std::string> (1000) ;
+        ChoppySink  sink { 100 } ;
+        {
+            Salsa20::cipher_streambuf   cbuf { &sink, state, 1024 } ;
+            std::ostream    os { &cbuf } ;
+            os.write (plain.data (), 1000) ;
+            os.flush () ;
+            REQUIRE (os.bad ()) ;
+            os.clear () ;
+            // Continues from the end of the written part with the matching key stream
+            REQUIRE (static_cast<size_t> (os.tellp ()) == 100) ;
+            os.write (&plain [100], 50) ;
+            os.flush () ;
+            REQUIRE (os.good ()) ;
+        }
+        REQUIRE (sink.str () == Encrypt (state, plain.substr (0, 150))) ;
+    }
+    SECTION ("Tells on a non-seekable sink") {
+        auto const  plain = MakePlain<std::string> (5000) ;
+        PipeSink    sink ;
+        {
+            Salsa20::cipher_streambuf   cbuf { &sink, state, 1024 } ;
+            std::ostream    os { &cbuf } ;
+            os.write (plain.data (), 100) ;
+            REQUIRE (static_cast<size_t> (os.tellp ()) == 100) ;
+            os.write (&plain [100], plain.size () - 100) ;
+            REQUIRE (static_cast<size_t> (os.tellp ()) == plain.size ()) ;
+            REQUIRE (os.good ()) ;
+        }
+        REQUIRE (sink.data == Encrypt (state, plain)) ;
+    }
+}
+/*
+ * [END of FILE]
+ */
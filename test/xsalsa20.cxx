@@ -0,0 +1,89 @@
+/*
+ * xsalsa20.cxx: Checks HSalsa20 and XSalsa20 against the known vectors.
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ */
+#include "common.h"
+#include "salsa20.h"
+#include <array>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <catch.hpp>
+
+TEST_CASE ("HSalsa20", "[xsalsa20]") {
+    // From the NaCl test suite (core1)
+    const std::array<uint8_t, 32>   key { 0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1
+                                        , 0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25
+                                        , 0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33
+                                        , 0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42 } ;
+    const std::array<uint8_t, 32>   expected { 0x1b, 0x27, 0x55, 0x64, 0x73, 0xe9, 0x85, 0xd4
+                                             , 0x62, 0xcd, 0x51, 0x19, 0x7a, 0x9a, 0x46, 0xc7
+                                             , 0x60, 0x09, 0x54, 0x9e, 0xac, 0x64, 0x74, 0xf2
+                                             , 0x06, 0xc4, 0xee, 0x08, 0x44, 0xf6, 0x83, 0x89 } ;
+    const std::array<uint8_t, 16>   nonce {} ;
+
+    ForEachKernel ([&](const char *name) {
+        INFO ("Kernel: " << name) ;
+        std::array<uint8_t, 32> subkey ;
+        Salsa20::HSalsa20 (subkey.data (), key.data (), key.size (), nonce.data ()) ;
+        REQUIRE (subkey == expected) ;
+    }) ;
+}
+
+TEST_CASE ("XSalsa20", "[xsalsa20]") {
+    const std::string   key { "this is 32-byte key for xsalsa20" } ;
+    const std::string   nonce { "24-byte nonce for xsalsa" } ;
+
+    SECTION ("Short message") {
+        const std::string   message { "Hello world!" } ;
+        const std::vector<uint8_t>  expected { 0x00, 0x2d, 0x45, 0x13, 0x84, 0x3f, 0xc2, 0x40, 0xc4, 0x01, 0xe5, 0x41 } ;
+
+        Salsa20::XState state { key.c_str (), key.size (), nonce.c_str () } ;
+        std::vector<uint8_t>    actual (message.size ()) ;
+        Salsa20::Apply (state, actual.data (), message.c_str (), message.size ()) ;
+        REQUIRE (actual == expected) ;
+    }
+    SECTION ("Key stream") {
+        const std::vector<uint8_t>  expected { 0x48, 0x48, 0x29, 0x7f, 0xeb, 0x1f, 0xb5, 0x2f
+                                             , 0xb6, 0x6d, 0x81, 0x60, 0x9b, 0xd5, 0x47, 0xfa
+                                             , 0xbc, 0xbe, 0x70, 0x26, 0xed, 0xc8, 0xb5, 0xe5
+                                             , 0xe4, 0x49, 0xd0, 0x88, 0xbf, 0xa6, 0x9c, 0x08
+                                             , 0x8f, 0x5d, 0x8d, 0xa1, 0xd7, 0x91, 0x26, 0x7c
+                                             , 0x2c, 0x19, 0x5a, 0x7f, 0x8c, 0xae, 0x9c, 0x4b
+                                             , 0x40, 0x50, 0xd0, 0x8c, 0xe6, 0xd3, 0xa1, 0x51
+                                             , 0xec, 0x26, 0x5f, 0x3a, 0x58, 0xe4, 0x76, 0x48 } ;
+
+        Salsa20::XState state { key.c_str (), key.size (), nonce.c_str () } ;
+        std::vector<uint8_t>    actual (expected.size ()) ;
+        Salsa20::GenerateKeystream (state, actual.data (), 1) ;
+        REQUIRE (actual == expected) ;
+        REQUIRE (state.GetSequenceNumber () == 1) ;
+
+        // Setting the same nonce again rewinds the stream
+        state.SetNonce (nonce.c_str ()) ;
+        REQUIRE (state.GetSequenceNumber () == 0) ;
+        std::vector<uint8_t>    again (expected.size ()) ;
+        Salsa20::GenerateKeystream (state, again.data (), 1) ;
+        REQUIRE (again == expected) ;
+
+        // The key and the nonce change together
+        Salsa20::XState other { "another key", 11, "another 24-byte nonce..." } ;
+        Salsa20::GenerateKeystream (other, again.data (), 1) ;
+        REQUIRE (again != expected) ;
+        other.SetKey (key.c_str (), key.size (), nonce.c_str ()) ;
+        REQUIRE (other.GetSequenceNumber () == 0) ;
+        Salsa20::GenerateKeystream (other, again.data (), 1) ;
+        REQUIRE (again == expected) ;
+
+        std::vector<uint8_t>    at (expected.size () - 10) ;
+        Salsa20::ApplyAt (other, at.data (), at.size (), 10) ;
+        REQUIRE (std::equal (at.begin (), at.end (), expected.begin () + 10)) ;
+    }
+    // The plain Salsa20 setters would bypass HSalsa20
+    static_assert (! std::is_convertible<Salsa20::XState &, Salsa20::State &>::value, "XState should not be usable as State") ;
+}
+
+/*
+ * [END of FILE]
+ */
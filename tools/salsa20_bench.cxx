@@ -0,0 +1,286 @@
+/*
+ * salsa20_bench.cxx: Measures the throughput of the kernels over the message sizes
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "salsa20.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#   include <x86intrin.h>
+#   define HAVE_TSC    1
+#endif
+
+namespace {
+
+    const char *    KERNELS [] = { "scalar", "sse2", "avx2", "avx512" } ;
+
+    /// Offset given to the offset taking overloads (not block aligned, so the partial head is included)
+    const uint64_t  START_OFFSET = 64 * 1000 + 13 ;
+
+    /// Alignment of the aligned buffers (a cache line)
+    const size_t    ALIGNMENT = 64 ;
+
+    void    Usage (const char *program) {
+        std::cerr << "Usage: " << program << " [options]\n"
+                  << "Measures the throughput of ComputeHashValue and the Apply overloads on each kernel.\n"
+                  << "Options:\n"
+                  << "    -o <file>   Writes the JSON into <file> (defaults to the standard output)\n"
+                  << "    -k <name>   Measures the kernel <name> only (may be repeated)\n"
+                  << "    -m <bytes>  The largest message size (defaults to 1073741824)\n"
+                  << "    -t <sec>    The minimum duration of a measurement (defaults to 0.1)\n" ;
+    }
+
+    uint64_t    ReadCycles () {
+#if defined (HAVE_TSC)
+        return __rdtsc () ;
+#else
+        return 0 ;
+#endif
+    }
+
+    /// <summary>A buffer with the cache line aligned start.</summary>
+    class Buffer {
+    private:
+        std::unique_ptr<uint8_t []> storage_ ;
+        uint8_t *   aligned_ ;
+    public:
+        explicit Buffer (size_t size) : storage_ { new uint8_t [size + 2 * ALIGNMENT] } {
+            auto    addr = reinterpret_cast<uintptr_t> (storage_.get ()) ;
+            aligned_ = reinterpret_cast<uint8_t *> ((addr + ALIGNMENT - 1) & ~static_cast<uintptr_t> (ALIGNMENT - 1)) ;
+            // Touches the pages before the measurements
+            for (size_t i = 0 ; i < size + ALIGNMENT ; ++i) {
+                aligned_ [i] = static_cast<uint8_t> (i * 7 + 1) ;
+            }
+        }
+
+        uint8_t *   Get (bool aligned) const {
+            // An odd offset breaks both the word and the vector alignment
+            return aligned ? aligned_ : aligned_ + 1 ;
+        }
+    } ;
+
+    /// <summary>The result of a measurement.</summary>
+    struct Sample {
+        uint64_t    iterations ;
+        double      seconds ;
+        uint64_t    cycles ;
+    } ;
+
+    /**
+     * Runs `fn` repeatedly, doubling the # of iterations until it takes `min_time` seconds.
+     */
+    Sample  Measure (const std::function<void ()> &fn, double min_time) {
+        using clock = std::chrono::steady_clock ;
+        // Warms up the caches and the branch predictors
+        fn () ;
+        for (uint64_t n = 1 ; ; n *= 2) {
+            auto        start = clock::now () ;
+            uint64_t    c0 = ReadCycles () ;
+            for (uint64_t i = 0 ; i < n ; ++i) {
+                fn () ;
+            }
+            uint64_t    c1 = ReadCycles () ;
+            double      elapsed = std::chrono::duration<double> (clock::now () - start).count () ;
+            if (min_time <= elapsed) {
+                return Sample { n, elapsed, c1 - c0 } ;
+            }
+        }
+    }
+
+    /// <summary>Writes the measurements as a JSON document.</summary>
+    class Report {
+    private:
+        std::ostream &  out_ ;
+        bool            first_ ;
+    public:
+        Report (std::ostream &out, double min_time) : out_ (out), first_ (true) {
+            out_ << "{\n"
+                 << "  \"benchmark\": \"salsa20_bench\",\n"
+#if defined (__VERSION__)
+                 << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+#endif
+#if defined (HAVE_TSC)
+                 << "  \"cycle_counter\": \"tsc\",\n"
+#else
+                 << "  \"cycle_counter\": null,\n"
+#endif
+                 << "  \"default_kernel\": \"" << Salsa20::GetKernelName () << "\",\n"
+                 << "  \"min_time\": " << min_time << ",\n"
+                 << "  \"results\": [" ;
+        }
+
+        ~Report () {
+            out_ << "\n  ]\n}\n" ;
+        }
+
+        void    Add ( const char *kernel, const char *function, size_t size
+                    , bool aligned, bool in_place, const Sample &sample) {
+            const double    bytes = static_cast<double> (size) * static_cast<double> (sample.iterations) ;
+            std::ostringstream  line ;
+            line << std::setprecision (6)
+                 << "\n    { \"kernel\": \"" << kernel << "\""
+                 << ", \"function\": \"" << function << "\""
+                 << ", \"size\": " << size
+                 << ", \"aligned\": " << (aligned ? "true" : "false")
+                 << ", \"in_place\": " << (in_place ? "true" : "false")
+                 << ", \"iterations\": " << sample.iterations
+                 << ", \"seconds\": " << sample.seconds
+                 << ", \"gb_per_s\": " << (bytes / sample.seconds / 1.0e9)
+                 << ", \"cycles_per_byte\": " ;
+#if defined (HAVE_TSC)
+            line << (static_cast<double> (sample.cycles) / bytes) ;
+#else
+            line << "null" ;
+#endif
+            line << " }" ;
+            out_ << (first_ ? "" : ",") << line.str () << std::flush ;
+            first_ = false ;
+        }
+    } ;
+
+    /// <summary>An Apply overload under the measurement.</summary>
+    struct Target {
+        const char *    name ;
+        /// false for the overloads taking the message only
+        bool            has_source ;
+        std::function<void (Salsa20::State &, uint8_t *, const uint8_t *, size_t)>  apply ;
+    } ;
+
+    std::vector<Target> MakeTargets () {
+        using Salsa20::State ;
+        return std::vector<Target> {
+            { "Apply(dst, src, length)", true, [](State &s, uint8_t *d, const uint8_t *p, size_t n) {
+                Salsa20::Apply (s, d, p, n) ;
+            } },
+            { "Apply(dst, src, length, offset)", true, [](State &s, uint8_t *d, const uint8_t *p, size_t n) {
+                Salsa20::Apply (s, d, p, n, START_OFFSET) ;
+            } },
+            { "Apply(message, length)", false, [](State &s, uint8_t *d, const uint8_t *, size_t n) {
+                Salsa20::Apply (s, d, n) ;
+            } },
+            { "Apply(message, length, offset)", false, [](State &s, uint8_t *d, const uint8_t *, size_t n) {
+                Salsa20::Apply (s, d, n, START_OFFSET) ;
+            } },
+            { "ApplyAt(dst, src, length, offset)", true, [](State &s, uint8_t *d, const uint8_t *p, size_t n) {
+                Salsa20::ApplyAt (s, d, p, n, START_OFFSET) ;
+            } },
+            { "ApplyAt(message, length, offset)", false, [](State &s, uint8_t *d, const uint8_t *, size_t n) {
+                Salsa20::ApplyAt (s, d, n, START_OFFSET) ;
+            } } } ;
+    }
+
+    void    Run (Report &report, const std::vector<std::string> &kernels, size_t max_size, double min_time) {
+        const std::string   key { "The key to measure the kernels.." } ;
+        auto const          targets = MakeTargets () ;
+
+        std::vector<size_t> sizes ;
+        for (size_t size = 1 ; size <= max_size ; size *= 4) {
+            sizes.push_back (size) ;
+        }
+        Buffer  src { max_size } ;
+        Buffer  dst { max_size } ;
+
+        for (auto const &kernel : kernels) {
+            if (! Salsa20::SelectKernel (kernel.c_str ())) {
+                std::cerr << "Skips " << kernel << " (not available)" << std::endl ;
+                continue ;
+            }
+            Salsa20::State  state { key.c_str (), key.size (), 0x0123456789ABCDEFull } ;
+            {
+                volatile uint8_t    sink = 0 ;
+                auto const  sample = Measure ([&state, &sink]() {
+                    sink = sink ^ state.ComputeHashValue () [0] ;
+                    state.IncrementSequenceNumber () ;
+                }, min_time) ;
+                report.Add (kernel.c_str (), "ComputeHashValue", std::tuple_size<Salsa20::hash_value_t>::value, true, false, sample) ;
+            }
+            for (auto const &target : targets) {
+                for (size_t size : sizes) {
+                    for (bool aligned : { true, false }) {
+                        for (bool in_place : { false, true }) {
+                            if (! in_place && ! target.has_source) {
+                                continue ;
+                            }
+                            uint8_t *       d = dst.Get (aligned) ;
+                            const uint8_t * s = in_place ? d : src.Get (aligned) ;
+                            auto const  sample = Measure ([&]() { target.apply (state, d, s, size) ; }, min_time) ;
+                            report.Add (kernel.c_str (), target.name, size, aligned, in_place, sample) ;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main (int argc, char **argv) {
+    std::string                 output ;
+    std::vector<std::string>    kernels ;
+    size_t      max_size = 1024 * 1024 * 1024 ;
+    double      min_time = 0.1 ;
+    try {
+        for (int i = 1 ; i < argc ; ++i) {
+            std::string arg { argv [i] } ;
+            if (arg == "-h" || arg == "--help") {
+                Usage (argv [0]) ;
+                return 0 ;
+            }
+            if (arg == "-o" || arg == "-k" || arg == "-m" || arg == "-t") {
+                if (argc <= i + 1) {
+                    throw std::invalid_argument { "Missing the value for " + arg } ;
+                }
+                std::string value { argv [++i] } ;
+                if (arg == "-o") {
+                    output = value ;
+                }
+                else if (arg == "-k") {
+                    kernels.push_back (value) ;
+                }
+                else if (arg == "-m") {
+                    max_size = static_cast<size_t> (std::stoull (value)) ;
+                }
+                else {
+                    min_time = std::stod (value) ;
+                }
+                continue ;
+            }
+            Usage (argv [0]) ;
+            return 1 ;
+        }
+        if (kernels.empty ()) {
+            kernels.assign (std::begin (KERNELS), std::end (KERNELS)) ;
+        }
+        std::ofstream   file ;
+        if (! output.empty ()) {
+            file.open (output) ;
+            if (! file) {
+                throw std::runtime_error { "Failed to open " + output } ;
+            }
+        }
+        Report  report { output.empty () ? std::cout : file, min_time } ;
+        Run (report, kernels, max_size, min_time) ;
+    }
+    catch (const std::exception &e) {
+        std::cerr << argv [0] << ": " << e.what () << std::endl ;
+        return 1 ;
+    }
+    return 0 ;
+}
+
+/*
+ * [END OF FILE]
+ */
@@ -0,0 +1,260 @@
+/*
+ * salsa20_file.cxx: Encrypts/decrypts the whole file through the memory mapping
+ *
+ * Copyright (c) 2015-2017 Masashi Fujita
+ *
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "salsa20.h"
+#include "salsa20_parallel.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    void    Usage (const char *program) {
+        std::cerr << "Usage: " << program << " [options] <input> [<output>]\n"
+                  << "Encrypts (or decrypts) <input> into <output>, or in place when <output> is omitted or names <input>.\n"
+                  << "Options:\n"
+                  << "    -k <hex>    The key (16 or 32 bytes, required)\n"
+                  << "    -v <hex>    The initial vector (8 bytes, defaults to 0)\n"
+                  << "    -j <n>      # of threads (defaults to # of hardware threads)\n" ;
+    }
+
+    std::vector<uint8_t>    ParseHex (const std::string &s) {
+        auto    digit = [&s](char ch) -> int {
+            if ('0' <= ch && ch <= '9') {
+                return ch - '0' ;
+            }
+            if ('a' <= ch && ch <= 'f') {
+                return ch - 'a' + 10 ;
+            }
+            if ('A' <= ch && ch <= 'F') {
+                return ch - 'A' + 10 ;
+            }
+            throw std::invalid_argument { "Malformed hex string: " + s } ;
+        } ;
+        if ((s.size () % 2) != 0) {
+            throw std::invalid_argument { "Malformed hex string: " + s } ;
+        }
+        std::vector<uint8_t>    result ;
+        for (size_t i = 0 ; i < s.size () ; i += 2) {
+            result.push_back (static_cast<uint8_t> ((digit (s [i]) << 4) | digit (s [i + 1]))) ;
+        }
+        return result ;
+    }
+
+    /// <summary>The file descriptor closed on scope exit.</summary>
+    class File {
+    private:
+        int fd_ ;
+    public:
+        File (const std::string &path, int flags, mode_t mode = 0644) : fd_ (::open (path.c_str (), flags, mode)) {
+            if (fd_ < 0) {
+                throw std::system_error { errno, std::generic_category (), path } ;
+            }
+        }
+
+        File (const File &) = delete ;
+
+        File & operator = (const File &) = delete ;
+
+        ~File () {
+            ::close (fd_) ;
+        }
+
+        int     GetDescriptor () const {
+            return fd_ ;
+        }
+
+        struct stat GetStat () const {
+            struct stat st ;
+            if (::fstat (fd_, &st) != 0) {
+                throw std::system_error { errno, std::generic_category (), "fstat" } ;
+            }
+            return st ;
+        }
+
+        size_t  GetSize () const {
+            return static_cast<size_t> (GetStat ().st_size) ;
+        }
+
+        /**
+         * Resizes the file to `size` bytes with the blocks allocated.
+         *
+         * @param size The new size
+         *
+         * @remarks Writing through the mapping of a sparse file raises SIGBUS when the disk is full,
+         *          so the blocks are reserved up front and the shortage is reported here instead.
+         */
+        void    Reserve (size_t size) const {
+            if (::ftruncate (fd_, 0) != 0) {
+                throw std::system_error { errno, std::generic_category (), "ftruncate" } ;
+            }
+            if (size == 0) {
+                return ;
+            }
+#if defined (__APPLE__)
+            // No posix_fallocate, falls back to the sparse file
+            if (::ftruncate (fd_, static_cast<off_t> (size)) != 0) {
+                throw std::system_error { errno, std::generic_category (), "ftruncate" } ;
+            }
+#else
+            // Returns the error code instead of setting errno
+            int     err = ::posix_fallocate (fd_, 0, static_cast<off_t> (size)) ;
+            if (err != 0) {
+                throw std::system_error { err, std::generic_category (), "posix_fallocate" } ;
+            }
+#endif
+        }
+    } ;
+
+    /// <summary>The mapped region unmapped on scope exit.</summary>
+    class Mapping {
+    private:
+        void *  address_ ;
+        size_t  length_ ;
+    public:
+        Mapping (const File &file, size_t length, bool writable) : address_ (nullptr), length_ (length) {
+            if (length == 0) {
+                return ;
+            }
+            const int   prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ ;
+            address_ = ::mmap (nullptr, length, prot, MAP_SHARED, file.GetDescriptor (), 0) ;
+            if (address_ == MAP_FAILED) {
+                throw std::system_error { errno, std::generic_category (), "mmap" } ;
+            }
+            // Hints only, failures are harmless
+            ::madvise (address_, length, MADV_SEQUENTIAL) ;
+#if defined (MADV_HUGEPAGE)
+            ::madvise (address_, length, MADV_HUGEPAGE) ;
+#endif
+        }
+
+        Mapping (const Mapping &) = delete ;
+
+        Mapping & operator = (const Mapping &) = delete ;
+
+        ~Mapping () {
+            if (address_ != nullptr) {
+                ::munmap (address_, length_) ;
+            }
+        }
+
+        void *  GetAddress () const {
+            return address_ ;
+        }
+
+        /**
+         * Writes the modified pages back to the file.
+         *
+         * @remarks munmap reports nothing, so the I/O errors are only observable here.
+         */
+        void    Sync () const {
+            if (address_ != nullptr && ::msync (address_, length_, MS_SYNC) != 0) {
+                throw std::system_error { errno, std::generic_category (), "msync" } ;
+            }
+        }
+    } ;
+
+    bool    IsSameFile (const struct stat &a, const struct stat &b) {
+        return a.st_dev == b.st_dev && a.st_ino == b.st_ino ;
+    }
+
+    void    RunInPlace (Salsa20::State &state, const File &f, Salsa20::Executor &executor) {
+        size_t  size = f.GetSize () ;
+        Mapping m { f, size, true } ;
+        Salsa20::ParallelApply (state, m.GetAddress (), size, executor) ;
+        m.Sync () ;
+    }
+
+    void    Run (Salsa20::State &state, const std::string &input, const std::string &output, size_t num_threads) {
+        Salsa20::Executor   executor { num_threads } ;
+        if (output.empty ()) {
+            RunInPlace (state, File { input, O_RDWR }, executor) ;
+            return ;
+        }
+        File    src { input, O_RDONLY } ;
+        // No O_TRUNC: <output> may name <input> (or a hard link to it)
+        File    dst { output, O_RDWR | O_CREAT } ;
+        if (IsSameFile (src.GetStat (), dst.GetStat ())) {
+            RunInPlace (state, dst, executor) ;
+            return ;
+        }
+        size_t  size = src.GetSize () ;
+        dst.Reserve (size) ;
+        Mapping msrc { src, size, false } ;
+        Mapping mdst { dst, size, true } ;
+        Salsa20::ParallelApply (state, mdst.GetAddress (), msrc.GetAddress (), size, executor) ;
+        mdst.Sync () ;
+    }
+}
+
+int main (int argc, char **argv) {
+    std::vector<uint8_t>    key ;
+    uint64_t    iv = 0 ;
+    size_t      num_threads = 0 ;
+    std::vector<std::string>    files ;
+    try {
+        for (int i = 1 ; i < argc ; ++i) {
+            std::string arg { argv [i] } ;
+            if (arg == "-h" || arg == "--help") {
+                Usage (argv [0]) ;
+                return 0 ;
+            }
+            if (arg == "-k" || arg == "-v" || arg == "-j") {
+                if (argc <= i + 1) {
+                    throw std::invalid_argument { "Missing the value for " + arg } ;
+                }
+                std::string value { argv [++i] } ;
+                if (arg == "-k") {
+                    key = ParseHex (value) ;
+                }
+                else if (arg == "-v") {
+                    auto    v = ParseHex (value) ;
+                    if (v.size () != 8) {
+                        throw std::invalid_argument { "The initial vector should be 8 bytes" } ;
+                    }
+                    iv = 0 ;
+                    for (size_t k = 0 ; k < v.size () ; ++k) {
+                        iv |= static_cast<uint64_t> (v [k]) << (8 * k) ;
+                    }
+                }
+                else {
+                    num_threads = static_cast<size_t> (std::stoul (value)) ;
+                }
+                continue ;
+            }
+            files.push_back (arg) ;
+        }
+        if (files.empty () || 2 < files.size () || key.empty ()) {
+            Usage (argv [0]) ;
+            return 1 ;
+        }
+        if (key.size () != 16 && key.size () != 32) {
+            throw std::invalid_argument { "The key should be 16 or 32 bytes" } ;
+        }
+        Salsa20::State  state { key.data (), key.size (), iv } ;
+        Run (state, files [0], (files.size () == 2) ? files [1] : std::string {}, num_threads) ;
+    }
+    catch (const std::exception &e) {
+        std::cerr << argv [0] << ": " << e.what () << std::endl ;
+        return 1 ;
+    }
+    return 0 ;
+}
+
+/*
+ * [END OF FILE]
+ */